@@ -5,6 +5,7 @@
 #include "constants.h"
 
 const size_t ADDR_SIZ = 8;                      // size of the addresses
+const size_t DS2438_INLINE_ADDR = 1;            // addresses stored inside of the object (one battery monitor)
 const uint8_t DS2438_FAMILY_CODE = 0x26;        // family code
 const size_t PAGE_BYTES = 9;                    // 8 bytes + 1 CRC byte
 
@@ -35,6 +36,15 @@ class wAddr
             s.trim();
             return s;
         }
+        void getChars(char *s, size_t size)
+        {
+            size_t n = 0;
+            if (size) s[0] = '\0';
+            for(size_t k = 0; k < ADDR_SIZ && n < size; k++)
+            {
+                n += snprintf(s + n, size - n, k ? " %x" : "%x", addr[k]);
+            }
+        }
     private:
         uint8_t addr[ADDR_SIZ];
 }; // end
@@ -65,9 +75,14 @@ class DS2438
 public:
         DS2438(uint8_t pin, float senseR, bool pp);
         void findAll();
+        bool findIfRequired();
+        void invalidate();
+        size_t count() {return addresses.size();}
         String allAddressString();
         void getDataAll(Vector<DS2438Info> &output);
+        bool getData(size_t k, DS2438Info &info);
         void getDataVAD(Vector<DS2438VAD> &output);
+        bool readCurrent(float &current);
         uint8_t getDigitalPin() {return pin;}
 private:
     bool resetSelectCmd(uint8_t *addr, uint8_t *cmd, size_t cmd_len);
@@ -76,9 +91,11 @@ private:
     bool readTimeOperationCapacity(uint32_t &uptime, float &capacity, uint8_t *addr);
     bool readPage(uint8_t *addr, uint8_t *data);
     bool readVAD(float &v, uint8_t *addr);
+    float currentFromPage(uint8_t *data);
 
     OneWire w;
-    Vector<wAddr>addresses;
+    Vector<wAddr, DS2438_INLINE_ADDR>addresses;
+    bool cached;                // true if the addresses from the last ROM search can be used
     
     float senseR;
     bool pp;
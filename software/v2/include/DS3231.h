@@ -24,8 +24,10 @@ public:
     float readTemperature();
     bool setTime(int day, int month, int year, int hour, int minute, int second);
     void getTime(int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum);
+    int getSeconds();
     bool setAlarm(uint8_t code, int day, int month, int hour, int minute, int second, int dayNum, int alarmNum);
     bool setAlarmOnceMinuteOrSecond(uint8_t code);
+    bool setAlarmNextInterval(int m, uint32_t &next);
     bool setRTCDefaultTime();
     bool checkOscStopped();
     void setDefaultIfOscStopped();
@@ -33,6 +35,8 @@ public:
     void clearAlarms();
     void offAlarms();
     bool isAlarmOn();
+    int8_t getAgingOffset();
+    void setAgingOffset(int8_t offset);
 private:
     uint8_t addr;
     void convertToBcd(uint8_t *d, const uint8_t input); 
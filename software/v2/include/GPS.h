@@ -1,8 +1,15 @@
 #pragma once
 #include <Arduino.h>
 #include <TinyGPS++.h>
+#include "NmeaParser.h"
+#include "minmea.h"
 
-const size_t GPS_MAX_BYTES = 2048;  // 2^12
+const float GPS_EPOCH_MAX_DIFF_DEG = 1e-5;     // max difference in degrees between RMC and GGA positions of one epoch
+const uint8_t GPS_EPOCH_RMC = 1;
+const uint8_t GPS_EPOCH_GGA = 2;
+const uint8_t GPS_EPOCH_GST = 4;
+const uint8_t GPS_GST_MAX_MISS = 3;           // epochs without GST after which the receiver is taken to not send GST
+const unsigned long GPS_FIX_MAX_AGE = 2500;   // ms after the last good sentence that the fix is considered current
 struct last_gps_fix
 {
       float lat;           // latitude
@@ -23,8 +30,11 @@ struct last_gps_fix
       int fix_quality;
       int satellites;
       int total_sats;
-      char line[GPS_MAX_BYTES];
+      float hdop;          // horizontal dilution of precision
+      float pdop;          // position dilution of precision (GSA)
+      float vdop;          // vertical dilution of precision (GSA)
       bool good;
+      unsigned long rx_ms; // millis() when the fix was received
 };
 
 
@@ -35,11 +45,31 @@ public:
     void start_poll();
     void end_poll();
     void run_poll();
-    void read_data();
+    void feed();
+    bool read_data(unsigned long timeout_ms);
     void obtain_gps_data(struct last_gps_fix *d);
+    bool is_fix_current();
+    void standby();
+    void wake();
+    void reset_epoch();
 private:
+    void send_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len);
+    void parse_sentence(const char *line);
+    bool start_epoch(const struct minmea_time &t);
+    void check_epoch();
     Stream *serial;
     TinyGPSPlus gps;
+    NmeaParser parser;
     bool poll;
+    bool feeding;                   // true while feed() is running (feed() can be called from yield())
+    unsigned long last_good_ms;     // millis() at the last sentence that gave a good fix
+    struct last_gps_fix ep;         // fix being assembled from the sentences of one epoch
+    long ep_key;                    // UTC time of the epoch (ms since midnight)
+    uint8_t ep_have;                // GPS_EPOCH_* sentences received for the epoch
+    bool ep_published;              // true if the epoch has been copied to gdata
+    bool ep_valid;                  // RMC status of the epoch
+    bool ep_agree;                  // true if the RMC and GGA positions of the epoch agree
+    bool gst_seen;                  // true if the receiver sends GST
+    uint8_t gst_miss;               // epochs in a row without GST since GST was seen
 }; // end
 
@@ -17,7 +17,7 @@ public:
 	void set_serial_number(String sn) {device_serial_number = sn;}
 	void set_file_extension(String ext) {fn_ext = ext;}
 
-	String get_file_name(Vector<String> fn);
+	String get_file_name(const Vector<String> &fn);
 	void set_seed(int day, int month, int year, int hour, int minute, int second);
 	void set_seed();
 private:
@@ -3,16 +3,17 @@
 #include <stdint.h>
 
 const static size_t BYTES_MAX_MAXIM_UNIQUE = 8;
+const static size_t MAXIM_SERIAL_CHARS = BYTES_MAX_MAXIM_UNIQUE*4 + 1;     // "255 " for each byte and the terminator
 
 class MaximUniqueSerial
 {
 public:
     MaximUniqueSerial(uint8_t addr);
     bool getString(String &s);
+    bool getChars(char *s, size_t size);
 
 private:
     bool getData();
-    unsigned char dallasCrc8(const unsigned char * data, const unsigned int size);
     uint8_t addr;
     uint8_t data[BYTES_MAX_MAXIM_UNIQUE];
 };
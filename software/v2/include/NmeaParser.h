@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+
+const size_t NMEA_MAX_BYTES = 83;             // 82 characters max per NMEA sentence + null
+class NmeaParser
+{
+public:
+    NmeaParser();
+    const char *feed(char c);
+    void reset();
+    uint32_t get_num_good();
+    uint32_t get_num_bad();
+private:
+    enum nmea_state
+    {
+        NMEA_WAIT_START,        // waiting for '$'
+        NMEA_BODY,              // between '$' and '*'
+        NMEA_CHECKSUM_HIGH,     // first hex digit of the checksum
+        NMEA_CHECKSUM_LOW,      // second hex digit of the checksum
+        NMEA_WAIT_END           // waiting for CR or LF
+    };
+    bool hex_value(char c, uint8_t &v);
+    bool add_char(char c);
+nmea_state state;
+char line[NMEA_MAX_BYTES];
+size_t len;
+uint8_t sum;
+uint8_t expected;
+uint32_t num_good;
+uint32_t num_bad;
+}; // end
@@ -9,8 +9,10 @@ public:
     SimpleBBSerial(uint32_t PIN_RX, uint32_t PIN_TX, uint32_t baud, uint32_t PIN_CTS, uint32_t PIN_RTS, uint32_t TIMEOUT_CTS);
     SimpleBBSerial(uint32_t PIN_RX, uint32_t PIN_TX, uint32_t baud, uint32_t PIN_CTS, uint32_t TIMEOUT_CTS);
     void setBaud(uint32_t b);
-    bool sendString(String s);
+    bool sendString(const String &s);
+    bool sendChars(const char *s, size_t n);
     String receiveString(size_t timeout_cycles, size_t char_num_max, String end);
+    size_t receiveChars(char *s, size_t size, size_t timeout_cycles, char end);
     void setCannotReceiveData();
     void setCanReceiveData();
 private: 
@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+
+// A task returns TASK_DONE when finished, or the number of ms to wait before the task is called again.
+typedef unsigned long (*task_func)();
+const unsigned long TASK_DONE = 0xFFFFFFFFUL;
+const unsigned long TASK_NOW = 0;
+const size_t MAX_TASKS = 8;
+const int NO_TASK = -1;
+
+class SimpleTaskScheduler
+{
+public:
+    SimpleTaskScheduler();
+    int add(task_func fn, unsigned long delay_ms);
+    void cancel(int id);
+    void cancelAll();
+    bool isActive(int id);
+    void run();
+    bool idle();
+    unsigned long msUntilNext();
+private:
+    struct task
+    {
+        task_func fn;               // function to call
+        unsigned long start;        // millis() when the wait started
+        unsigned long wait;         // ms to wait from start
+        bool active;                // true if the task is to be called
+    };
+    task tasks[MAX_TASKS];
+}; // end
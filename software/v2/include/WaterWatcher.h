@@ -1,11 +1,80 @@
 #pragma once
+#include <stddef.h>
 #include "WaterWatcherOptions.h"
+#include "data_storage.h"
+#include "main_local.h"
+#include "common_inc.h"
 
+/*
+WaterWatcher<Options> runs the WaterWatcher with the options class Options.
+
+If Options is derived from WaterWatcherOptions, the transfer functions of Options are called directly
+(not through the virtual table), so the transfer functions are inlined into the sample at compile time.
+WaterWatcher<WaterWatcherOptions> (or WaterWatcher<>) calls the transfer functions through the virtual table
+of the options object, which is used when the transfer functions are only known at run time.
+*/
+
+// Calls the transfer functions of Options directly
+template <class Options, bool VIRTUAL = is_same<Options, WaterWatcherOptions>::value>
+struct ww_transfer
+{
+    static float a0(Options &o) { return o.Options::get_a0_out(); }
+    static float a1(Options &o) { return o.Options::get_a1_out(); }
+    static float a2(Options &o) { return o.Options::get_a2_out(); }
+    static float temp(Options &o, size_t k) { return k == 0 ? o.Options::get_temp0_out() : o.Options::get_temp_out(k); }
+}; // end
+
+// Calls the transfer functions through the virtual table
+template <class Options>
+struct ww_transfer<Options, true>
+{
+    static float a0(Options &o) { return o.get_a0_out(); }
+    static float a1(Options &o) { return o.get_a1_out(); }
+    static float a2(Options &o) { return o.get_a2_out(); }
+    static float temp(Options &o, size_t k) { return o.get_temp_out(k); }
+}; // end
+
+
+/*
+Apply the transfer functions of Options to the sampled data in d.
+The raw values are assigned first, since the transfer functions are dependent on the data being collected.
+*/
+template <class Options>
+void ww_transfer_outputs(WaterWatcherOptions *base, struct main_data_storage &d)
+{
+    typedef ww_transfer<Options> tf;
+    Options &opt = *static_cast<Options *>(base);
+
+    if (opt.is_sample_a0()) opt.set_a0_raw(d.a0_voltage);
+    if (opt.is_sample_a1()) opt.set_a1_raw(d.a1_voltage);
+    if (opt.is_sample_a2()) opt.set_a2_raw(d.a2_voltage);
+    if (opt.is_sample_temp0())
+    {
+        opt.set_temp0_raw(d.water_temperature);
+        for (size_t k = 1; k < d.num_temp_sensors; k++) opt.set_temp_raw(k, d.temperature[k]);
+    }
+
+    if (opt.is_sample_a0()) d.a0_out = tf::a0(opt);
+    if (opt.is_sample_a1()) d.a1_out = tf::a1(opt);
+    if (opt.is_sample_a2()) d.a2_out = tf::a2(opt);
+    if (opt.is_sample_temp0())
+    {
+        d.water_temperature_out = tf::temp(opt, 0);
+        for (size_t k = 1; k < d.num_temp_sensors; k++) d.temperature_out[k] = tf::temp(opt, k);
+    }
+} // end
+
+
+template <class Options = WaterWatcherOptions>
 class WaterWatcher
 {
     public:
-        WaterWatcher();
-        void setup(WaterWatcherOptions *opt);
-        void checkState();
-    private:
+        void setup(Options *opt)
+        {
+            setup_local(opt, ww_transfer_outputs<Options>);
+        } // end
+        void checkState()
+        {
+            loop_local();
+        } // end
 }; // end
@@ -1,4 +1,6 @@
 #pragma once
+#include <stddef.h>
+#include "constants.h"
 
 // This is the default no sample value and it can be overriden if required.
 const float NO_SAMPLE_VALUE = -127.0;
@@ -19,27 +21,33 @@ public:
     void set_a1_raw(float num);
     void set_a2_raw(float num);
     void set_temp0_raw(float num);
+    void set_temp_raw(size_t k, float num);    // temperature probe tk
     // Functions to get the raw voltage input values (used in the transfer functions)
     float get_a0_raw();
     float get_a1_raw();
     float get_a2_raw();
     float get_temp0_raw();
+    float get_temp_raw(size_t k);
     // Functions to get the outputs (override these functions)
-    float get_a0_out();
-    float get_a1_out();
-    float get_a2_out();
-    float get_temp0_out();
+    virtual float get_a0_out();
+    virtual float get_a1_out();
+    virtual float get_a2_out();
+    virtual float get_temp0_out();
+    virtual float get_temp_out(size_t k);      // t0 uses get_temp0_out()
     // Functions to check for sampling 
     bool is_sample_a0();
     bool is_sample_a1();
     bool is_sample_a2();
     bool is_sample_temp0();
 
+protected:
+    float get_calibrated_out(size_t ch);       // calibration of the channel stored in flash
+
 private:
 float a0_raw;
 float a1_raw;
 float a2_raw;
-float temp0_raw;
+float temp_raw[MAX_TEMP_SENSORS];
 
 bool do_sample_a0;
 bool do_sample_a1;
@@ -2,11 +2,16 @@
 #include <Arduino.h>
 #include "SimpleBBSerial.h"
 
+const uint32_t CELL_GUARD_TIME_MS = 1000;      // ms of silence required before and after the escape sequence
+const uint32_t ASSOC_RETRY = 60;
+const uint32_t ASSOC_WAIT_MS = 1000;
+
 class XbeeCell
 {
 public:
     XbeeCell(SimpleBBSerial *ser);
     bool enterCommandMode();
+    bool sendEscape();
     bool printHardwareInfo();
     String sendAT(String command, String param);
     String sendAT(String command);
@@ -16,6 +21,9 @@ public:
     bool setAccessPointServer(String server, unsigned int port);
     bool setAccessPointNameAndServerConnect(String ap_name, String server, unsigned int port);
     bool setAccessPointNameAndServerConnect();
+    bool setNetwork(String ap_name, String server, unsigned int port);
+    bool setCachedNetwork();
+    bool hasCachedNetworkInfo();
     bool setTextDelimiterCR();
     bool applyChanges();
     String checkAssociation();
@@ -24,7 +32,10 @@ public:
     String checkAssociationCmd();
     bool setDeviceOptionsNoUSA();
     bool getNetworkInfo();
-    String sendData(String data);
+    String sendData(const String &data);
+    bool sendDataEnd();
+    String receiveDataResponse();
+    bool receiveDataResponse(char *resp, size_t size);
     void removeNulls(String &s);
     bool checkIfConnected();
     bool reconnectIfRequired(String ap_name, String server, unsigned int port);
@@ -35,6 +46,7 @@ public:
     void setCachedNetworkInfo(String ap_name, String server, unsigned int port);
     bool enterCommandSetupSleep();
     bool isModuleSetToSleep();
+    bool isSleepConfigured();
     bool restoreDefaults();
     bool checkNotBlankOK(String s);
 private:
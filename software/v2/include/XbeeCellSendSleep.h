@@ -3,6 +3,9 @@
 
 const bool ENTER_CELL_SLEEP = true;
 const bool EXIT_CELL_SLEEP = false;
+const uint32_t SLEEP_WAIT_POLLS = 30;
+const uint32_t SLEEP_WAIT_POLL_TIME_MS = 1000;  // ms
+const uint32_t DELAY_EXIT_COMMAND_MODE = 1000;  // ms
 
 class XbeeCellSendSleep
 {
@@ -12,7 +15,9 @@ class XbeeCellSendSleep
         bool isModuleSleeping();
         void printSleepState();
         bool enterExitSleep(bool state);
-        bool wakeSendDataSleep(String data);
+        bool isInSleepState(bool state);
+        void requestSleepState(bool state);
+        bool wakeSendDataSleep(const String &data);
     private:
         void pd(String s);
         XbeeCell *cell;
@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+
+// Regions of the arena (one for each subsystem, see ARENA_*_SIZ in constants.h)
+enum arena_region
+{
+    ARENA_SD,               // line buffers of the SD card (allocated at startup)
+    ARENA_CLI,              // scratch buffers of the CLI commands (released after each command)
+    NUM_ARENA_REGIONS
+}; // end
+
+void setup_arena();
+void *arena_alloc(arena_region r, size_t size);
+size_t arena_mark(arena_region r);
+void arena_release(arena_region r, size_t mark);
+void print_memory();
@@ -0,0 +1,43 @@
+#pragma once
+#include <Arduino.h>
+#include "constants.h"
+
+// Channels of the calibrations
+const size_t CAL_A0 = 0;
+const size_t CAL_A1 = 1;
+const size_t CAL_A2 = 2;
+const size_t CAL_TEMP0 = 3;
+
+// Types of calibration
+const uint8_t CAL_NONE = 0;         // output is the raw value
+const uint8_t CAL_POLY = 1;         // c[0] + c[1]*x + ... + c[n-1]*x^(n-1)
+const uint8_t CAL_POLY2 = 2;        // sum of c[i*nt + j]*x^i*t^j (i < n, j < nt) where t is the raw temp0
+const uint8_t CAL_PWL = 3;          // n points (c[2k], c[2k+1]) = (x, y) in increasing x
+const uint8_t CAL_EXPR = 4;         // expression compiled to n bytes of code (see transfer_expr.cpp)
+
+// Calibration of one channel (stored in flash)
+struct calibration
+{
+    uint8_t type;
+    uint8_t n;                      // coefficients (CAL_POLY), powers of x (CAL_POLY2), points (CAL_PWL) or bytes of code (CAL_EXPR)
+    uint8_t nt;                     // powers of t (CAL_POLY2)
+    uint8_t reserved;
+    union
+    {
+        float c[CAL_MAX_COEFF];
+        uint8_t code[CAL_MAX_CODE];
+    };
+}; // end
+
+extern const char *const CAL_CHANNEL_NAMES[NUM_CAL_CHANNELS];
+
+void calibration_clear(struct calibration &c);
+bool calibration_valid(const struct calibration &c);
+size_t calibration_num_coeff(const struct calibration &c);
+float calibration_eval(const struct calibration &c, size_t ch, const float *raw);
+float calibration_apply(size_t ch, const float *raw);
+int get_calibration_channel(String name);
+bool setup_calibration(size_t ch, String type, int n, int nt);
+const char *setup_calibration_expr(size_t ch, const char *src);
+bool set_calibration_coeff(size_t ch, size_t k, float v);
+void print_calibration();
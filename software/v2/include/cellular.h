@@ -1,6 +1,12 @@
 #pragma once
 #include <Arduino.h>
+#include "record_sink.h"
 
-void setup_cellular();
-void send_to_server_over_cellular(String s); 
+typedef bool (*cell_record_next)(RecordSink &out);   // write the next record to out (returns false if there are no more records)
+typedef void (*cell_record_sent)();                  // called when the record has been received by the server
 
+void setup_cellular();
+void cell_task_start();
+void cell_task_send_records(cell_record_next next, cell_record_sent sent);
+void cell_task_abort();
+bool cell_task_busy();
@@ -6,7 +6,9 @@
 
 // #define DEBUG_WATCHDOG               // turn on this define to debug the watchdog
 // #define DEBUG_GPS                    // turn on this define to debug the GPS
+// #define DEBUG_ALARM                  // turn on this define to print the time of the next alarm
 #define DEBUG_CELLULAR                  // turn on this define to debug the cellular
+// DEBUG_HEAP is defined by the mkrzero_heap environment in platformio.ini (see heap_check.cpp)
 
 // PINS 
 const uint8_t TURBIDITY_SENSOR_PIN = A0;    // A0   as the analog turbidity sensor
@@ -47,6 +49,7 @@ static const char TEST_STR[] = "TEST";
 static const size_t NCHANNELS = 3;
 static const String SENSORS[NCHANNELS] = {"a0", "a1", "a2"};    // names as identified for the transfer functions
 static const String TEMP_SENSOR_INITIAL_NAME = "t";             // all temperature sensors are named as {t0, t1,...}
+const size_t MAX_TEMP_SENSORS = 8;                               // maximum number of 1-wire temperature probes on the bus
 
 // OPERATIONAL CONSTANTS
 const int BAUD_RATE_DEBUG = 9600;    
@@ -124,6 +127,19 @@ static const char SEND_CELL_OFF[] = "sendcell-off";
 static const char SAMPLE[] = "sample";
 
 static const char SET_SENSOR_NUM[] = "set-sensor-num";
+static const char SET_GPS_REFIX[] = "set-gps-refix";
+static const char POWER_PROFILE_ON[] = "power-profile-on";
+static const char POWER_PROFILE_OFF[] = "power-profile-off";
+static const char PRINT_POWER_PROFILE[] = "print-power-profile";
+static const char POLICY_ON[] = "policy-on";
+static const char POLICY_OFF[] = "policy-off";
+static const char PRINT_POLICY[] = "print-policy";
+static const char EVENT_ON[] = "event-on";
+static const char EVENT_OFF[] = "event-off";
+static const char SET_EVENT[] = "set-event";
+static const char SET_EVENT_FAST[] = "set-event-fast";
+static const char PRINT_EVENT[] = "print-event";
+static const char PRINT_RTC_DISCIPLINE[] = "print-rtc-discipline";
 static const char SET_PROXY[] = "set-proxy";
 static const char RM_PROXY[] = "rm-proxy";
 static const char SET_CONSTANT[] = "set-constant"; 
@@ -138,10 +154,12 @@ static const char PRINT_TRANSFER[] = "print-transfer";
 static const char SETUP_TRANSFER[] = "setup-transfer";
 static const char RT_TRANSFER[] = "rt-transfer";
 static const char SCAN_TEMPERATURE[] = "scan-temperature";
+static const char CLEAR_TEMPERATURE[] = "clear-temperature";
 static const char SET_APN_SERVER_PORT[] = "set-apn-server";
 
 static const char SET_SD_JSON[] = "set-sd-json";
 static const char SET_SD_CSV[] = "set-sd-csv";
+static const char MEM_CMD[] = "mem";
 
 // STRINGS
 static const String TRUE_STRING = "TRUE"; 
@@ -153,10 +171,25 @@ static const String DONE_STRING = "DONE";
 // Time format [dd/mm/yyyy hh:mm:ss]
 #define TIME_FORMAT "%02d/%02d/%4d %02d:%02d:%02d"
 static const size_t MAX_TIME_STR_SIZ = 20;
+static const size_t MAX_LOG_LINE_SIZ = 128;         // size of a line of the log file with the time (see sd_write_log)
 
 // upper bound for minutes for set alarm minutely
 const int MAX_NUM_MINUTES_RTC = 10080;
 
+// time service (cached DS3231 time)
+const uint32_t TIME_RESYNC_S = 3600;                // seconds between reads of the DS3231
+const unsigned long TIME_SYNC_EDGE_WAIT = 1100;     // ms to wait for the DS3231 seconds to change on a sync
+const unsigned long TIME_SYNC_EDGE_GUARD = 50;      // ms before the expected DS3231 second that the resync task starts polling
+
+// GPS discipline of the DS3231
+const int32_t RTC_STEP_MS = 2000;                   // offset (ms) from the GPS time above which the time is set
+const uint32_t RTC_DRIFT_MIN_S = 86400;             // seconds between the measurements used to estimate the drift
+const float RTC_DRIFT_DEADBAND_PPM = 0.2;           // drift (ppm) below which the aging offset is not changed
+const size_t RTC_OFFSET_WINDOW = 5;                 // offsets in each window (the median of the window is used)
+const int32_t RTC_OFFSET_JITTER_MS = 150;           // bound of the error of one offset (time stamp of the fix and the counter between resyncs)
+const float RTC_AGING_PPM_PER_LSB = 0.1;            // change of the frequency (ppm) for each LSB of the aging offset
+const int RTC_AGING_MAX_STEP = 10;                  // max change of the aging offset for each measurement
+
 // number of characters to set the name (31 in total)
 const size_t MAX_NUM_CHARS_SENSOR_NAME = 32;
 
@@ -189,10 +222,16 @@ const uint32_t SPI_CLOCK_NOMINAL = 1000000;     // 1 MHz
 #define SD_CARD_DRIVE_NUM       0
 // no delay mount of SD card
 #define NO_DELAY_MOUNT_SD          1
+// bytes of each region of the arena (see arena.cpp)
+#define ARENA_SD_SIZ            (2 * SD_CHAR_BUFFER)
+#define ARENA_CLI_SIZ           (MAX_STRING_SIZE_TRANSFER_FUNC)
 // max number of times to write to the SD card
 #define SD_CARD_MAX_TRIES_WRITE     16
+#define SD_ROTATE_MAX               99      // max number of the old files of a file that is rotated (name-N.csv)
 // Filename extension for the file on the SD card
 #define FILENAME_EXTENSION          ".txt"
+// Filename extension for the records stored as CSV (set-sd-csv)
+#define CSV_FILENAME_EXTENSION      ".csv"
 // CRLF
 #define CRLF "\r\n"
 
@@ -204,27 +243,29 @@ const uint32_t SPI_CLOCK_NOMINAL = 1000000;     // 1 MHz
 #define CELL_RESP_GOOD  "[0,0]"     // indicates that the cellular response has been sent and received by the server
 //---------------------------------------------------------------
 
-const int EXPERIMENT_TICK = 3000;       // ms between timer ticks
+const int EXPERIMENT_TICK = 3000;       // ms to wait for the sensors to settle after the 5V rail is turned on
+const unsigned long SAMPLE_GPS_POLL = 100;  // ms between polls of the GPS during the sample
+const unsigned long CELL_TASK_POLL = 100;   // ms between polls of the modem task
 const int GPS_RETRIES = 3;              // gps retries
+const int GPS_MIN_SATS = 4;                                         // minimum satellites for a fix to be used
+const float GPS_MAX_HDOP = 2.5;                                     // maximum HDOP for a fix to be used
+const unsigned long GPS_FIX_WAIT = GPS_RETRIES*SERIAL_PORT_TIMEOUT; // ms to wait for a fix during the sample
+const unsigned long GPS_MAX_HOLD = 15UL*60UL*1000UL;                // ms to keep the 5V rail on after the sample waiting for a fix
+const int GPS_REFIX_DEFAULT = 1;                                    // obtain a new position every sample by default
 const int CELL_SEND_POLL = 100000;      // number of times to poll for cellular send
 const int MAX_VECTOR_SIZ = 50;          // 50 elements to be stored in the vector as the maximum size
 
-//---------------------------------------------------------------
-const int DEC_PLACES_PRINT = 7;     // number of decimal places to print float 
-//---------------------------------------------------------------   
-
 // Default name of the sensor
 static const char DEFAULT_NAME_SENSOR[] = "NONAME";
 //------------------------------------------------------------
 
-// Maximum string size to be stored in non-volatile memory for the transfer functions
+// Maximum size of the text of a transfer expression (the compiled bytecode is stored in flash)
 const size_t MAX_STRING_SIZE_TRANSFER_FUNC = 256;
 
 // max string size for the cellular addresses 
 const size_t CELL_SIZ_CHAR = 32;
 
-// max buffer for json
-const size_t MAX_BUFF_SIZ_JSON = 1300;
+// buffer for one line of print-gps (the records are streamed, see record_sink.h)
 const size_t SMALL_BUFF_JSON_SIZ = 128;
 
 // null string for nan
@@ -232,4 +273,27 @@ const float NAN_VALUE_REPLACE = -999.0;
 
 // cellular retries
 const uint8_t CELLULAR_RETRIES = 3;
+// max number of records sent each time the modem is woken
+const size_t MAX_UPLINK_RECORDS = 16;
+
+// battery-aware sampling policy (policy-on)
+const float POLICY_V_LOW = 3.6;             // battery voltage (V) below which the battery is low
+const float POLICY_V_CRITICAL = 3.4;        // battery voltage (V) below which the battery is critical
+const float POLICY_V_HYST = 0.05;           // voltage (V) above the threshold required to leave the tier
+const float POLICY_CAP_LOW = 0.5;           // remaining capacity (Ah) below which the battery is low
+const float POLICY_CAP_CRITICAL = 0.2;      // remaining capacity (Ah) below which the battery is critical
+const float POLICY_CAP_HYST = 0.05;         // capacity (Ah) above the threshold required to leave the tier
+// event detection on the transfer function outputs {a0_out, a1_out, temp0_out} (event-on)
+const size_t NUM_EVENT_CHANNELS = 3;
+const int EVENT_M_DEFAULT = 1;              // sampling interval (minutes) during an event
+const int EVENT_COOLDOWN_DEFAULT = 6;       // samples without a trip before the event ends
+const float EVENT_EWMA_ALPHA = 0.1;         // weight of the new sample in the baseline used by the CUSUM
+// calibrations of the transfer function outputs {a0_out, a1_out, a2_out, temp0_out} stored in flash (set-transfer)
+const size_t NUM_CAL_CHANNELS = 4;
+const size_t CAL_MAX_COEFF = 12;            // coefficients (or 2x the points of a piecewise-linear calibration) of each channel
+const size_t CAL_MAX_CODE = 64;             // bytes of the compiled expression of each channel
+const size_t NUM_TRANSFER_CONSTANTS = 8;    // named constants of the transfer expressions (set-constant)
+const size_t MAX_CONSTANT_NAME = 8;         // characters of the name of a constant (including the terminator)
+// Filename extension for the log of the policy changes on the SD card
+#define POLICY_LOG_EXTENSION        ".log"
 
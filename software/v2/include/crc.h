@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC_TABLE_NUM   256
+#define CRC_DSU_MIN_SIZ 64          // bytes of CRC-32 that are computed with the DSU instead of the table
+#define CRC_DSU_POLLS_PER_WORD 16   // polls of the DSU per word before the CRC is computed with the table
+
+/*
+The entries of the CRC tables are computed by the compiler (one bit of the byte for each call),
+so the tables are constant data in flash and do not need to be generated at startup.
+*/
+
+// CRC-7 of the SD commands (x^7 + x^3 + 1), indexed by (crc << 1) ^ byte
+constexpr uint8_t crc7_shift(uint8_t v, int n)
+{
+    return n == 0 ? v : crc7_shift(((uint8_t)(v << 1) & 0x80) ? (uint8_t)((uint8_t)(v << 1) ^ 0x89) : (uint8_t)(v << 1), n - 1);
+} // end
+constexpr uint8_t crc7_entry(int i)
+{
+    return crc7_shift((i & 0x80) ? (uint8_t)(i ^ 0x89) : (uint8_t)i, 7);
+} // end
+
+// Dallas/Maxim CRC-8 of the 1-Wire ROM (x^8 + x^5 + x^4 + 1, reflected)
+constexpr uint8_t crc8_shift(uint8_t v, int n)
+{
+    return n == 0 ? v : crc8_shift((v & 1) ? (uint8_t)((v >> 1) ^ 0x8C) : (uint8_t)(v >> 1), n - 1);
+} // end
+constexpr uint8_t crc8_entry(int i)
+{
+    return crc8_shift((uint8_t)i, 8);
+} // end
+
+// CRC-16 of the SD data blocks (x^16 + x^12 + x^5 + 1, initial value 0)
+constexpr uint16_t crc16_shift(uint16_t v, int n)
+{
+    return n == 0 ? v : crc16_shift((v & 0x8000) ? (uint16_t)((v << 1) ^ 0x1021) : (uint16_t)(v << 1), n - 1);
+} // end
+constexpr uint16_t crc16_entry(int i)
+{
+    return crc16_shift((uint16_t)(i << 8), 8);
+} // end
+
+// CRC-32 of the records (IEEE 802.3, reflected)
+constexpr uint32_t crc32_shift(uint32_t v, int n)
+{
+    return n == 0 ? v : crc32_shift((v & 1) ? (v >> 1) ^ 0xEDB88320UL : v >> 1, n - 1);
+} // end
+constexpr uint32_t crc32_entry(int i)
+{
+    return crc32_shift((uint32_t)i, 8);
+} // end
+
+// f(0), f(1), ... f(255)
+#define CRC_TABLE_16(f, n)  f(n), f(n + 1), f(n + 2), f(n + 3), f(n + 4), f(n + 5), f(n + 6), f(n + 7), \
+                            f(n + 8), f(n + 9), f(n + 10), f(n + 11), f(n + 12), f(n + 13), f(n + 14), f(n + 15)
+#define CRC_TABLE_256(f)    CRC_TABLE_16(f, 0), CRC_TABLE_16(f, 16), CRC_TABLE_16(f, 32), CRC_TABLE_16(f, 48), \
+                            CRC_TABLE_16(f, 64), CRC_TABLE_16(f, 80), CRC_TABLE_16(f, 96), CRC_TABLE_16(f, 112), \
+                            CRC_TABLE_16(f, 128), CRC_TABLE_16(f, 144), CRC_TABLE_16(f, 160), CRC_TABLE_16(f, 176), \
+                            CRC_TABLE_16(f, 192), CRC_TABLE_16(f, 208), CRC_TABLE_16(f, 224), CRC_TABLE_16(f, 240)
+
+extern const uint8_t CRC7_TABLE[CRC_TABLE_NUM];
+extern const uint8_t CRC8_TABLE[CRC_TABLE_NUM];
+extern const uint16_t CRC16_TABLE[CRC_TABLE_NUM];
+extern const uint32_t CRC32_TABLE[CRC_TABLE_NUM];
+
+uint8_t crc8_dallas(const uint8_t *p, size_t n);
+uint16_t crc16_sd(const uint8_t *p, size_t n);
+uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t n);
@@ -2,7 +2,9 @@
 #include <Arduino.h>
 #include "DS2438.h"
 #include "GPS.h"
+#include "MaximUniqueSerial.h"
 #include "constants.h"
+#include "power_profile.h"
 
 void get_state_battery(); 
 void print_state_battery();
@@ -15,11 +17,14 @@ void print_rtc_temperature();
 void time_function(String in);
 void print_time(); 
 String get_time(bool with_days=false);
+void get_time_chars(char *s, size_t size);
 void get_time_ints( int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum); 
 void set_rtc_defaults();
 void read_status_print();
 void set_default_time_rtc_force();
 bool set_alarm_minutely(int m, bool store);
+bool set_next_alarm_rtc();
+bool alarm_fired_rtc();
 void clear_alarms_rtc(); 
 void turn_off_alarms_rtc();
 bool iao();
@@ -27,16 +32,23 @@ void print_bmon_addr();
 void print_bmon();
 void take_sample();
 void get_time_rtc(int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum);
+uint32_t get_epoch_rtc();
 extern "C" void get_time_rtc_cbind(int *day, int *month, int *year, int *hour, int *minute, int *second, int *dayNum);
 void gps_run_poll(); 
+void gps_feed();
 void gps_start_poll();
 void gps_end_poll();
 void print_gps();
 void sample_gps();
 void gps_obtain_data();
 void obtain_bmon();
+bool obtain_bmon_current(float &current);
 void populate_data_first();
 void populate_data_second();
+void populate_data_analog();
+void populate_data_temperature(bool temp_good);
+void populate_data_ancillary();
+bool populate_data_gps(bool timeout);
 bool is_gps_data_good();
 void obtain_a2(float &v_out);
 
@@ -54,8 +66,13 @@ struct main_data_storage
     float a2_out;
     float water_temperature_out;
 
+    // 1-wire temperature probes {t0, t1,...} where t0 is also the water temperature
+    size_t num_temp_sensors;
+    float temperature[MAX_TEMP_SENSORS];
+    float temperature_out[MAX_TEMP_SENSORS];
+
     // Serial Number
-    String serial_number;
+    char serial_number[MAXIM_SERIAL_CHARS];
     bool serial_number_good;
 
     // battery charger state
@@ -68,10 +85,29 @@ struct main_data_storage
 
     // gps data struct
     struct last_gps_fix gdata;
+    bool gps_reused;                // true if the last fix was reused (the position is only fixed every gps_refix samples)
+    long gps_ttff;                  // last time to first fix (ms) or -1
+    unsigned long gps_on_time;      // ms that the GPS was on since the last sample
+
+    // power profile of the last sample cycle (power-profile-on)
+    bool pp_valid;
+    float pp_mah[NUM_PP_PHASES];
+    uint32_t pp_ms[NUM_PP_PHASES];
+
+    // battery-aware policy
+    int policy_tier;                // tier of the policy (0 = charging, 1 = normal, 2 = low, 3 = critical)
+    int policy_m;                   // sampling interval (minutes) after scaling by the tier
+    int uplink_pending;             // records that have not been sent before this record
+
+    // event detection
+    bool event;                     // true if the samples are taken at the fast interval after an event
+    int event_flags;                // checks that tripped for this sample (see event_detect.h)
 
-    // time
-    String start_time_str;
-    String end_time_str;
+    // time (ms since 1970-01-01 00:00:00 UTC)
+    uint64_t start_time;
+    uint64_t end_time;
+    bool rtc_gps_offset_valid;      // true if a new fix was obtained for the sample
+    int32_t rtc_gps_offset;         // ms that the RTC is ahead of the GPS time when the fix was received
 
     // battery state
     float btemperature;
@@ -0,0 +1,17 @@
+#pragma once
+#include <Arduino.h>
+#include "data_storage.h"
+
+// Bits of event_flags (shifted by 3*channel for channel {a0, a1, temp0})
+const int EVENT_FLAG_THRESHOLD = 0x01;
+const int EVENT_FLAG_RATE = 0x02;
+const int EVENT_FLAG_CUSUM = 0x04;
+
+extern const char *const EVENT_CHANNEL_NAMES[NUM_EVENT_CHANNELS];
+
+void setup_event_detect();
+void event_detect_update(struct main_data_storage &d);
+bool is_event_active();
+int event_interval(int m);
+int get_event_channel(String name);
+void print_event_detect();
@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+const uint8_t FIXED_FORMAT_MAX_PRECISION = 9;      // decimal places (the scaled fraction fits into 32 bits)
+const size_t FIXED_FORMAT_SIZ = 32;                 // size of the output buffer (sign, 20 digits, point, 9 decimals)
+const int FIXED_FORMAT_DIGITS = 9;                  // significant digits of format_general() (enough to read back a float)
+
+size_t format_fixed(float v, uint8_t precision, char *out);
+size_t format_general(float v, char *out);
@@ -1,5 +1,6 @@
 #pragma once
 #include <Arduino.h>
+#include "calibration.h"
 void set_m_flash(int m);
 void set_alarm_state_flash(bool state); 
 void setup_flash_mem_defaults();
@@ -18,9 +19,33 @@ void set_shutdown_rails(bool state);
 bool get_shutdown_rails();
 void set_send_cell(bool state); 
 bool get_send_cell();
+void set_power_profile_on(bool state);
+bool get_power_profile_on();
+void set_policy_on(bool state);
+bool get_policy_on();
+void set_event_on(bool state);
+bool get_event_on();
+void set_event_fast(int m, int cooldown);
+int get_event_m();
+int get_event_cooldown();
+void set_event_limits(size_t ch, float hi, float rate, float k, float h);
+void get_event_limits(size_t ch, float &hi, float &rate, float &k, float &h);
+void set_calibration(size_t ch, const struct calibration &c);
+const struct calibration &get_calibration(size_t ch);
+void set_constant(size_t k, const char *name, float v);
+const char *get_constant_name(size_t k);
+const float *get_constant_values();
+void set_sd_json(bool state);
 bool get_sd_json(); 
 int get_num(); 
 void set_num(int n); 
+int get_gps_refix();
+void set_gps_refix(int n);
+size_t get_temp_rom_num();
+void set_temp_rom_num(size_t n);
+void get_temp_rom(size_t k, uint8_t *addr);
+void set_temp_rom(size_t k, const uint8_t *addr);
+bool save_temp_rom();
 void set_apn_server_port(String apn, String server, unsigned int port);
 void get_apn_server_port(String &apn, String &server, unsigned int &port);
 
@@ -3,7 +3,9 @@ void turn_on_5V_ext();
 void turn_off_5V_ext();
 void setup_gpio();
 void check_rtc();
+bool rtc_event_pending();
 void set_m(int m);
+int get_m_alarm();
 void attach_alarm_interrupt();
 void detach_alarm_interrupt(); 
 void check_take_sample();
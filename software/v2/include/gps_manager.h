@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+#include "GPS.h"
+
+void setup_gps_manager();
+void gps_power_event(bool on);
+bool gps_fix_acceptable(const struct last_gps_fix &f);
+void gps_begin_sample();
+void gps_get_fix(struct last_gps_fix &f, bool &reused);
+bool gps_poll_fix(struct last_gps_fix &f, bool &reused);
+void gps_end_sample(bool shutdown_rails);
+void gps_manager_poll();
+bool gps_is_holding();
+long gps_get_ttff();
+uint64_t gps_fix_epoch_ms(const struct last_gps_fix &f);
+unsigned long gps_take_on_time();
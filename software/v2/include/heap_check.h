@@ -0,0 +1,5 @@
+#pragma once
+#include <stddef.h>
+
+void heap_check_begin();
+size_t heap_check_end();
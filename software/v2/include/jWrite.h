@@ -134,6 +134,13 @@ struct jWriteControl{
 //
 char *jwErrorToString( int err );
 
+// Number conversions used by jWrite (also used by the record serializers)
+//
+void modp_itoa10(int32_t value, char* str);
+void modp_itoa10u(int32_t value, char* str);
+void modp_itoa10u64(uint64_t value, char* str);
+void modp_dtoa2(double value, char* str, int prec);
+
 
 #ifdef JW_GLOBAL_CONTROL_STRUCT		/* USING GLOBAL g_jWriteControl */
 
@@ -163,6 +170,7 @@ int jwErrorPos( );
 void jwObj_string( char *key, char *value );
 void jwObj_int( char *key, int value );
 void jwObj_uint( char *key, uint32_t value );
+void jwObj_uint64( char *key, uint64_t value );
 void jwObj_double( char *key, double value );
 void jwObj_bool( char *key, int oneOrZero );
 void jwObj_null( char *key );
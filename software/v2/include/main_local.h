@@ -1,15 +1,24 @@
 #pragma once
 #include <Arduino.h>
 #include "WaterWatcherOptions.h"
+#include "SimpleTaskScheduler.h"
+
+extern SimpleTaskScheduler scheduler;     // runs the tasks from the main loop
 
 void set_serial_main(int port);
-void printSerial(String s);
-void printSerialWithoutLineEnding(String s);
+void printSerial(const String &s);
+void printSerial(const char *s);
+void printSerialWithoutLineEnding(const String &s);
+void printSerialWithoutLineEnding(const char *s);
 void get_data(); 
 void print_data_debug();
 void get_print_data_debug();
 extern "C" void print_debug_c(char *s);
 void print_info();
 void loop_local();
-void setup_local(WaterWatcherOptions *opt);
-WaterWatcherOptions *get_options(); 
+struct main_data_storage;
+typedef void (*transfer_outputs_fn)(WaterWatcherOptions *opt, struct main_data_storage &d);   // see WaterWatcher.h
+
+void setup_local(WaterWatcherOptions *opt, transfer_outputs_fn transfer);
+WaterWatcherOptions *get_options();
+transfer_outputs_fn get_transfer_outputs(); 
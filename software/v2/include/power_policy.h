@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+
+// Tiers of the battery-aware policy
+enum policy_tier
+{
+    POLICY_CHARGING,        // charging (sample faster)
+    POLICY_NORMAL,          // base interval and send every sample
+    POLICY_LOW,             // battery is low
+    POLICY_CRITICAL,        // battery is critical
+    NUM_POLICY_TIERS
+}; // end
+
+void setup_power_policy();
+void power_policy_update(float bvoltage, float bcapacity, bool charging, bool fault);
+int get_policy_tier();
+int power_policy_interval(int m);
+size_t get_policy_batch();
+void print_power_policy();
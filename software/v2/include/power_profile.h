@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+// Phases of the sample cycle in the order that they occur
+enum power_phase
+{
+    PP_RAIL,            // 5V rail on and sensors settling
+    PP_SENSORS,         // ADC, 1-wire and ancillary data
+    PP_GPS,             // waiting for the GPS fix
+    PP_SD,              // formatting and writing to the SD card
+    PP_MODEM,           // waiting for the modem to wake and attach
+    PP_SEND,            // sending the data and putting the modem to sleep
+    PP_SLEEP,           // between the end of the sample and the start of the next sample
+    NUM_PP_PHASES
+}; // end
+
+extern const char *const PP_PHASE_NAMES[NUM_PP_PHASES];
+
+void setup_power_profile();
+void power_profile_begin();
+void power_profile_mark(power_phase phase);
+void power_profile_end();
+bool get_power_profile(float *mah, uint32_t *ms);
+void print_power_profile();
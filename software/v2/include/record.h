@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "data_storage.h"
+#include "record_sink.h"
+
+/*
+Field table of the record (main_data_storage) used by the JSON, CSV and binary serializers.
+To add a value to the record, add the member to main_data_storage and one row to RECORD_FIELDS in record.cpp.
+*/
+
+// Type of the member in main_data_storage
+enum record_field_type : uint8_t
+{
+    RF_FLOAT,
+    RF_BOOL,
+    RF_INT,
+    RF_UINT,
+    RF_LONG,
+    RF_ULONG,
+    RF_ULLONG,
+    RF_STRING                   // char array (a String member is not allowed, since the record must not use the heap)
+}; // end
+
+// A field is written when the group of the field is enabled for the record
+enum record_group : uint8_t
+{
+    RG_ALWAYS = 0x01,
+    RG_A0 = 0x02,               // is_sample_a0()
+    RG_A1 = 0x04,               // is_sample_a1()
+    RG_A2 = 0x08,               // is_sample_a2()
+    RG_TEMP = 0x10,             // is_sample_temp0()
+    RG_GPS = 0x20,              // GPS fix (also used by print-gps)
+    RG_RTC_GPS = 0x40,          // rtc_gps_offset_valid
+    RG_PP = 0x80                // pp_valid
+}; // end
+
+struct record_field
+{
+    const char *name;
+    uint16_t offset;            // offset of the member in main_data_storage
+    record_field_type type;
+    uint8_t precision;          // decimal places of RF_FLOAT
+    uint8_t group;              // record_group that enables the field
+}; // end
+
+// Type of the member from the C++ type
+template <class T> struct record_type_of;
+template <> struct record_type_of<float> { static constexpr record_field_type value = RF_FLOAT; };
+template <> struct record_type_of<bool> { static constexpr record_field_type value = RF_BOOL; };
+template <> struct record_type_of<int> { static constexpr record_field_type value = RF_INT; };
+template <> struct record_type_of<unsigned int> { static constexpr record_field_type value = RF_UINT; };
+template <> struct record_type_of<long> { static constexpr record_field_type value = RF_LONG; };
+template <> struct record_type_of<unsigned long> { static constexpr record_field_type value = RF_ULONG; };
+template <> struct record_type_of<unsigned long long> { static constexpr record_field_type value = RF_ULLONG; };
+template <class T, size_t N> struct record_type_of<T[N]> : record_type_of<T> {};
+template <size_t N> struct record_type_of<char[N]> { static constexpr record_field_type value = RF_STRING; };    // terminated text
+
+#define RECORD_MEMBER_TYPE(member) decltype(static_cast<main_data_storage *>(nullptr)->member)
+#define RECORD_FIELD(name, member, precision, group) \
+    { name, offsetof(main_data_storage, member), record_type_of<RECORD_MEMBER_TYPE(member)>::value, precision, group }
+
+// Array member written as one field per element from first to count-1.
+// The name is a format with %u for the index, or with %s for the label if labels is not NULL.
+// If counted is true, only the elements below num_temp_sensors are written.
+struct record_array_field
+{
+    const char *name;
+    uint16_t offset;
+    record_field_type type;
+    uint8_t precision;
+    uint8_t group;
+    uint8_t first;
+    uint8_t count;
+    const char *const *labels;
+    bool counted;
+}; // end
+
+#define RECORD_ARRAY(name, member, precision, group, first, count, labels, counted) \
+    { name, offsetof(main_data_storage, member), record_type_of<RECORD_MEMBER_TYPE(member)>::value, precision, group, first, count, labels, counted }
+
+// version of the binary record
+const uint8_t RECORD_BINARY_VERSION = 1;
+
+size_t record_write_json(const struct main_data_storage &d, RecordSink &out);
+size_t record_write_csv(const struct main_data_storage &d, RecordSink &out);
+size_t record_write_csv_header(RecordSink &out);
+size_t record_write_binary(const struct main_data_storage &d, RecordSink &out);
+void record_print(const struct main_data_storage &d, uint8_t groups);
@@ -0,0 +1,102 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "sd_storage.h"
+#include "SimpleBBSerial.h"
+
+/*
+Output of the record serializers (see record.cpp).
+The record is streamed into the sink in small chunks, so the record is never held in RAM as a whole.
+After a write fails, the following writes are ignored and length() returns 0.
+*/
+class RecordSink
+{
+public:
+    RecordSink() : count(0), failed(false) {}
+    void write(const void *p, size_t n)
+    {
+        if (failed || n == 0) return;
+        if (emit(static_cast<const uint8_t *>(p), n)) count += n;
+        else failed = true;
+    }
+    void write(const char *s) { write(s, strlen(s)); }
+    size_t length() const { return failed ? 0 : count; }
+    bool good() const { return !failed; }
+protected:
+    ~RecordSink() {}
+    virtual bool emit(const uint8_t *p, size_t n) = 0;
+private:
+    size_t count;
+    bool failed;
+}; // end
+
+
+// Text into the buffer of the caller (the text is always terminated)
+class RecordBufferSink : public RecordSink
+{
+public:
+    RecordBufferSink(char *buf, size_t size);
+protected:
+    bool emit(const uint8_t *p, size_t n);
+private:
+    char *buf;
+    size_t size;
+    size_t len;
+}; // end
+
+
+// Appended to a file on the SD card
+class RecordSdSink : public RecordSink
+{
+public:
+    RecordSdSink() : is_open(false) {}
+    ~RecordSdSink() { close(); }
+    bool open(const char *filename, uint32_t &size);
+    bool close();
+protected:
+    bool emit(const uint8_t *p, size_t n);
+private:
+    FIL fil;
+    bool is_open;
+}; // end
+
+
+// Sent over the bit-banged serial port (modem)
+class RecordUartSink : public RecordSink
+{
+public:
+    RecordUartSink(SimpleBBSerial *serial) : serial(serial) {}
+protected:
+    bool emit(const uint8_t *p, size_t n);
+private:
+    SimpleBBSerial *serial;
+}; // end
+
+
+// CRC-32 (IEEE 802.3) of the bytes, so that the record can be compared without keeping the record
+class RecordCrcSink : public RecordSink
+{
+public:
+    RecordCrcSink() : crc(0xFFFFFFFF) {}
+    uint32_t value() const { return ~crc; }
+    void print() const;
+protected:
+    bool emit(const uint8_t *p, size_t n);
+private:
+    uint32_t crc;
+}; // end
+
+
+// Written to both sinks
+class RecordTeeSink : public RecordSink
+{
+public:
+    RecordTeeSink(RecordSink &a, RecordSink &b) : a(a), b(b) {}
+protected:
+    bool emit(const uint8_t *p, size_t n);
+private:
+    RecordSink &a;
+    RecordSink &b;
+}; // end
@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+#include "DS3231.h"
+
+void setup_rtc_discipline(DS3231 *rtc);
+void rtc_discipline_update(int32_t offset, uint64_t gps_ms);
+void print_rtc_discipline();
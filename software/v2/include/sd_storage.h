@@ -4,6 +4,8 @@
 #include "./fatfs/ff.h"
 #include "Vector.h"
 
+class RecordSink;
+
 void set_startup_setup_sd();
 void sd_clear_buffer();
 void sd_clear_buffer();
@@ -16,6 +18,10 @@ void check_sdcard_mounted();
 void invalidate_sd_mount();
 bool sd_print_file(const char *fname);
 bool sd_write_text_to_file(const char *filename, const char *text);
+bool sd_write_log(const char *text);
+bool sd_file_size(const char *filename, uint32_t &size);
+bool sd_stream_line(const char *filename, uint32_t offset, RecordSink &out, uint32_t &next);
+bool sd_rotate_file(const char *filename);
 void get_name_of_file(char *filename);
 bool write_text_to_obs_file(const char *text);
 void cancel_printing_file();
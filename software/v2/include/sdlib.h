@@ -31,6 +31,7 @@
 #define SD_CMD16							16
 #define SD_CMD25							25
 #define SD_CMD58							58
+#define SD_CMD59							59
 #define SD_CMD55							55
 #define SD_ACMD41							41
 #define SD_CMD17							17
@@ -79,4 +80,6 @@ EXTERNC bool wait_for_response_sd(uint8_t resp);
 EXTERNC bool write_single_sector_sd(uint8_t *buff, uint32_t sector);
 EXTERNC bool write_multiple_sector_sd(uint8_t *buff, uint32_t starting_sector, uint32_t num);
 EXTERNC bool check_if_sdcard_init();
-EXTERNC void invalidate_sd_init(); 
+EXTERNC void invalidate_sd_init();
+EXTERNC bool check_data_crc_sd(const uint8_t *buff, uint8_t bcrc0, uint8_t bcrc1);
+EXTERNC bool write_data_crc_sd(const uint8_t *buff); 
@@ -0,0 +1,7 @@
+#pragma once
+#include <Arduino.h>
+
+void setup_sleep();
+void sleep_configure_wake_pin(uint32_t pin);
+void sleep_local();
+bool sleep_standby_allowed();
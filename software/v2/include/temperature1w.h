@@ -2,15 +2,23 @@
 #include <Arduino.h>
 #include <Vector.h>
 
-// These two vectors can be accessed outside of this file
-extern Vector<String> temp_sensor_names;
-extern Vector<float> temp_sensor_values;
+// These vectors can be accessed outside of this file
+extern Vector<String, 0> temp_sensor_names;
+extern Vector<float, 0> temp_sensor_values;
+extern Vector<float, 0> temp_sensor_tf_out;
 
 void get_water_temperature(float &temperature_C, bool &temp_good);
+void get_water_temperature_last(float &temperature_C, bool &temp_good);
 void setup_temperature();
+void setup_temperature_if_required();
+void invalidate_temperature_bus();
+void clear_temperature_bindings();
 int get_temperature_device_count();
+size_t get_temperature_probe_count();
 void populate_names_temp_sensor();
 String temperature_bus_info();
-void populate_values_temp_sensor();
-Vector<float> get_tf_temperature();
+bool populate_values_temp_sensor();
+unsigned long start_temperature_conversion();
+bool read_temperature_conversion();
+const Vector<float, 0> &get_tf_temperature();
 
@@ -0,0 +1,9 @@
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+
+int32_t days_from_civil(int year, int month, int day);
+void civil_from_days(int32_t z, int &year, int &month, int &day);
+uint32_t epoch_from_time(int day, int month, int year, int hour, int minute, int second);
+void time_from_epoch(uint32_t t, int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum);
+uint32_t next_interval_epoch(uint32_t now, uint32_t m);
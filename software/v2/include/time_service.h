@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+#include "DS3231.h"
+
+void setup_time_service(DS3231 *rtc);
+void time_service_sync();
+void time_service_now(uint32_t &epoch, uint16_t &ms);
+uint32_t time_service_epoch();
+uint64_t time_service_epoch_ms();
+void time_service_time(int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum);
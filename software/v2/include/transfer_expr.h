@@ -0,0 +1,15 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+const size_t EXPR_MAX_STACK = 8;        // depth of the evaluation stack
+
+const char *expr_compile(const char *src, uint8_t *code, size_t size, size_t &len);
+bool expr_valid(const uint8_t *code, size_t len);
+float expr_eval(const uint8_t *code, size_t len, const float *var, const float *k);
+bool expr_uses_constant(const uint8_t *code, size_t len, size_t k);
+String expr_to_string(const uint8_t *code, size_t len);
+bool set_transfer_constant(String name, float v);
+bool del_transfer_constant(String name);
+void print_transfer_constants();
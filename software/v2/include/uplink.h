@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+#include "data_storage.h"
+
+void setup_uplink();
+bool uplink_due_next();
+bool uplink_record(const struct main_data_storage &d, bool stored, uint32_t offset, bool now);
+size_t get_uplink_pending();
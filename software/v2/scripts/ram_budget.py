@@ -0,0 +1,108 @@
+"""
+RAM budget of the firmware: the static RAM (.data and .bss) of each object file from the linker map file.
+
+PlatformIO runs this script after the build (extra_scripts in platformio.ini):
+the linker writes firmware.map to the build directory, and the table is printed after firmware.elf is linked.
+
+The script can also be run on a map file:
+    python3 scripts/ram_budget.py .pio/build/mkrzero/firmware.map [ram_size]
+
+The arena (src/arena.cpp) is one entry in the table, and the use of each region is printed by the mem command.
+"""
+import os
+import re
+import sys
+from collections import defaultdict
+
+RAM_SIZE = 32768        # SAMD21G18 (MKR Zero)
+
+# input section line of the map file: " .bss.name  0x20000000  0x10 path/file.o"
+# (the lines of the output sections, such as ".data  0x20000000  0x130 load address 0x0000ba0c", are not indented)
+SECTION_RE = re.compile(r'^\s+(\.data|\.bss|COMMON)(\S*)?\s*$|^\s+(\.data\S*|\.bss\S*|COMMON)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$')
+ADDRESS_RE = re.compile(r'^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$')
+
+
+def module_name(path):
+    """Name of the object file (archive(member) for a library)"""
+    path = path.strip()
+    m = re.match(r'^(.*)\((.*)\)$', path)
+    if m:
+        return os.path.basename(m.group(1)) + '(' + m.group(2) + ')'
+    return os.path.basename(path)
+
+
+def parse_map(lines):
+    """Returns {module: [data, bss]} of the input sections in RAM"""
+    modules = defaultdict(lambda: [0, 0])
+    in_memory_map = False
+    pending = None          # section name that is split from its address over two lines
+    for line in lines:
+        if line.startswith('Linker script and memory map'):
+            in_memory_map = True
+            continue
+        if not in_memory_map:
+            continue
+        if line.startswith('/DISCARD/'):
+            break
+        if pending is not None:
+            m = ADDRESS_RE.match(line)
+            name, pending = pending, None
+            if m:
+                add_section(modules, name, int(m.group(1), 16), int(m.group(2), 16), m.group(3))
+                continue
+        m = SECTION_RE.match(line)
+        if not m:
+            continue
+        if m.group(1):
+            pending = m.group(1) + (m.group(2) or '')
+        else:
+            add_section(modules, m.group(3), int(m.group(4), 16), int(m.group(5), 16), m.group(6))
+    return modules
+
+
+def add_section(modules, name, address, size, path):
+    if size == 0 or address == 0:
+        return
+    kind = 0 if name.startswith('.data') else 1
+    modules[module_name(path)][kind] += size
+
+
+def print_budget(modules, ram_size):
+    rows = sorted(modules.items(), key=lambda kv: kv[1][0] + kv[1][1], reverse=True)
+    total_data = sum(v[0] for v in modules.values())
+    total_bss = sum(v[1] for v in modules.values())
+    width = max([len(k) for k in modules] + [len('TOTAL')])
+    print('')
+    print('RAM budget (%d bytes)' % ram_size)
+    print('%-*s %8s %8s %8s %7s' % (width, 'MODULE', 'DATA', 'BSS', 'TOTAL', 'RAM%'))
+    for name, (data, bss) in rows:
+        print('%-*s %8d %8d %8d %6.1f%%' % (width, name, data, bss, data + bss, 100.0 * (data + bss) / ram_size))
+    total = total_data + total_bss
+    print('%-*s %8d %8d %8d %6.1f%%' % (width, 'TOTAL', total_data, total_bss, total, 100.0 * total / ram_size))
+    print('%-*s %26d %6.1f%%' % (width, 'heap + stack', ram_size - total, 100.0 * (ram_size - total) / ram_size))
+
+
+def run(map_file, ram_size):
+    with open(map_file) as f:
+        print_budget(parse_map(f.readlines()), ram_size)
+
+
+def platformio_script():
+    Import('env')       # noqa: F821 (defined by SCons)
+    map_file = os.path.join(env.subst('$BUILD_DIR'), 'firmware.map')     # noqa: F821
+    env.Append(LINKFLAGS=['-Wl,-Map,' + map_file])                      # noqa: F821
+    ram_size = int(env.BoardConfig().get('upload.maximum_ram_size', RAM_SIZE))    # noqa: F821
+
+    def post_build(source, target, env):
+        run(map_file, ram_size)
+
+    env.AddPostAction('$BUILD_DIR/${PROGNAME}.elf', post_build)        # noqa: F821
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('usage: ram_budget.py <map file> [ram size]')
+        sys.exit(1)
+    run(sys.argv[1], int(sys.argv[2]) if len(sys.argv) > 2 else RAM_SIZE)
+else:
+    platformio_script()
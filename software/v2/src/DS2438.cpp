@@ -17,13 +17,20 @@ DS2438::DS2438(uint8_t pin, float senseR, bool pp) : w(pin)
     this->pin =  pin;
     this->senseR = senseR;
     this->pp = pp;
+    cached = false;
 } // end
 
 
+/*
+Full ROM search of the bus.
+This takes tens of ms of bus time per device, so call findIfRequired()
+during sampling and only call this function to force a re-scan.
+*/
 void DS2438::findAll()
 {   
     uint8_t a[ADDR_SIZ]; 
     addresses.clear();
+    cached = true;
     while(1)
     {
         if (!w.search(a))
@@ -40,6 +47,33 @@ void DS2438::findAll()
 } // end
 
 
+/*
+Use the cached addresses if a device still answers the reset with a presence pulse.
+The bus is only searched again if there is no cache, the cache is empty, the presence
+pulse is missing or a previous read failed the CRC check (see invalidate()).
+Returns true if there are addresses to use.
+*/
+bool DS2438::findIfRequired()
+{
+    if (cached && addresses.size() != 0)
+    {
+        if (w.reset() == 1) return true;   // presence pulse, so the cached devices are on the bus
+        invalidate();
+    }
+    findAll();
+    return addresses.size() != 0;
+} // end
+
+
+/*
+Invalidate the cached addresses so that the next findIfRequired() searches the bus.
+*/
+void DS2438::invalidate()
+{
+    cached = false;
+} // end
+
+
 String DS2438::allAddressString()
 {
     String s = "";
@@ -86,24 +120,25 @@ void DS2438::getDataAll(Vector<DS2438Info> &output)
     int siz = addresses.size();
     for (int k = 0; k < siz; k++)
     {
-        wAddr a = addresses[k];
-        float temperature, voltage, current, capacity;
-        uint32_t uptime;
-        bool rv = readMainData(temperature, voltage, current, a.get());        
-        if (rv==false) break;
-        rv = readTimeOperationCapacity(uptime, capacity, a.get());
-        if (rv==false) break;
-
         DS2438Info info;
-        info.temperature = temperature;
-        info.voltage = voltage;
-        info.current = current;
-        info.uptime = uptime;
-        info.capacity = capacity;
-        String aString = a.getString();
-        aString.toCharArray(info.astring, CHARS_ADDR);
+        if (!getData(k, info)) { invalidate(); break; }
         output.push_back(info);
     }
+} // end
+
+
+/*
+Read the data of the device k into info without using the heap.
+Returns false if the device cannot be read.
+*/
+bool DS2438::getData(size_t k, DS2438Info &info)
+{
+    if (k >= addresses.size()) return false;
+    uint8_t *addr = addresses[k].get();
+    if (!readMainData(info.temperature, info.voltage, info.current, addr)) return false;
+    if (!readTimeOperationCapacity(info.uptime, info.capacity, addr)) return false;
+    addresses[k].getChars(info.astring, CHARS_ADDR);
+    return true;
 } // end 
 
 
@@ -115,10 +150,10 @@ void DS2438::getDataVAD(Vector<DS2438VAD> &output)
         wAddr a = addresses[k];
         float v; 
         bool rv = readVAD(v, a.get());
-        if (rv==false) break;
+        if (rv==false) { invalidate(); break; }
         DS2438VAD out;
-        String aString = a.getString();
-        aString.toCharArray(out.astring, CHARS_ADDR);
+        out.vad = v;
+        a.getChars(out.astring, CHARS_ADDR);
         output.push_back(out);
     }
 } // end 
@@ -222,19 +257,48 @@ bool DS2438::readMainData(float &temperature, float &voltage, float &current, ui
     voltage = 10e-3f * (float)volt;
 
     // CURRENT
+    current = currentFromPage(data);
+
+    // DONE
+    return true;
+} // end
+
+
+// Current (A) from page 0
+float DS2438::currentFromPage(uint8_t *data)
+{
     uint8_t current_lsb = data[5];
     uint8_t current_msb = data[6];
-    is_neg = false;
+    bool is_neg = false;
     uint16_t curr = ((uint16_t)current_msb << 8u) | ((uint16_t)current_lsb);
     if(checkBit(current_msb, 7))
     {
         is_neg = true;
         curr = ~curr + 0x01;
     }
-    current = (float)curr / (4096.0f * senseR);
+    float current = (float)curr / (4096.0f * senseR);
     if (is_neg) current *= -1.0f;
+    return current;
+} // end
 
-    // DONE
+
+/*
+Read the current (A) of the first device without starting the temperature and voltage conversions.
+The current ADC of the DS2438 runs continuously, so this only recalls and reads page 0.
+This is much faster than getDataAll() and is used to profile the power during the sample.
+*/
+bool DS2438::readCurrent(float &current)
+{
+    if (addresses.size() == 0) return false;
+    wAddr a = addresses[0];
+    uint8_t first_cmd[2] = {0xB8, 0x00};    // recall memory
+    if (!resetSelectCmd(a.get(), first_cmd, 2)) return false;
+    uint8_t second_cmd[2]  = {0xBE, 0x00};  // read memory
+    if (!resetSelectCmd(a.get(), second_cmd, 2)) return false;
+
+    uint8_t data[PAGE_BYTES];
+    if (!readPage(a.get(), data)) return false;
+    current = currentFromPage(data);
     return true;
 } // end
 
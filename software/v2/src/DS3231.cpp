@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include "DS3231.h"
 #include "BitFun.h"
+#include "time_helper.h"
 
 
 // Constants
@@ -216,6 +217,14 @@ void DS3231::getTime(int &day, int &month, int &year, int &hour, int &minute, in
     year = bcdToDecimal(data[6]) + 2000;
 } // end 
 
+// Read only the seconds register (used to find the start of the second)
+int DS3231::getSeconds()
+{
+    uint8_t data;
+    readReg(SECONDS_REGISTER, data);
+    return bcdToDecimal(data);
+} // end 
+
 bool DS3231::checkRange(int day, int month, int year, int hour, int minute, int second)
 {
     if (day < 1) return false;
@@ -300,6 +309,24 @@ bool DS3231::setAlarmOnceMinuteOrSecond(uint8_t code)
 } // end
 
 
+/*
+Function to set alarm #2 for the next sample at an interval of m minutes.
+The alarm matches the date, hours and minutes so that the alarm only fires once per sample
+for intervals up to one week.
+next is the time of the alarm as seconds since 1970-01-01.
+*/
+bool DS3231::setAlarmNextInterval(int m, uint32_t &next)
+{
+    if (m < 1) return false;
+    int day, month, year, hour, minute, second, dayNum;
+    getTime(day, month, year, hour, minute, second, dayNum);
+    uint32_t now = epoch_from_time(day, month, year, hour, minute, second);
+    next = next_interval_epoch(now, m);
+    time_from_epoch(next, day, month, year, hour, minute, second, dayNum);
+    return setAlarm(DS3231_ALARM2_DAY_HOURS_MINUTES_MATCH, day, 1, hour, minute, 0, dayNum, 2);
+} // end
+
+
 // Function to set the RTC alarm
 // numAlarm = 1 or 2 for the number of the alarm 
 bool DS3231::setAlarm(uint8_t code, int day, int month, int hour, int minute, int second, int dayNum, int numAlarm)
@@ -375,6 +402,31 @@ void DS3231::offAlarms()
 } // end
 
 
+/*
+Read the aging offset (about 0.1 ppm per LSB at 25 C, positive values slow the oscillator)
+*/
+int8_t DS3231::getAgingOffset()
+{
+    uint8_t data;
+    readReg(AGING_OFFSET_REGISTER, data);
+    return static_cast<int8_t>(data);
+} // end
+
+
+/*
+Write the aging offset.
+The conversion is started so that the offset is used immediately (and not after the next 64 s conversion).
+*/
+void DS3231::setAgingOffset(int8_t offset)
+{
+    writeReg(AGING_OFFSET_REGISTER, static_cast<uint8_t>(offset));
+    uint8_t cr;
+    readReg(CONTROL_REGISTER, cr);
+    setBit(cr, 5);                  // CONV
+    writeReg(CONTROL_REGISTER, cr);
+} // end
+
+
 // Read the control status register
 uint8_t DS3231::readStatus()
 {
@@ -3,7 +3,6 @@
 #include "GPS.h"
 #include "gpio.h"
 #include "main_local.h"
-#include "string_helper.h"
 #include "constants.h"
 
 struct last_gps_fix gdata;
@@ -12,10 +11,21 @@ GPS::GPS(Stream *serial)
 {
       this->serial = serial;
       poll = false;
+      feeding = false;
+      last_good_ms = 0;
+      gdata.good = false;
+      ep_key = -1;
+      ep_have = 0;
+      ep_published = false;
+      ep_valid = false;
+      ep_agree = false;
+      gst_seen = false;
+      gst_miss = 0;
 } // end
 
 
 // For debugging only
+// When the poll is on, the bytes from the GPS are echoed to the debug port as they are parsed
 void GPS::start_poll()
 {
       poll = true;
@@ -31,133 +41,47 @@ void GPS::end_poll()
 // For debugging only 
 void GPS::run_poll()
 {
-      if (poll==false) return;
-      if(serial->available())
+      feed();
+} // end
+
+
+/*
+Call this function often to parse the bytes from the GPS.
+The UART RX interrupt of the core places the bytes into the serial ring buffer, and this function 
+drains the ring buffer into the NMEA parser so that gdata is always updated with the last fix.
+This is called from the main loop and from yield() (which is called by delay()).
+*/
+void GPS::feed()
+{
+      if (feeding) return;
+      feeding = true;
+      while(serial->available())
       {
             char c = (char)serial->read();
-            Serial.print(c);
+            if (poll) Serial.print(c);
+            const char *line = parser.feed(c);
+            if (line != NULL) parse_sentence(line);
       }
+      feeding = false;
 } // end
 
 
-// Call this function to read the data from the GPS
-// CLI: sample-gps
-void GPS::read_data()
+/*
+Call this function to wait for a current fix from the GPS.
+The function returns as soon as the fix is current, or false after timeout_ms.
+CLI: sample-gps
+*/
+bool GPS::read_data(unsigned long timeout_ms)
 {
-      gdata.good = false;
-      memset(gdata.line,0,GPS_MAX_BYTES);
-      serial->readBytes(gdata.line, GPS_MAX_BYTES-1);
-      const char *tok = "\n\r";
-      char *line_out = strtok(gdata.line, tok);
-      while(line_out != NULL)
-      {     
-            char *line = trimwhitespace(line_out);
-
-            #ifdef DEBUG_GPS
-                  print_debug(String(line));
-            #endif
-
-            switch(minmea_sentence_id(line, false))
-            {
-                  case MINMEA_SENTENCE_RMC:
-                  {
-                         struct minmea_sentence_rmc frame;
-                         if (minmea_parse_rmc(&frame, line))
-                         {
-                              gdata.lat = minmea_tocoord(&frame.latitude);
-                              gdata.lng = minmea_tocoord(&frame.longitude);
-                              gdata.speed = minmea_tofloat(&frame.speed);
-                              gdata.hours = frame.time.hours;
-                              gdata.minutes = frame.time.minutes;
-                              gdata.seconds = frame.time.seconds;
-                              gdata.microseconds = frame.time.microseconds;
-                              gdata.day = frame.date.day;
-                              gdata.month = frame.date.month;
-                              gdata.year = frame.date.year;
-                         }
-                  } break;
-                  case MINMEA_SENTENCE_GGA:
-                  {
-                        struct minmea_sentence_gga frame;
-                        if (minmea_parse_gga(&frame, line))
-                        {
-                              gdata.lat = minmea_tocoord(&frame.latitude);
-                              gdata.lng = minmea_tocoord(&frame.longitude);
-                              gdata.alt = minmea_tofloat(&frame.altitude);
-                              gdata.hours = frame.time.hours;
-                              gdata.minutes = frame.time.minutes;
-                              gdata.seconds = frame.time.seconds;
-                              gdata.fix_quality = frame.fix_quality;
-                              gdata.satellites = frame.satellites_tracked;
-                              gdata.height = minmea_tofloat(&frame.height);
-                        }
-                  } break;
-                  case MINMEA_SENTENCE_GSA:
-                  {  
-                  }
-                  case MINMEA_SENTENCE_GLL:
-                  {
-                        struct minmea_sentence_gll frame;
-                        if (minmea_parse_gll(&frame, line))
-                        {
-                              gdata.lat = minmea_tocoord(&frame.latitude);
-                              gdata.lng = minmea_tocoord(&frame.longitude);
-                              gdata.hours = frame.time.hours;
-                              gdata.minutes = frame.time.minutes;
-                              gdata.seconds = frame.time.seconds;
-                        }
-                  } break;
-                  case  MINMEA_SENTENCE_GST:
-                  {
-                        struct minmea_sentence_gst frame;
-                        if (minmea_parse_gst(&frame, line))
-                        {
-                              gdata.hours = frame.time.hours;
-                              gdata.minutes = frame.time.minutes;
-                              gdata.seconds = frame.time.seconds;
-                              gdata.lat_err = minmea_tocoord(&frame.latitude_error_deviation); 
-                              gdata.long_err = minmea_tocoord(&frame.longitude_error_deviation);
-                              gdata.alt_err = minmea_tofloat(&frame.altitude_error_deviation);
-                        }
-                  }
-                  case MINMEA_SENTENCE_GSV:
-                  {
-                      struct minmea_sentence_gsv frame;  
-                      if (minmea_parse_gsv(&frame, line))
-                      {
-                        gdata.total_sats = frame.total_sats;
-                      }
-                  } break;
-                  case MINMEA_SENTENCE_VTG:
-                  {    
-                  } break;
-                  case MINMEA_SENTENCE_ZDA:
-                  {
-                        struct minmea_sentence_zda frame;
-                        if(minmea_parse_zda(&frame, line))
-                        {
-                              gdata.day = frame.date.day;
-                              gdata.month = frame.date.month;
-                              gdata.year = frame.date.year;
-                              gdata.hours = frame.time.hours;
-                              gdata.minutes = frame.time.minutes;
-                              gdata.seconds = frame.time.seconds;     
-                        }
-                  } break;
-                  case MINMEA_INVALID:  // incomplete string, so do nothing
-                  {
-                  } break;
-                  default:
-                  {
-                  } break;
-            } // end case
-            line_out = strtok(NULL, tok);  // grab the next line
-      } // end while
-
-      // check to see if the data is good
-      if (gdata.satellites != 0 && !isnan(gdata.lat) && !isnan(gdata.lng)) gdata.good = true;
-
-
+      unsigned long start = millis();
+      feed();
+      while(!is_fix_current())
+      {
+            if (millis() - start >= timeout_ms) break;
+            delay(1);
+            feed();
+      }
+      bool rv = is_fix_current();
 #ifdef DEBUG_GPS
       print_debug("GPS data:");
       print_debug("lat:");
@@ -196,16 +120,310 @@ void GPS::read_data()
       print_debug(String(gdata.satellites));
       print_debug("total_sats:"); 
       print_debug(String(gdata.total_sats));
+      print_debug("hdop:"); 
+      print_debug(String(gdata.hdop));
+      print_debug("pdop:"); 
+      print_debug(String(gdata.pdop));
+      print_debug("vdop:"); 
+      print_debug(String(gdata.vdop));
       print_debug("good:");
       print_debug(String(gdata.good));
+
+      print_debug("GPS sentences good:");
+      print_debug(String(parser.get_num_good()));
+      print_debug("GPS sentences bad:");
+      print_debug(String(parser.get_num_bad()));
 #endif
+      return rv;
+} // end
+
+
+/*
+Returns true if the last sentences gave a good fix that is not too old.
+The fix will become old when the GPS is turned off with the 5V rail.
+*/
+bool GPS::is_fix_current()
+{
+      return gdata.good && (millis() - last_good_ms) < GPS_FIX_MAX_AGE;
+} // end
+
+
+// Key used to identify the epoch (ms since midnight UTC) from the time in a sentence
+static long epoch_key(const struct minmea_time &t)
+{
+      if (t.hours < 0) return -1;  // sentence without a time
+      return ((t.hours*60L + t.minutes)*60L + t.seconds)*1000L + t.microseconds/1000L;
+} // end
+
+
+/*
+Start assembling a new epoch if the time of the sentence is different from the current epoch.
+Returns false if the sentence does not have a time.
+*/
+bool GPS::start_epoch(const struct minmea_time &t)
+{
+      long key = epoch_key(t);
+      if (key < 0) return false;
+      if (key == ep_key) return true;
+      if (gst_seen && ep_have != 0 && !(ep_have & GPS_EPOCH_GST) && ++gst_miss >= GPS_GST_MAX_MISS)
+      {
+            gst_seen = false;     // the GST output was turned off, so do not wait for GST
+      }
+      ep_key = key;
+      ep_have = 0;
+      ep_published = false;
+      int total_sats = ep.total_sats;
+      memset(&ep, 0, sizeof(ep));
+      ep.lat = NAN;
+      ep.lng = NAN;
+      ep.speed = NAN;
+      ep.alt = NAN;
+      ep.height = NAN;
+      ep.lat_err = NAN;
+      ep.long_err = NAN;
+      ep.alt_err = NAN;
+      ep.hdop = NAN;
+      ep.pdop = NAN;
+      ep.vdop = NAN;
+      ep.day = gdata.day;           // the date is only in RMC and ZDA
+      ep.month = gdata.month;
+      ep.year = gdata.year;
+      ep.total_sats = total_sats;   // GSV is sent over several sentences without a time
+      ep.hours = t.hours;
+      ep.minutes = t.minutes;
+      ep.seconds = t.seconds;
+      ep.microseconds = t.microseconds;
+      return true;
+} // end
+
+
+/*
+Publish the epoch to gdata when RMC and GGA (and GST if the receiver sends GST) of the epoch have been received.
+The receiver is taken to not send GST after GPS_GST_MAX_MISS epochs without GST, or after reset_epoch().
+The fix is only good if the sentences agree.
+*/
+void GPS::check_epoch()
+{
+      if (ep_published) return;
+      uint8_t need = GPS_EPOCH_RMC | GPS_EPOCH_GGA;
+      if (gst_seen) need |= GPS_EPOCH_GST;
+      if ((ep_have & need) != need) return;
+      ep.good = ep_valid && ep.satellites != 0 && ep.fix_quality != 0 && !isnan(ep.lat) && !isnan(ep.lng) && ep_agree;
+      ep.rx_ms = millis();
+      gdata = ep;
+      ep_published = true;
+      if (gdata.good) last_good_ms = millis();
+} // end
+
+
+// Returns true if the positions from two sentences of the same epoch are the same
+static bool gps_same_position(float lat0, float lng0, float lat1, float lng1)
+{
+      if (isnan(lat0) || isnan(lng0) || isnan(lat1) || isnan(lng1)) return false;
+      return fabs(lat0 - lat1) < GPS_EPOCH_MAX_DIFF_DEG && fabs(lng0 - lng1) < GPS_EPOCH_MAX_DIFF_DEG;
+} // end
+
+
+/*
+Parse one complete NMEA sentence that has passed the checksum.
+The fix is assembled from the sentences with the same UTC time, so that fields from different epochs are not mixed.
+*/
+void GPS::parse_sentence(const char *line)
+{
+      #ifdef DEBUG_GPS
+            print_debug(String(line));
+      #endif
+
+      switch(minmea_sentence_id(line, false))
+      {
+            case MINMEA_SENTENCE_RMC:
+            {
+                  struct minmea_sentence_rmc frame;
+                  if (minmea_parse_rmc(&frame, line) && start_epoch(frame.time))
+                  {
+                        float lat = minmea_tocoord(&frame.latitude);
+                        float lng = minmea_tocoord(&frame.longitude);
+                        if (ep_have & GPS_EPOCH_GGA) ep_agree = gps_same_position(ep.lat, ep.lng, lat, lng);
+                        else ep_agree = true;
+                        ep_valid = frame.valid;
+                        ep.lat = lat;
+                        ep.lng = lng;
+                        ep.speed = minmea_tofloat(&frame.speed);
+                        ep.day = frame.date.day;
+                        ep.month = frame.date.month;
+                        ep.year = frame.date.year;
+                        ep_have |= GPS_EPOCH_RMC;
+                  }
+            } break;
+            case MINMEA_SENTENCE_GGA:
+            {
+                  struct minmea_sentence_gga frame;
+                  if (minmea_parse_gga(&frame, line) && start_epoch(frame.time))
+                  {
+                        float lat = minmea_tocoord(&frame.latitude);
+                        float lng = minmea_tocoord(&frame.longitude);
+                        if (ep_have & GPS_EPOCH_RMC) ep_agree = gps_same_position(ep.lat, ep.lng, lat, lng);
+                        else ep_agree = true;
+                        ep.lat = lat;
+                        ep.lng = lng;
+                        ep.alt = minmea_tofloat(&frame.altitude);
+                        ep.fix_quality = frame.fix_quality;
+                        ep.satellites = frame.satellites_tracked;
+                        ep.hdop = minmea_tofloat(&frame.hdop);
+                        ep.height = minmea_tofloat(&frame.height);
+                        ep_have |= GPS_EPOCH_GGA;
+                  }
+            } break;
+            case MINMEA_SENTENCE_GSA:
+            {
+                  // GSA does not have a time, so it is part of the epoch being assembled
+                  struct minmea_sentence_gsa frame;
+                  if (minmea_parse_gsa(&frame, line))
+                  {
+                        ep.pdop = minmea_tofloat(&frame.pdop);
+                        ep.vdop = minmea_tofloat(&frame.vdop);
+                        if (isnan(ep.hdop)) ep.hdop = minmea_tofloat(&frame.hdop);
+                        if (ep_published)
+                        {
+                              gdata.pdop = ep.pdop;
+                              gdata.vdop = ep.vdop;
+                              gdata.hdop = ep.hdop;
+                        }
+                  }
+            } break;
+            case MINMEA_SENTENCE_GLL:
+            {
+                  // GLL is not required for the fix
+            } break;
+            case  MINMEA_SENTENCE_GST:
+            {
+                  struct minmea_sentence_gst frame;
+                  if (minmea_parse_gst(&frame, line) && start_epoch(frame.time))
+                  {
+                        gst_seen = true;
+                        gst_miss = 0;
+                        ep.lat_err = minmea_tofloat(&frame.latitude_error_deviation);   // m
+                        ep.long_err = minmea_tofloat(&frame.longitude_error_deviation); // m
+                        ep.alt_err = minmea_tofloat(&frame.altitude_error_deviation);   // m
+                        ep_have |= GPS_EPOCH_GST;
+                  }
+            } break;
+            case MINMEA_SENTENCE_GSV:
+            {
+                  struct minmea_sentence_gsv frame;  
+                  if (minmea_parse_gsv(&frame, line))
+                  {
+                        ep.total_sats = frame.total_sats;
+                        gdata.total_sats = frame.total_sats;
+                  }
+            } break;
+            case MINMEA_SENTENCE_VTG:
+            {    
+            } break;
+            case MINMEA_SENTENCE_ZDA:
+            {
+                  // ZDA is usually sent after RMC and GGA, so the date is also applied to the published fix
+                  struct minmea_sentence_zda frame;
+                  if(minmea_parse_zda(&frame, line) && epoch_key(frame.time) == ep_key)
+                  {
+                        ep.day = frame.date.day;
+                        ep.month = frame.date.month;
+                        ep.year = frame.date.year;
+                        if (ep_published)
+                        {
+                              gdata.day = ep.day;
+                              gdata.month = ep.month;
+                              gdata.year = ep.year;
+                        }
+                  }
+            } break;
+            case MINMEA_INVALID:  // incomplete string, so do nothing
+            {
+            } break;
+            default:
+            {
+            } break;
+      } // end case
+      check_epoch();
 } // end
 
 
 /*
-Obtain the last GPS data for use elsewhere in the program
+Obtain the last GPS data for use elsewhere in the program.
+This is a copy of the fix that is kept updated by feed().
 */
 void GPS::obtain_gps_data(struct last_gps_fix *d)
 {
+      feed();
       *d = gdata;
+      d->good = is_fix_current();
+} // end
+
+
+/*
+Put the u-blox receiver into backup mode (UBX-RXM-PMREQ) when the 5V rail is kept on between samples.
+The receiver keeps the ephemeris and the RTC so that the next fix is a hot start.
+The receiver is woken by activity on the UART RX line.
+REFERENCE:
+u-blox 8 / u-blox M8 Receiver Description, Section 32.17.3 (UBX-RXM-PMREQ)
+*/
+void GPS::standby()
+{
+      uint8_t payload[16];
+      memset(payload, 0, sizeof(payload));
+      payload[8] = 0x02;      // flags: backup
+      payload[12] = 0x08;     // wakeupSources: uartrx
+      send_ubx(0x02, 0x41, payload, sizeof(payload));
+      serial->flush();
+} // end
+
+
+/*
+Wake the receiver from backup mode.  The first bytes on the RX line are lost while the receiver wakes up.
+*/
+void GPS::wake()
+{
+      for(int k = 0; k < 8; k++) serial->write((uint8_t)0xFF);
+      serial->flush();
+      reset_epoch();
+} // end
+
+
+/*
+Call this function when the receiver is powered on or woken.
+The configuration of the receiver (such as the GST output) might be different after the power cycle,
+so the epoch being assembled and the GST state are cleared.
+*/
+void GPS::reset_epoch()
+{
+      ep_key = -1;
+      ep_have = 0;
+      ep_published = false;
+      gst_seen = false;
+      gst_miss = 0;
+} // end
+
+
+// Send a UBX message with the 8-bit Fletcher checksum
+void GPS::send_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+      uint8_t hdr[4] = {cls, id, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
+      uint8_t ck_a = 0;
+      uint8_t ck_b = 0;
+      for(int k = 0; k < 4; k++)
+      {
+            ck_a += hdr[k];
+            ck_b += ck_a;
+      }
+      for(uint16_t k = 0; k < len; k++)
+      {
+            ck_a += payload[k];
+            ck_b += ck_a;
+      }
+      serial->write((uint8_t)0xB5);
+      serial->write((uint8_t)0x62);
+      serial->write(hdr, 4);
+      serial->write(payload, len);
+      serial->write(ck_a);
+      serial->write(ck_b);
 } // end
@@ -40,7 +40,7 @@ bool GetFileName::set_month(int m)
 // Obtain the file name with UUID
 // Before this function is called, the seed must be set using the set_seed() function
 // fn = a vector with a list of file names in the directory
-String GetFileName::get_file_name(Vector<String> fn)
+String GetFileName::get_file_name(const Vector<String> &fn)
 {
 	const String dot = ".";
 	const String dash = "-";
@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include "MaximUniqueSerial.h"
 #include "main_local.h"
+#include "crc.h"
 
 MaximUniqueSerial::MaximUniqueSerial(uint8_t addr)
 {
@@ -22,7 +23,7 @@ bool MaximUniqueSerial::getData()
         data[k] = (uint8_t)c;
     }
     Wire.endTransmission(); 
-    uint8_t ans = (uint8_t)dallasCrc8(data, (unsigned int)(BYTES_MAX_MAXIM_UNIQUE-1));
+    uint8_t ans = crc8_dallas(data, BYTES_MAX_MAXIM_UNIQUE-1);
     if (ans==data[BYTES_MAX_MAXIM_UNIQUE-1]) return true;
     return false;
 } // end
@@ -33,37 +34,27 @@ NOTE that this also includes the CRC as the last number.
 */ 
 bool MaximUniqueSerial::getString(String &s)
 {
-    bool good = getData();              // obtain the data before concatenating the string
-    if (good==false) return false;      // check to see if the data is good before continuing
-    s = "";
-    for (size_t k = 0; k < BYTES_MAX_MAXIM_UNIQUE; k++)
-    {
-        s += String((uint32_t)(data[k])) + " ";
-    }
+    char buf[MAXIM_SERIAL_CHARS];
+    if (!getChars(buf, sizeof(buf))) return false;
+    s = buf;
     return true;
 }
 
 
 /*
-Maxim CRC
-REFERENCE:
-https://stackoverflow.com/questions/29214301/ios-how-to-calculate-crc-8-dallas-maxim-of-nsdata 
+Obtain the serial number into s (at least MAXIM_SERIAL_CHARS) without using the heap.
+s is not changed if the data is not good.
 */
-unsigned char MaximUniqueSerial::dallasCrc8(const unsigned char * data, const unsigned int size)
+bool MaximUniqueSerial::getChars(char *s, size_t size)
 {
-    unsigned char crc = 0;
-    for ( unsigned int i = 0; i < size; ++i )
+    bool good = getData();              // obtain the data before formatting the string
+    if (good==false) return false;      // check to see if the data is good before continuing
+    size_t n = 0;
+    for (size_t k = 0; k < BYTES_MAX_MAXIM_UNIQUE && n < size; k++)
     {
-        unsigned char inbyte = data[i];
-        for ( unsigned char j = 0; j < 8; ++j )
-        {
-            unsigned char mix = (crc ^ inbyte) & 0x01;
-            crc >>= 1;
-            if ( mix ) crc ^= 0x8C;
-            inbyte >>= 1;
-        }
+        n += snprintf(s + n, size - n, "%u ", (unsigned int)data[k]);
     }
-    return crc;
+    return true;
 }
 
 
@@ -15,33 +15,30 @@ class MyWaterWatcherOptions : public WaterWatcherOptions
         //-------------------------------------------------
         // TRANSFER FUNCTION OUTPUTS
         // OVERRIDE THESE FUNCTIONS
+        // (the defaults apply the calibrations stored in flash with set-transfer)
         //-------------------------------------------------
-        float get_a0_out()
+        float get_a0_out() override
         {
             // Calibration calculation can be placed in here as a return value
-            float out = get_a0_raw(); 
-            return out;
+            return WaterWatcherOptions::get_a0_out();
         } // end
 
-        float get_a1_out()
+        float get_a1_out() override
         {
             // Calibration calculation can be placed in here as a return value
-            float out = get_a1_raw(); 
-            return out;
+            return WaterWatcherOptions::get_a1_out();
         } // end
             
-        float get_a2_out()
+        float get_a2_out() override
         {
             // Calibration calculation can be placed in here as a return value
-            float out = get_a2_raw(); 
-            return out;
+            return WaterWatcherOptions::get_a2_out();
         } // end
         
-        float get_temp0_out()
+        float get_temp0_out() override
         {
             // Calibration calculation can be placed in here as a return value
-            float out = get_temp0_raw(); 
-            return out;
+            return WaterWatcherOptions::get_temp0_out();
         } // end
 
 }; // end
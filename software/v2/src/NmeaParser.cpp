@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include "NmeaParser.h"
+
+/*
+Incremental NMEA 0183 sentence parser.
+Bytes are fed one at a time as they arrive from the serial port, and the XOR checksum
+is computed as the sentence is received.  When a complete sentence with a correct
+checksum has been received, feed() returns the sentence (starting with '$' and including
+the checksum) so that it can be passed to the minmea parsers.  Sentences that straddle
+reads of the serial port are therefore not lost.
+
+REFERENCE:
+https://www.nmea.org/content/STANDARDS/NMEA_0183_Standard
+*/
+
+NmeaParser::NmeaParser()
+{
+    num_good = 0;
+    num_bad = 0;
+    reset();
+} // end
+
+
+// Reset the state machine to wait for the start of the next sentence
+void NmeaParser::reset()
+{
+    state = NMEA_WAIT_START;
+    len = 0;
+    sum = 0;
+    expected = 0;
+    line[0] = '\0';
+} // end
+
+
+// Feed one byte into the parser.
+// Returns a pointer to the complete sentence or NULL if a sentence is not yet available.
+// The pointer is valid until the next call to feed().
+const char *NmeaParser::feed(char c)
+{
+    if (c == '$')  // always resynchronize on the start of a sentence
+    {
+        if (state != NMEA_WAIT_START) num_bad++;
+        reset();
+        add_char(c);
+        state = NMEA_BODY;
+        return NULL;
+    }
+    uint8_t v;
+    switch(state)
+    {
+        case NMEA_WAIT_START:
+        {
+        } break;
+        case NMEA_BODY:
+        {
+            if (c == '*')
+            {
+                if (!add_char(c)) break;
+                state = NMEA_CHECKSUM_HIGH;
+            }
+            else if (c == '\r' || c == '\n' || c < ' ' || c > '~')
+            {
+                num_bad++;
+                reset();
+            }
+            else
+            {
+                sum ^= (uint8_t)c;
+                add_char(c);
+            }
+        } break;
+        case NMEA_CHECKSUM_HIGH:
+        {
+            if (!hex_value(c, v))
+            {
+                num_bad++;
+                reset();
+                break;
+            }
+            expected = v << 4;
+            if (!add_char(c)) break;
+            state = NMEA_CHECKSUM_LOW;
+        } break;
+        case NMEA_CHECKSUM_LOW:
+        {
+            if (!hex_value(c, v))
+            {
+                num_bad++;
+                reset();
+                break;
+            }
+            expected |= v;
+            if (!add_char(c)) break;
+            state = NMEA_WAIT_END;
+        } break;
+        case NMEA_WAIT_END:
+        {
+            if (c != '\r' && c != '\n')
+            {
+                num_bad++;
+                reset();
+                break;
+            }
+            state = NMEA_WAIT_START;
+            if (expected != sum)
+            {
+                num_bad++;
+                return NULL;
+            }
+            num_good++;
+            return line;
+        } break;
+    } // end case
+    return NULL;
+} // end
+
+
+// Number of sentences with a correct checksum
+uint32_t NmeaParser::get_num_good()
+{
+    return num_good;
+} // end
+
+
+// Number of sentences that were discarded
+uint32_t NmeaParser::get_num_bad()
+{
+    return num_bad;
+} // end
+
+
+//-------------------------------------------------------------------------------------------
+
+bool NmeaParser::hex_value(char c, uint8_t &v)
+{
+    if (c >= '0' && c <= '9') v = c - '0';
+    else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+    else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+    else return false;
+    return true;
+} // end
+
+
+// Add a character to the line, discarding the sentence if it is too long
+bool NmeaParser::add_char(char c)
+{
+    if (len >= NMEA_MAX_BYTES-1)
+    {
+        num_bad++;
+        reset();
+        return false;
+    }
+    line[len++] = c;
+    line[len] = '\0';
+    return true;
+} // end
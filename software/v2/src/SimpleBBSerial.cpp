@@ -106,19 +106,43 @@ bool SimpleBBSerial::wait_for_timeout()
 
 
 
-bool SimpleBBSerial::sendString(String s)
+bool SimpleBBSerial::sendString(const String &s)
 {
-  unsigned int n = s.length();
-  for(unsigned int k = 0; k < n; k++)
+  return sendChars(s.c_str(), s.length());
+} // end
+
+
+bool SimpleBBSerial::sendChars(const char *s, size_t n)
+{
+  for(size_t k = 0; k < n; k++)
   {
     if(!wait_for_timeout()) return false;
-    char c = s.charAt(k);
-    sendSerialChar(static_cast<uint8_t>(c));
+    sendSerialChar(static_cast<uint8_t>(s[k]));
   }
   return true;
 } // end
 
 
+/*
+Receive up to size - 1 chars into s (always terminated) until the end char, a NULL char or a timeout.
+The end char is kept.  Returns the number of chars.  This does not use the heap.
+*/
+size_t SimpleBBSerial::receiveChars(char *s, size_t size, size_t timeout_cycles, char end)
+{
+  size_t n = 0;
+  if (size == 0) return 0;
+  while (n + 1 < size && timeout_cycles != 0)
+  {
+    uint8_t c = receiveChar(timeout_cycles);
+    if (c == 0) break;  // if a NULL char is received, exit the operation
+    s[n++] = (char)c;
+    if ((char)c == end) break;
+  }
+  s[n] = '\0';
+  return n;
+} // end
+
+
 uint8_t SimpleBBSerial::receiveChar(size_t timeout_cycles)
 {
   uint8_t out = 0;
@@ -0,0 +1,108 @@
+#include <Arduino.h>
+#include "SimpleTaskScheduler.h"
+
+/*
+Small cooperative run-to-completion scheduler.
+Each task is a function that does a short amount of work and then returns the time to wait
+before it is called again (or TASK_DONE).  A task that needs to wait for hardware returns
+instead of calling delay(), so that the main loop (CLI, watchdog, GPS parsing) keeps running
+and other tasks can run at the same time.
+*/
+
+SimpleTaskScheduler::SimpleTaskScheduler()
+{
+    cancelAll();
+} // end
+
+
+/*
+Add a task to be called after delay_ms.
+Returns the id of the task or NO_TASK if the task table is full.
+*/
+int SimpleTaskScheduler::add(task_func fn, unsigned long delay_ms)
+{
+    for(size_t k = 0; k < MAX_TASKS; k++)
+    {
+        if (tasks[k].active) continue;
+        tasks[k].fn = fn;
+        tasks[k].start = millis();
+        tasks[k].wait = delay_ms;
+        tasks[k].active = true;
+        return k;
+    }
+    return NO_TASK;
+} // end
+
+
+// Remove a task so that it is not called again
+void SimpleTaskScheduler::cancel(int id)
+{
+    if (id < 0 || id >= (int)MAX_TASKS) return;
+    tasks[id].active = false;
+} // end
+
+
+// Remove all tasks
+void SimpleTaskScheduler::cancelAll()
+{
+    for(size_t k = 0; k < MAX_TASKS; k++) tasks[k].active = false;
+} // end
+
+
+// Returns true if the task is still to be called
+bool SimpleTaskScheduler::isActive(int id)
+{
+    if (id < 0 || id >= (int)MAX_TASKS) return false;
+    return tasks[id].active;
+} // end
+
+
+/*
+Call the tasks that are due.
+This function is called from the main loop.
+*/
+void SimpleTaskScheduler::run()
+{
+    for(size_t k = 0; k < MAX_TASKS; k++)
+    {
+        if (!tasks[k].active) continue;
+        unsigned long now = millis();
+        if (now - tasks[k].start < tasks[k].wait) continue;
+        unsigned long next = tasks[k].fn();
+        if (!tasks[k].active) continue;   // the task was cancelled while running
+        if (next == TASK_DONE)
+        {
+            tasks[k].active = false;
+            continue;
+        }
+        tasks[k].start = millis();
+        tasks[k].wait = next;
+    }
+} // end
+
+
+// Returns true if there are no tasks
+bool SimpleTaskScheduler::idle()
+{
+    for(size_t k = 0; k < MAX_TASKS; k++)
+    {
+        if (tasks[k].active) return false;
+    }
+    return true;
+} // end
+
+
+// Returns the ms until the next task is due (TASK_DONE if there are no tasks)
+unsigned long SimpleTaskScheduler::msUntilNext()
+{
+    unsigned long now = millis();
+    unsigned long out = TASK_DONE;
+    for(size_t k = 0; k < MAX_TASKS; k++)
+    {
+        if (!tasks[k].active) continue;
+        unsigned long elapsed = now - tasks[k].start;
+        unsigned long left = elapsed >= tasks[k].wait ? 0 : tasks[k].wait - elapsed;
+        if (left < out) out = left;
+    }
+    return out;
+} // end
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include "WaterWatcherOptions.h"
+#include "calibration.h"
 
 WaterWatcherOptions::WaterWatcherOptions()
 {
@@ -12,7 +13,7 @@ WaterWatcherOptions::WaterWatcherOptions()
     set_a0_raw(NO_SAMPLE_VALUE);
     set_a1_raw(NO_SAMPLE_VALUE);
     set_a2_raw(NO_SAMPLE_VALUE);
-    set_temp0_raw(NO_SAMPLE_VALUE);
+    for(size_t k = 0; k < MAX_TEMP_SENSORS; k++) set_temp_raw(k, NO_SAMPLE_VALUE);
 } // end
 
 //-------------------------------------------------
@@ -58,7 +59,13 @@ void WaterWatcherOptions::set_a2_raw(float num)
 
 void WaterWatcherOptions::set_temp0_raw(float num)
 {
-    temp0_raw = num;
+    set_temp_raw(0, num);
+} // end
+
+void WaterWatcherOptions::set_temp_raw(size_t k, float num)
+{
+    if (k >= MAX_TEMP_SENSORS) return;
+    temp_raw[k] = num;
 } // end
 
 
@@ -83,7 +90,13 @@ float WaterWatcherOptions::get_a2_raw()
 
 float WaterWatcherOptions::get_temp0_raw()
 {
-    return temp0_raw;
+    return get_temp_raw(0);
+} // end
+
+float WaterWatcherOptions::get_temp_raw(size_t k)
+{
+    if (k >= MAX_TEMP_SENSORS) return NO_SAMPLE_VALUE;
+    return temp_raw[k];
 } // end
 
 
@@ -111,27 +124,43 @@ bool WaterWatcherOptions::is_sample_temp0()
 } // end
 
 
+// Apply the calibration of the channel to the raw values
+float WaterWatcherOptions::get_calibrated_out(size_t ch)
+{
+    const float raw[NUM_CAL_CHANNELS] = {get_a0_raw(), get_a1_raw(), get_a2_raw(), get_temp0_raw()};
+    return calibration_apply(ch, raw);
+} // end
+
+
 //-------------------------------------------------
 // TRANSFER FUNCTION OUTPUTS
 // OVERRIDE THESE FUNCTIONS
+// The defaults apply the calibrations stored in flash (set-transfer), which are the raw values if not set.
 //-------------------------------------------------
 float WaterWatcherOptions::get_a0_out()
 {
-    return get_a0_raw(); 
+    return get_calibrated_out(CAL_A0);
 } // end
 
 float WaterWatcherOptions::get_a1_out()
 {
-    return get_a1_raw(); 
+    return get_calibrated_out(CAL_A1);
 } // end
     
 float WaterWatcherOptions::get_a2_out()
 {
-    return get_a2_raw();
+    return get_calibrated_out(CAL_A2);
 } // end
 
 float WaterWatcherOptions::get_temp0_out()
 {
-    return get_temp0_raw();
+    return get_calibrated_out(CAL_TEMP0);
+} // end
+
+// Transfer function for the temperature probe tk
+float WaterWatcherOptions::get_temp_out(size_t k)
+{
+    if (k == 0) return get_temp0_out();
+    return get_temp_raw(k);
 } // end
 
@@ -18,8 +18,6 @@ static const char CR[] = "\r";
 const uint32_t MAX_CHARS_RESP_DEFAULT = 100;
 static const char NO_STR[] = "";
 static const char AT[] = "AT";
-const uint32_t ASSOC_RETRY = 60;
-const uint32_t ASSOC_WAIT_MS = 1000;
 static const char CRLF[] = "\r\n";
 static const char LF[] = "\n";
 static uint32_t TIMEOUT_CYCLES_RESP = 10;
@@ -52,7 +50,15 @@ bool XbeeCell::checkOK()
 
 bool XbeeCell::enterCommandMode()
 {
-    delay(1000);
+    delay(CELL_GUARD_TIME_MS);
+    return sendEscape();
+} // end
+
+
+// Send the escape sequence without waiting for the guard time.
+// The caller must ensure that no data has been sent for CELL_GUARD_TIME_MS.
+bool XbeeCell::sendEscape()
+{
     serial->sendString("+++"); 
     // NOTE that sometimes OK is returned before 1 s guard time is up, so just check for the OK
     return checkOK();
@@ -207,7 +213,13 @@ bool  XbeeCell::isModuleSetToSleep()
 {
     bool rv = enterCommandMode();
     if (!rv) return false;
+    return isSleepConfigured();
+} // end
+
 
+// ENTER COMMAND MODE BEFORE CALLING THIS FUNCTION
+bool XbeeCell::isSleepConfigured()
+{
     String resp = sendAT("D8");
     resp.trim();
     if(resp != "1") return false;
@@ -314,9 +326,29 @@ bool XbeeCell::setAccessPointNameAndServerConnect(String ap_name, String server,
     bool rv = enterCommandMode();
     if(!rv) return false;
 
+    rv = setNetwork(ap_name, server, port);
+    if(!rv) return false;
+
+    pd("Checking if connected..."); 
+    bool flag = false;
+    flag = checkIfConnectedPoll(); 
+
+    pd("Exiting command mode");
+    rv = exitCommandMode();
+    if(!rv) return false;
+
+    if(!flag) return false;    
+    return true; // module is connected
+} // end
+
+
+// ENTER COMMAND MODE BEFORE CALLING THIS FUNCTION
+// Set the network and apply the changes without waiting for the module to connect
+bool XbeeCell::setNetwork(String ap_name, String server, unsigned int port)
+{
     pd("Set the name of the AP");
     pd("APN:" + ap_name); 
-    rv = setAccessPointName(ap_name);
+    bool rv = setAccessPointName(ap_name);
     if(!rv) return false;
 
     pd("Set the server");
@@ -328,19 +360,21 @@ bool XbeeCell::setAccessPointNameAndServerConnect(String ap_name, String server,
     if(!rv) return false;
 
     pd("apply changes");
-    rv = applyChanges();
-    if(!rv) return false;
+    return applyChanges();
+} // end
 
-    pd("Checking if connected..."); 
-    bool flag = false;
-    flag = checkIfConnectedPoll(); 
 
-    pd("Exiting command mode");
-    rv = exitCommandMode();
-    if(!rv) return false;
+// ENTER COMMAND MODE BEFORE CALLING THIS FUNCTION
+bool XbeeCell::setCachedNetwork()
+{
+    if (!hasCachedNetworkInfo()) return false;
+    return setNetwork(ap_name_cached, server_cached, port_cached);
+} // end
 
-    if(!flag) return false;    
-    return true; // module is connected
+
+bool XbeeCell::hasCachedNetworkInfo()
+{
+    return ap_name_cached.length() != 0;
 } // end
 
 
@@ -382,18 +416,46 @@ void XbeeCell::removeNulls(String &s)
 
 
 // This cannot be read in command mode
-String XbeeCell::sendData(String data)
+String XbeeCell::sendData(const String &data)
 {
     serial->sendString(data);
-    serial->sendString(String(CR));
+    sendDataEnd();
+    return receiveDataResponse();
+} // end
+
+
+// Terminate the data that has been sent over the serial port (the text delimiter is CR)
+bool XbeeCell::sendDataEnd()
+{
+    return serial->sendChars(CR, sizeof(CR) - 1);
+} // end
+
+
+// Wait for the response of the server after sending the data
+String XbeeCell::receiveDataResponse()
+{
+    char resp[MAX_CHARS_RESP_DEFAULT + 1];
+    if (!receiveDataResponse(resp, sizeof(resp))) return String("ERROR"); // return something to indicate that the string could not be read
+    return String(resp);
+} // end
+
+
+/*
+Wait for the response of the server after sending the data, without using the heap (this is called for each record).
+The response is trimmed.  Returns false if there is no response.
+*/
+bool XbeeCell::receiveDataResponse(char *resp, size_t size)
+{
     for(uint32_t k = 0; k < TIMEOUT_CYCLES_RESP; k++)
     {
-        String resp = serial->receiveString(TIMEOUT_CYCLES_DEFAULT, MAX_CHARS_RESP_DEFAULT, CR);
-        removeNulls(resp);
-        resp.trim();
-        if (resp.length() != 0) return resp;
+        size_t n = serial->receiveChars(resp, size, TIMEOUT_CYCLES_DEFAULT, CR[0]);
+        while (n > 0 && isspace((unsigned char)resp[n - 1])) resp[--n] = '\0';
+        size_t a = 0;
+        while (a < n && isspace((unsigned char)resp[a])) a++;
+        memmove(resp, resp + a, n - a + 1);
+        if (n > a) return true;
     }
-    return String("ERROR"); // return something to indicate that the string could not be read
+    return false;
 } // end 
 
 
@@ -421,7 +483,7 @@ bool XbeeCell::checkIfConnectedPoll()
 
 bool XbeeCell::reconnectIfRequired()
  {
-     if (ap_name_cached.length() == 0) return false;
+     if (!hasCachedNetworkInfo()) return false;
      return reconnectIfRequired(ap_name_cached, server_cached, port_cached);
  } // end
 
@@ -2,10 +2,6 @@
 #include "XbeeCellSendSleep.h"
 #include "cell_responses.h"
 
-const uint32_t SLEEP_WAIT_POLLS = 30;
-const uint32_t SLEEP_WAIT_POLL_TIME_MS = 1000;  // ms
-const uint32_t DELAY_EXIT_COMMAND_MODE = 1000;  // ms
-
 
 void XbeeCellSendSleep::pd(String s)
 {
@@ -50,22 +46,12 @@ void XbeeCellSendSleep::printSleepState()
 
 bool XbeeCellSendSleep::enterExitSleep(bool state)
 {
-    if(isModuleOn() && (state==EXIT_CELL_SLEEP)) return true; 
-    if(isModuleSleeping() && (state==ENTER_CELL_SLEEP)) return true;
-
-    if((state==ENTER_CELL_SLEEP))            
-    {
-        if(cell->isModuleSetToSleep()) digitalWrite(sleeprq_out_pin, HIGH);
-        else return false; // operation did not work since cell module cannot sleep
-    }
-    else if((state==EXIT_CELL_SLEEP))    
-    {
-        digitalWrite(sleeprq_out_pin, LOW);
-    }
+    if(isInSleepState(state)) return true;
+    if((state==ENTER_CELL_SLEEP) && !cell->isModuleSetToSleep()) return false; // operation did not work since cell module cannot sleep
+    requestSleepState(state);
     for(uint32_t k = 0; k < SLEEP_WAIT_POLLS; k++)
     {
-        if(state==ENTER_CELL_SLEEP) if(isModuleSleeping()) return true;
-        if(state==EXIT_CELL_SLEEP) if(isModuleOn()) return true;
+        if(isInSleepState(state)) return true;
         delay(SLEEP_WAIT_POLL_TIME_MS);
     }
     // if we get here, the exit from sleep state has not been successful and there is a timeout
@@ -73,8 +59,25 @@ bool XbeeCellSendSleep::enterExitSleep(bool state)
 } // end
 
 
+// Returns true if the module is in the sleep state
+bool XbeeCellSendSleep::isInSleepState(bool state)
+{
+    if(state==ENTER_CELL_SLEEP) return isModuleSleeping();
+    return isModuleOn();
+} // end
+
+
+// Request the sleep state without waiting for the module.
+// Before requesting ENTER_CELL_SLEEP, check that the module is set to sleep.
+void XbeeCellSendSleep::requestSleepState(bool state)
+{
+    if(state==ENTER_CELL_SLEEP) digitalWrite(sleeprq_out_pin, HIGH);
+    else digitalWrite(sleeprq_out_pin, LOW);
+} // end
+
+
 // Call this function to wake up the module, send data and then sleep
-bool XbeeCellSendSleep::wakeSendDataSleep(String data)
+bool XbeeCellSendSleep::wakeSendDataSleep(const String &data)
 {
     bool rv = false;
     String resp;
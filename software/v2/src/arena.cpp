@@ -0,0 +1,136 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+#include "constants.h"
+#include "main_local.h"
+
+/*
+RAM budget of the firmware.
+
+1. Arena: one static block that is split into a region for each subsystem.  The size of each region is set
+   at compile time (ARENA_*_SIZ in constants.h), so the arena shows up as one entry in the RAM budget
+   printed at the end of the build (scripts/ram_budget.py).  A subsystem allocates from its own region
+   with arena_alloc().  A buffer that is only needed for a while is released to a mark with arena_release().
+   There is no free() of a single buffer, so a region cannot fragment.
+2. Stack: the RAM between the top of the heap and the stack is filled with a pattern at startup.
+   The bytes of the pattern that are left show how close the stack has come to the heap.
+
+CLI: mem
+*/
+
+static const uint8_t STACK_PAINT = 0xA5;
+static const size_t STACK_PAINT_MARGIN = 64;        // bytes below the stack pointer that are not painted
+static const size_t ARENA_ALIGN = 4;
+
+static const size_t ARENA_REGION_SIZ[NUM_ARENA_REGIONS] = {ARENA_SD_SIZ, ARENA_CLI_SIZ};
+static const char *const ARENA_REGION_NAMES[NUM_ARENA_REGIONS] = {"sd", "cli"};
+static const size_t ARENA_SIZ = ARENA_SD_SIZ + ARENA_CLI_SIZ;
+
+alignas(ARENA_ALIGN) static uint8_t arena[ARENA_SIZ];
+
+static struct arena_data
+{
+    size_t used[NUM_ARENA_REGIONS];         // bytes allocated from each region
+    size_t high[NUM_ARENA_REGIONS];         // most bytes allocated from each region since startup
+    uint16_t failed[NUM_ARENA_REGIONS];     // allocations that did not fit into each region
+} ad;
+
+// symbols of the linker script
+extern "C" char __data_start__;
+extern "C" char __bss_end__;
+extern "C" char __StackTop;
+extern "C" char *sbrk(int incr);
+
+
+// Start of the region in the arena
+static uint8_t *region_start(arena_region r)
+{
+    size_t offset = 0;
+    for(size_t k = 0; k < (size_t)r; k++) offset += ARENA_REGION_SIZ[k];
+    return arena + offset;
+} // end
+
+
+/*
+Fill the unused RAM below the stack with the pattern.
+Call this function first in the setup.
+*/
+void setup_arena()
+{
+    memset(&ad, 0, sizeof(ad));
+    uint8_t here;
+    uint8_t *p = reinterpret_cast<uint8_t *>(sbrk(0));
+    uint8_t *top = &here - STACK_PAINT_MARGIN;
+    if (p < top) memset(p, STACK_PAINT, top - p);
+} // end
+
+
+/*
+Allocate size bytes from the region.
+Returns NULL if the region is full.
+*/
+void *arena_alloc(arena_region r, size_t size)
+{
+    if (r >= NUM_ARENA_REGIONS) return NULL;
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (size > ARENA_REGION_SIZ[r] - ad.used[r])
+    {
+        ad.failed[r]++;
+        return NULL;
+    }
+    void *p = region_start(r) + ad.used[r];
+    ad.used[r] += size;
+    if (ad.used[r] > ad.high[r]) ad.high[r] = ad.used[r];
+    return p;
+} // end
+
+
+/*
+Returns the mark to release the allocations of the region that are made after this call
+*/
+size_t arena_mark(arena_region r)
+{
+    if (r >= NUM_ARENA_REGIONS) return 0;
+    return ad.used[r];
+} // end
+
+
+void arena_release(arena_region r, size_t mark)
+{
+    if (r >= NUM_ARENA_REGIONS || mark > ad.used[r]) return;
+    ad.used[r] = mark;
+} // end
+
+
+// Bytes of the pattern left between the top of the heap and the deepest point of the stack
+static size_t stack_unused()
+{
+    uint8_t here;
+    uint8_t *p = reinterpret_cast<uint8_t *>(sbrk(0));
+    size_t n = 0;
+    while (p + n < &here && p[n] == STACK_PAINT) n++;
+    return n;
+} // end
+
+
+/*
+Print the static RAM, the heap, the stack and the use of each region of the arena
+CLI: mem
+*/
+void print_memory()
+{
+    uint8_t here;
+    char *heap_top = sbrk(0);
+    printSerial("MEMORY:");
+    printSerial("static: " + String(&__bss_end__ - &__data_start__));
+    printSerial("heap: " + String(heap_top - &__bss_end__));
+    printSerial("stack: " + String(&__StackTop - reinterpret_cast<char *>(&here)));
+    printSerial("stack_min_free: " + String(stack_unused()));
+    printSerial("REGION/USED/HIGH/SIZE/FAILED");
+    for(size_t k = 0; k < NUM_ARENA_REGIONS; k++)
+    {
+        printSerial(String(ARENA_REGION_NAMES[k]) + "/" + String(ad.used[k]) + "/" + String(ad.high[k]) + "/" +
+                    String(ARENA_REGION_SIZ[k]) + "/" + String(ad.failed[k]));
+    }
+} // end
@@ -0,0 +1,228 @@
+#include <Arduino.h>
+#include "calibration.h"
+#include "constants.h"
+#include "flash_mem.h"
+#include "main_local.h"
+#include "fixed_format.h"
+#include "WaterWatcherOptions.h"
+#include "transfer_expr.h"
+
+/*
+Calibrations of the transfer function outputs that are stored in flash, so that a sensor can be
+recalibrated over the CLI without building the firmware again.
+
+Each channel {a0, a1, a2, temp0} has one of:
+1. CAL_POLY: a polynomial in the raw value x.
+2. CAL_POLY2: a polynomial in x and the raw temp0 t (such as the TDS model fitted with polyfit2d).
+   The coefficient of x^i*t^j is c[i*nt + j].
+3. CAL_PWL: a piecewise-linear table of points in increasing x.  The end segments are extended
+   for x outside of the table.
+4. CAL_EXPR: an expression of the raw values and named constants (see transfer_expr.cpp).
+
+The polynomials are evaluated in single precision with Horner's rule (one multiply and one add per coefficient).
+A missing sample (NO_SAMPLE_VALUE) is not calibrated.
+
+CLI:
+setup-transfer [a0|a1|a2|temp0] [none|poly|poly2|pwl] [n] [nt]     (the coefficients are set to 0)
+setup-transfer [a0|a1|a2|temp0] expr [expression]
+set-transfer [a0|a1|a2|temp0] [index] [c] [c]...                   (set the coefficients from the index)
+The calibrations are stored with write-flash.
+*/
+
+const char *const CAL_CHANNEL_NAMES[NUM_CAL_CHANNELS] = {"a0", "a1", "a2", "temp0"};
+static const char *const CAL_TYPE_NAMES[] = {"none", "poly", "poly2", "pwl", "expr"};
+
+
+void calibration_clear(struct calibration &c)
+{
+    memset(&c, 0, sizeof(c));
+    c.type = CAL_NONE;
+} // end
+
+
+/*
+Returns the number of coefficients used by the calibration
+*/
+size_t calibration_num_coeff(const struct calibration &c)
+{
+    switch(c.type)
+    {
+        case CAL_POLY:  return c.n;
+        case CAL_POLY2: return c.n * c.nt;
+        case CAL_PWL:   return 2 * c.n;
+        default:        return 0;
+    }
+} // end
+
+
+/*
+Returns true if the type and size of the calibration are valid (false for flash written before the calibrations)
+*/
+bool calibration_valid(const struct calibration &c)
+{
+    switch(c.type)
+    {
+        case CAL_NONE:  return true;
+        case CAL_POLY:  return c.n >= 1 && c.n <= CAL_MAX_COEFF;
+        case CAL_POLY2: return c.n >= 1 && c.nt >= 1 && (size_t)c.n * c.nt <= CAL_MAX_COEFF;
+        case CAL_PWL:   return c.n >= 2 && 2 * (size_t)c.n <= CAL_MAX_COEFF;
+        case CAL_EXPR:  return c.n <= sizeof(c.code) && expr_valid(c.code, c.n);
+        default:        return false;
+    }
+} // end
+
+
+// c[0] + x*(c[1] + x*(c[2] + ...))
+static inline float horner(const float *c, size_t n, float x)
+{
+    float y = 0.0f;
+    for(size_t k = n; k-- > 0; ) y = y * x + c[k];
+    return y;
+} // end
+
+
+static float eval_pwl(const float *c, size_t n, float x)
+{
+    size_t k = 0;
+    while (k + 2 < n && x >= c[2 * (k + 1)]) k++;      // segment from point k to k + 1
+    float x0 = c[2 * k], y0 = c[2 * k + 1];
+    float x1 = c[2 * k + 2], y1 = c[2 * k + 3];
+    if (x1 == x0) return y0;
+    return y0 + (x - x0) * (y1 - y0) / (x1 - x0);
+} // end
+
+
+/*
+Evaluate the calibration of the channel with the raw values {a0, a1, a2, temp0}
+*/
+float calibration_eval(const struct calibration &c, size_t ch, const float *raw)
+{
+    float x = raw[ch];
+    float t = raw[CAL_TEMP0];
+    float y;
+    switch(c.type)
+    {
+        case CAL_POLY:
+            return horner(c.c, c.n, x);
+        case CAL_POLY2:
+            if (t == NO_SAMPLE_VALUE) return NO_SAMPLE_VALUE;
+            y = 0.0f;
+            for(size_t i = c.n; i-- > 0; ) y = y * x + horner(c.c + i * c.nt, c.nt, t);
+            return y;
+        case CAL_PWL:
+            return eval_pwl(c.c, c.n, x);
+        case CAL_EXPR:
+            return expr_eval(c.code, c.n, raw, get_constant_values());
+        default:
+            return x;
+    }
+} // end
+
+
+/*
+Apply the calibration of the channel to the raw values {a0, a1, a2, temp0}
+Returns the raw value if the channel is not calibrated or the raw value is a missing sample.
+*/
+float calibration_apply(size_t ch, const float *raw)
+{
+    if (ch >= NUM_CAL_CHANNELS) return NO_SAMPLE_VALUE;
+    if (raw[ch] == NO_SAMPLE_VALUE) return raw[ch];
+    return calibration_eval(get_calibration(ch), ch, raw);
+} // end
+
+
+int get_calibration_channel(String name)
+{
+    for(size_t k = 0; k < NUM_CAL_CHANNELS; k++)
+    {
+        if (name == CAL_CHANNEL_NAMES[k]) return k;
+    }
+    return -1;
+} // end
+
+
+/*
+Set the type and size of the calibration of the channel.  The coefficients are set to 0.
+n is the number of coefficients (poly), powers of x (poly2) or points (pwl) and nt is the number of powers of t (poly2).
+Returns false if the type or size is not valid.
+*/
+bool setup_calibration(size_t ch, String type, int n, int nt)
+{
+    if (ch >= NUM_CAL_CHANNELS || n < 0 || n > 255 || nt < 0 || nt > 255) return false;
+    struct calibration c;
+    calibration_clear(c);
+    for(size_t k = 0; k < sizeof(CAL_TYPE_NAMES) / sizeof(CAL_TYPE_NAMES[0]); k++)
+    {
+        if (type == CAL_TYPE_NAMES[k]) c.type = k;
+    }
+    if (c.type == CAL_NONE && type != CAL_TYPE_NAMES[CAL_NONE]) return false;
+    if (c.type != CAL_NONE) c.n = n;
+    if (c.type == CAL_POLY2) c.nt = nt;
+    if (!calibration_valid(c)) return false;
+    set_calibration(ch, c);
+    return true;
+} // end
+
+
+/*
+Compile the expression to the calibration of the channel
+Returns NULL if the expression is compiled or the error.
+*/
+const char *setup_calibration_expr(size_t ch, const char *src)
+{
+    if (ch >= NUM_CAL_CHANNELS) return "unknown channel";
+    struct calibration c;
+    calibration_clear(c);
+    size_t len;
+    const char *error = expr_compile(src, c.code, sizeof(c.code), len);
+    if (error) return error;
+    c.type = CAL_EXPR;
+    c.n = len;
+    set_calibration(ch, c);
+    return NULL;
+} // end
+
+
+/*
+Set coefficient k of the calibration of the channel
+Returns false if the calibration does not use coefficient k.
+*/
+bool set_calibration_coeff(size_t ch, size_t k, float v)
+{
+    if (ch >= NUM_CAL_CHANNELS) return false;
+    struct calibration c = get_calibration(ch);
+    if (k >= calibration_num_coeff(c)) return false;
+    c.c[k] = v;
+    set_calibration(ch, c);
+    return true;
+} // end
+
+
+/*
+CLI: print-transfer
+*/
+void print_calibration()
+{
+    char num[FIXED_FORMAT_SIZ];
+    printSerial("CHANNEL: TYPE [N] [NT] COEFFICIENTS");
+    for(size_t ch = 0; ch < NUM_CAL_CHANNELS; ch++)
+    {
+        const struct calibration &c = get_calibration(ch);
+        String line = String(CAL_CHANNEL_NAMES[ch]) + ": " + String(CAL_TYPE_NAMES[c.type]);
+        if (c.type == CAL_EXPR)
+        {
+            printSerial(line + " " + expr_to_string(c.code, c.n));
+            continue;
+        }
+        if (c.type != CAL_NONE) line += " " + String(c.n);
+        if (c.type == CAL_POLY2) line += " " + String(c.nt);
+        for(size_t k = 0; k < calibration_num_coeff(c); k++)
+        {
+            format_general(c.c[k], num);      // the coefficients are read back from the text
+            line += " ";
+            line += num;
+        }
+        printSerial(line);
+    }
+    print_transfer_constants();
+} // end
@@ -7,42 +7,236 @@
 #include "SimpleBBSerial.h"
 #include "XbeeCell.h"
 #include "XbeeCellSendSleep.h"
+#include "SimpleTaskScheduler.h"
+#include "cell_responses.h"
+#include "power_profile.h"
 
 // Objects to send cellular data
 SimpleBBSerial bbs(PIN_RX_MODEM, PIN_TX_MODEM, BAUD_MODEM, PIN_CTS_MODEM, -1, TIMEOUT_CTS);
 XbeeCell cell(&bbs);
 XbeeCellSendSleep pcell(&cell, SLEEP_RQ_MODEM, SLEEP_PIN_MODEM);
 
+/*
+The modem is woken, attached to the network, sent the data and put back to sleep by a task that is called
+from the scheduler.  Each stage returns instead of waiting, so that the main loop keeps running while the modem
+wakes (up to SLEEP_WAIT_POLLS s) and associates with the network (up to ASSOC_RETRY s).
+The stages are the same as XbeeCellSendSleep::wakeSendDataSleep(), which is still used from the CLI.
+Each record is streamed to the modem by the record source, so the record is not copied into a String.
+*/
+enum cell_stage
+{
+    CELL_IDLE,              // task is not running
+    CELL_WAKE,              // waiting for the module to wake
+    CELL_ESCAPE,            // entering command mode
+    CELL_ASSOC,             // polling for association with the network
+    CELL_EXIT_CMD,          // exiting command mode
+    CELL_READY,             // attached to the network and waiting for the data
+    CELL_SEND,              // sending the data
+    CELL_SLEEP_ESCAPE,      // entering command mode to check that the module can sleep
+    CELL_SLEEP_WAIT         // waiting for the module to sleep
+}; // end
+
+static struct cellular_data
+{
+    cell_stage stage;       // current stage of the task
+    uint32_t polls;         // number of polls in the current stage
+    uint8_t attempt;        // number of attempts to send the data
+    bool configured;        // true if the network has been set up again in this attempt
+    bool has_data;          // true if the records are ready to be sent
+    bool sent;              // true if all of the records were received by the server
+    bool abort;             // true if there is no data to send and the module should go back to sleep
+    cell_record_next next;  // obtains the next record to send
+    cell_record_sent ack;   // called when the record has been received by the server
+} cd;
+
 
 /*
 Call this function to setup the cellular
 */ 
 void setup_cellular()
 {
+    cd.stage = CELL_IDLE;
+} // end
+
 
+// Wake the module at the start of each attempt
+static unsigned long cell_begin_attempt()
+{
+    pcell.requestSleepState(EXIT_CELL_SLEEP);
+    cd.polls = 0;
+    cd.stage = CELL_WAKE;
+    return TASK_NOW;
 } // end
 
 
-/*
-Call this function to send the data to the server via cellular
-*/
-void send_to_server_over_cellular(String s)
+// End the attempt and put the module back to sleep
+static unsigned long cell_fail()
+{
+    printSerial(ERROR_STRING);
+    cd.stage = CELL_SLEEP_ESCAPE;
+    return DELAY_EXIT_COMMAND_MODE + CELL_GUARD_TIME_MS;
+} // end
+
+
+// Called when the module is asleep (or cannot sleep)
+static unsigned long cell_finish()
 {
-    printSerial("---DATA TO BE SENT TO CELLULAR MODEM---");
-    printSerial(s);
-    printSerial("-----------");
-    for(uint8_t k = 0; k < CELLULAR_RETRIES; k++)
+    if (!cd.sent && !cd.abort && ++cd.attempt < CELLULAR_RETRIES) return cell_begin_attempt();
+    cd.stage = CELL_IDLE;
+    return TASK_DONE;
+} // end
+
+
+// Stream the next record to the modem and wait for the response of the server
+static unsigned long cell_send()
+{
+    RecordUartSink uart(&bbs);
+    RecordCrcSink crc;
+    RecordTeeSink out(uart, crc);
+    power_profile_mark(PP_SEND);
+    if (!cd.next(out))
+    {
+        // a record that could not be read completely is sent again with the next attempt
+        if (out.length() != 0) return cell_fail();
+        // all of the records have been sent
+        cd.sent = true;
+        cd.stage = CELL_SLEEP_ESCAPE;
+        return CELL_GUARD_TIME_MS;
+    }
+    if (!out.good() || !cell.sendDataEnd()) return cell_fail();
+    crc.print();
+    char resp[sizeof(CELL_RECEIVED_STR) + 8];
+    if (!cell.receiveDataResponse(resp, sizeof(resp)) || strcmp(resp, CELL_RECEIVED_STR) != 0) return cell_fail();
+    printSerial(SUCCESS_STRING);
+    cd.ack();
+    return DELAY_EXIT_COMMAND_MODE;     // wait to ensure that the data has been sent
+} // end
+
+
+// Task that runs the modem stages
+static unsigned long cell_task()
+{
+    switch(cd.stage)
     {
-       bool rv = pcell.wakeSendDataSleep(s); 
-       if(rv==true)
-       {
-            printSerial(SUCCESS_STRING);
+        case CELL_WAKE:
+            // continue on a timeout, since the escape sequence will then fail
+            if (pcell.isModuleOn() || ++cd.polls >= SLEEP_WAIT_POLLS)
+            {
+                cd.stage = CELL_ESCAPE;
+                return CELL_GUARD_TIME_MS;
+            }
+            return SLEEP_WAIT_POLL_TIME_MS;
+
+        case CELL_ESCAPE:
+            if (!cell.sendEscape()) return cell_fail();
+            cd.polls = 0;
+            cd.configured = false;
+            cd.stage = CELL_ASSOC;
+            return TASK_NOW;
+
+        case CELL_ASSOC:
+            if (cell.checkIfConnected())
+            {
+                cd.stage = CELL_EXIT_CMD;
+                return TASK_NOW;
+            }
+            if (++cd.polls < ASSOC_RETRY) return ASSOC_WAIT_MS;
+            if (cd.configured)
+            {
+                cell.exitCommandMode();
+                return cell_fail();
+            }
+            // the module is not connected, so set up the network again and poll again
+            if (!cell.setCachedNetwork()) return cell_fail();
+            cd.configured = true;
+            cd.polls = 0;
+            return TASK_NOW;
+
+        case CELL_EXIT_CMD:
+            if (!cell.exitCommandMode()) return cell_fail();
+            cd.stage = CELL_READY;
+            return DELAY_EXIT_COMMAND_MODE;     // wait after exiting command mode to ensure that modem can send data
+
+        case CELL_READY:
+            if (cd.abort)
+            {
+                cd.stage = CELL_SLEEP_ESCAPE;
+                return TASK_NOW;        // the guard time has passed since exiting command mode
+            }
+            if (!cd.has_data) return CELL_TASK_POLL;
+            cd.stage = CELL_SEND;
+            return TASK_NOW;
+
+        case CELL_SEND:
+            return cell_send();
+
+        case CELL_SLEEP_ESCAPE:
+            if (!cell.sendEscape() || !cell.isSleepConfigured()) return cell_finish();
+            pcell.requestSleepState(ENTER_CELL_SLEEP);
+            cd.polls = 0;
+            cd.stage = CELL_SLEEP_WAIT;
+            return TASK_NOW;
+
+        case CELL_SLEEP_WAIT:
+            if (pcell.isModuleSleeping() || ++cd.polls >= SLEEP_WAIT_POLLS) return cell_finish();
+            return SLEEP_WAIT_POLL_TIME_MS;
+
+        default:
             break;
-       }
-       else
-       {
-           printSerial(ERROR_STRING);
-       } 
     }
-} // end 
+    cd.stage = CELL_IDLE;
+    return TASK_DONE;
+} // end
+
+
+/*
+Start the task that wakes the modem and attaches to the network.
+The modem waits for the data from cell_task_send_records() before sending and going back to sleep.
+This is called at the start of the sample so that the modem attaches while the sensors are sampled.
+*/
+void cell_task_start()
+{
+    if (cell_task_busy()) return;
+    cd.attempt = 0;
+    cd.has_data = false;
+    cd.sent = false;
+    cd.abort = false;
+    cell_begin_attempt();
+    if (scheduler.add(cell_task, TASK_NOW) == NO_TASK) cd.stage = CELL_IDLE;
+} // end
+
+
+/*
+Send a number of records in the same session using the modem task.
+next() is called to obtain each record until it returns false, and sent() is called after each record is
+received by the server.  If a record is not received, the module goes back to sleep and the next attempt
+continues from the record that was not received.
+The task is started if it is not already running.
+*/
+void cell_task_send_records(cell_record_next next, cell_record_sent sent)
+{
+    cell_task_start();
+    cd.next = next;
+    cd.ack = sent;
+    cd.has_data = true;
+    cd.abort = false;
+} // end
+
+
+/*
+Put the modem back to sleep without sending if the data has not been given to the task
+*/
+void cell_task_abort()
+{
+    if (!cell_task_busy() || cd.has_data) return;
+    cd.abort = true;
+} // end
 
+
+/*
+Returns true if the modem task is running
+*/
+bool cell_task_busy()
+{
+    return cd.stage != CELL_IDLE;
+} // end
@@ -12,6 +12,16 @@
 #include "cellular.h"
 #include "experiment.h"
 #include "temperature1w.h"
+#include "power_profile.h"
+#include "power_policy.h"
+#include "event_detect.h"
+#include "rtc_discipline.h"
+#include "fixed_format.h"
+#include "calibration.h"
+#include "transfer_expr.h"
+#include "safe_string.h"
+#include "arena.h"
+#include "WaterWatcherOptions.h"
 #include "XbeeCellSendSleep.h"
 #include "XbeeCell.h"
 
@@ -378,6 +388,342 @@ void send_cell_off(int arg_cnt, char **args)
 } // end
 
 
+/*
+Turn on the power profile of each sample
+*/
+void power_profile_on_cmd(int arg_cnt, char **args)
+{
+    set_power_profile_on(true);
+} // end
+
+
+/*
+Turn off the power profile of each sample
+*/
+void power_profile_off_cmd(int arg_cnt, char **args)
+{
+    set_power_profile_on(false);
+} // end
+
+
+/*
+Print the charge of each phase of the last sample cycle
+*/
+void print_power_profile_cmd(int arg_cnt, char **args)
+{
+    print_power_profile();
+} // end
+
+
+/*
+Turn on the battery-aware sampling and transmission policy
+*/
+void policy_on_cmd(int arg_cnt, char **args)
+{
+    set_policy_on(true);
+} // end
+
+
+/*
+Turn off the battery-aware sampling and transmission policy
+*/
+void policy_off_cmd(int arg_cnt, char **args)
+{
+    set_policy_on(false);
+} // end
+
+
+/*
+Print the tier of the policy
+*/
+void print_policy_cmd(int arg_cnt, char **args)
+{
+    print_power_policy();
+} // end
+
+
+/*
+Turn on the event-triggered fast sampling
+*/
+void event_on_cmd(int arg_cnt, char **args)
+{
+    set_event_on(true);
+} // end
+
+
+/*
+Turn off the event-triggered fast sampling
+*/
+void event_off_cmd(int arg_cnt, char **args)
+{
+    set_event_on(false);
+} // end
+
+
+/*
+Set the limits of the checks of a channel (a limit of 0 turns off the check):
+set-event [a0|a1|temp0] [hi] [rate per minute] [CUSUM k] [CUSUM h]
+*/
+void set_event_cmd(int arg_cnt, char **args)
+{
+    if (arg_cnt != 6)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    String name = String(args[1]);
+    name.trim();
+    int ch = get_event_channel(name);
+    if (ch < 0)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    set_event_limits(ch, String(args[2]).toFloat(), String(args[3]).toFloat(), String(args[4]).toFloat(), String(args[5]).toFloat());
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Set the sampling interval during an event and the number of samples without a trip before the event ends:
+set-event-fast [minutes] [samples]
+*/
+void set_event_fast_cmd(int arg_cnt, char **args)
+{
+    if (arg_cnt != 3)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    set_event_fast(String(args[1]).toInt(), String(args[2]).toInt());
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Print the limits and state of the event detection
+*/
+void print_event_cmd(int arg_cnt, char **args)
+{
+    print_event_detect();
+} // end
+
+
+/*
+Store the records on the SD card as JSON (the records can be read back to be sent in a batch)
+*/
+void set_sd_json_cmd(int arg_cnt, char **args)
+{
+    set_sd_json(true);
+} // end
+
+
+/*
+Store the records on the SD card as CSV with the names of the columns in the first line
+*/
+void set_sd_csv_cmd(int arg_cnt, char **args)
+{
+    set_sd_json(false);
+} // end
+
+
+/*
+Returns the calibration channel named by the argument or -1
+*/
+static int calibration_channel_arg(char *arg)
+{
+    String name = String(arg);
+    name.trim();
+    return get_calibration_channel(name);
+} // end
+
+
+/*
+Set the type and size of the calibration of a channel (the coefficients are set to 0):
+setup-transfer [a0|a1|a2|temp0] none
+setup-transfer [a0|a1|a2|temp0] poly [coefficients]
+setup-transfer [a0|a1|a2|temp0] poly2 [powers of x] [powers of temp0]
+setup-transfer [a0|a1|a2|temp0] pwl [points]
+setup-transfer [a0|a1|a2|temp0] expr [expression]
+*/
+void setup_transfer_cmd(int arg_cnt, char **args)
+{
+    if (arg_cnt < 3)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    int ch = calibration_channel_arg(args[1]);
+    if (ch >= 0 && String(args[2]) == "expr")
+    {
+        // the expression is split into arguments at the spaces
+        size_t mark = arena_mark(ARENA_CLI);
+        char *src = static_cast<char *>(arena_alloc(ARENA_CLI, MAX_STRING_SIZE_TRANSFER_FUNC));
+        if (!src)
+        {
+            printSerial(ERROR_STRING);
+            return;
+        }
+        src[0] = '\0';
+        for(int i = 3; i < arg_cnt; i++)
+        {
+            strlcat(src, args[i], MAX_STRING_SIZE_TRANSFER_FUNC);
+            strlcat(src, " ", MAX_STRING_SIZE_TRANSFER_FUNC);
+        }
+        const char *error = setup_calibration_expr(ch, src);
+        arena_release(ARENA_CLI, mark);
+        printSerial(error ? error : SUCCESS_STRING);
+        return;
+    }
+    int n = arg_cnt > 3 ? String(args[3]).toInt() : 0;
+    int nt = arg_cnt > 4 ? String(args[4]).toInt() : 0;
+    if (ch < 0 || !setup_calibration(ch, String(args[2]), n, nt))
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Set the coefficients of the calibration of a channel from the index (x0 y0 x1 y1... for pwl):
+set-transfer [a0|a1|a2|temp0] [index] [c] [c]...
+*/
+void set_transfer_cmd(int arg_cnt, char **args)
+{
+    if (arg_cnt < 4)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    int ch = calibration_channel_arg(args[1]);
+    int k = String(args[2]).toInt();
+    if (ch < 0 || k < 0)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    for(int i = 3; i < arg_cnt; i++)
+    {
+        if (!set_calibration_coeff(ch, k + i - 3, String(args[i]).toFloat()))
+        {
+            printSerial(ERROR_STRING);
+            return;
+        }
+    }
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Remove the calibration of a channel (the output is the raw value):
+clear-transfer [a0|a1|a2|temp0]
+*/
+void clear_transfer_cmd(int arg_cnt, char **args)
+{
+    int ch = arg_cnt > 1 ? calibration_channel_arg(args[1]) : -1;
+    if (ch < 0)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    setup_calibration(ch, "none", 0, 0);
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Remove the calibrations of all channels
+*/
+void clear_transfer_all_cmd(int arg_cnt, char **args)
+{
+    for(size_t ch = 0; ch < NUM_CAL_CHANNELS; ch++) setup_calibration(ch, "none", 0, 0);
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Print the calibrations
+*/
+void print_transfer_cmd(int arg_cnt, char **args)
+{
+    print_calibration();
+} // end
+
+
+/*
+Evaluate the calibration of a channel at a raw value (and raw temp0).
+The other raw values are those of the last sample.
+rt-transfer [a0|a1|a2|temp0] [x] [t]
+*/
+void rt_transfer_cmd(int arg_cnt, char **args)
+{
+    int ch = arg_cnt > 2 ? calibration_channel_arg(args[1]) : -1;
+    if (ch < 0)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    WaterWatcherOptions *opt = get_options();
+    float raw[NUM_CAL_CHANNELS] = {opt->get_a0_raw(), opt->get_a1_raw(), opt->get_a2_raw(), opt->get_temp0_raw()};
+    raw[ch] = String(args[2]).toFloat();
+    if (arg_cnt > 3) raw[CAL_TEMP0] = String(args[3]).toFloat();
+    char num[FIXED_FORMAT_SIZ];
+    format_fixed(calibration_apply(ch, raw), FIXED_FORMAT_MAX_PRECISION, num);
+    printSerialWithoutLineEnding("out: ");
+    printSerial(num);
+} // end
+
+
+/*
+Set a named constant of the transfer expressions (the constant is added if required):
+set-constant [name] [value]
+*/
+void set_constant_cmd(int arg_cnt, char **args)
+{
+    if (arg_cnt != 3 || !set_transfer_constant(String(args[1]), String(args[2]).toFloat()))
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Remove a named constant that is not used by a transfer expression:
+del-constant [name]
+*/
+void del_constant_cmd(int arg_cnt, char **args)
+{
+    if (arg_cnt != 2 || !del_transfer_constant(String(args[1])))
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    printSerial(SUCCESS_STRING);
+} // end
+
+
+/*
+Print the use of the RAM: static, heap, stack and the regions of the arena
+*/
+void mem_cmd(int arg_cnt, char **args)
+{
+    print_memory();
+} // end
+
+
+/*
+Print the aging offset and the last offset and drift of the RTC from the GPS time
+*/
+void print_rtc_discipline_cmd(int arg_cnt, char **args)
+{
+    print_rtc_discipline();
+} // end
+
+
 /*
 Function to start the experiment
 */
@@ -407,6 +753,24 @@ void set_sensor_num(int arg_cnt, char **args)
 } // end
 
 
+/*
+Obtain a new GPS position every n samples (n = 1 for every sample).
+Use write-flash to save.
+CLI: set-gps-refix [n]
+*/
+void set_gps_refix_cmd(int arg_cnt, char **args)
+{
+    if(arg_cnt != 2)
+    {
+        printSerial(ERROR_STRING);
+        return;
+    }
+    String number = args[1];
+    set_gps_refix(number.toInt());
+    printSerial("Set GPS refix:" + String(get_gps_refix()));
+} // end
+
+
 //-------------------------------------------------------------------
 // Extended CLI
 //-------------------------------------------------------------------
@@ -432,6 +796,19 @@ void scan_temperature(int arg_cnt, char **args)
     get_water_temperature(water_temperature, temp_good); 
     if(temp_good == false) printSerial(ERROR_STRING); 
     printSerial(String(water_temperature));
+    printSerial(temperature_bus_info());    // all of the probes on the bus
+} // end
+
+
+/*
+Remove the bindings of the temperature probes to the names {t0, t1,...}
+so that the probes are named in the order of the next bus search.
+Use write-flash to save.
+*/
+void clear_temperature(int arg_cnt, char **args)
+{
+    clear_temperature_bindings();
+    printSerial(DONE_STRING);
 } // end
 
 
@@ -642,6 +1019,31 @@ void setup_commands()
     cmd.cmdAdd(SEND_CELL_OFF, send_cell_off);
     cmd.cmdAdd(SAMPLE, sample_command);
     cmd.cmdAdd(SCAN_TEMPERATURE, scan_temperature);     // scan the 1w temperature bus and find values
+    cmd.cmdAdd(SET_GPS_REFIX, set_gps_refix_cmd);       // samples between GPS position fixes
+    cmd.cmdAdd(CLEAR_TEMPERATURE, clear_temperature);   // unbind the 1w temperature probes from the names
+    cmd.cmdAdd(POWER_PROFILE_ON, power_profile_on_cmd);             // profile the charge of each phase of the sample
+    cmd.cmdAdd(POWER_PROFILE_OFF, power_profile_off_cmd);
+    cmd.cmdAdd(PRINT_POWER_PROFILE, print_power_profile_cmd);
+    cmd.cmdAdd(POLICY_ON, policy_on_cmd);                           // scale the interval and uplink batch with the battery
+    cmd.cmdAdd(POLICY_OFF, policy_off_cmd);
+    cmd.cmdAdd(PRINT_POLICY, print_policy_cmd);
+    cmd.cmdAdd(EVENT_ON, event_on_cmd);                             // sample faster when the readings change sharply
+    cmd.cmdAdd(EVENT_OFF, event_off_cmd);
+    cmd.cmdAdd(SET_EVENT, set_event_cmd);
+    cmd.cmdAdd(SET_EVENT_FAST, set_event_fast_cmd);
+    cmd.cmdAdd(PRINT_EVENT, print_event_cmd);
+    cmd.cmdAdd(PRINT_RTC_DISCIPLINE, print_rtc_discipline_cmd);    // RTC offset from the GPS time and aging offset
+    cmd.cmdAdd(SET_SD_JSON, set_sd_json_cmd);                       // format of the records on the SD card
+    cmd.cmdAdd(SET_SD_CSV, set_sd_csv_cmd);
+    cmd.cmdAdd(SETUP_TRANSFER, setup_transfer_cmd);                 // calibrations of the outputs stored in flash
+    cmd.cmdAdd(SET_TRANSFER, set_transfer_cmd);
+    cmd.cmdAdd(CLEAR_TRANSFER, clear_transfer_cmd);
+    cmd.cmdAdd(CLEAR_TRANSFER_ALL, clear_transfer_all_cmd);
+    cmd.cmdAdd(PRINT_TRANSFER, print_transfer_cmd);
+    cmd.cmdAdd(RT_TRANSFER, rt_transfer_cmd);
+    cmd.cmdAdd(SET_CONSTANT, set_constant_cmd);                     // named constants of the transfer expressions
+    cmd.cmdAdd(DEL_CONSTANT, del_constant_cmd);
+    cmd.cmdAdd(MEM_CMD, mem_cmd);                                   // use of the RAM and the arena
     
     // Cellular commands that need to be set for the modem to send data to the server
     cmd.cmdAdd(SET_SENSOR_NUM, set_sensor_num);
@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "crc.h"
+
+/*
+CRCs computed one byte at a time with the tables in flash (see crc.h):
+1. CRC-7 of the SD commands (crc_7.cpp).
+2. Dallas CRC-8 of the unique serial number.
+3. CRC-16 of the SD data blocks, so that each block that is read is checked.
+4. CRC-32 of the records.  The words of a long buffer are sent to the CRC32 engine of the
+   Device Service Unit (DSU), which reads the memory without the CPU.
+
+REFERENCE:
+SAMD21 datasheet, 13.11.3 Cyclic Redundancy Check (CRC32)
+*/
+
+const uint8_t CRC7_TABLE[CRC_TABLE_NUM] = { CRC_TABLE_256(crc7_entry) };
+const uint8_t CRC8_TABLE[CRC_TABLE_NUM] = { CRC_TABLE_256(crc8_entry) };
+const uint16_t CRC16_TABLE[CRC_TABLE_NUM] = { CRC_TABLE_256(crc16_entry) };
+const uint32_t CRC32_TABLE[CRC_TABLE_NUM] = { CRC_TABLE_256(crc32_entry) };
+
+// check values of the tables
+static_assert(crc7_entry(1) == 0x09 && crc7_entry(0x80) == 0x41, "CRC-7 table");
+static_assert(crc8_entry(1) == 0x5E && crc8_entry(0x80) == 0x8C, "CRC-8 table");
+static_assert(crc16_entry(1) == 0x1021 && crc16_entry(0x80) == 0x9188, "CRC-16 table");
+static_assert(crc32_entry(1) == 0x77073096UL && crc32_entry(0x80) == 0xEDB88320UL, "CRC-32 table");
+
+
+uint8_t crc8_dallas(const uint8_t *p, size_t n)
+{
+    uint8_t crc = 0;
+    for(size_t k = 0; k < n; k++) crc = CRC8_TABLE[crc ^ p[k]];
+    return crc;
+} // end
+
+
+// CRC-16 of the data block (sent MSB first after the block)
+uint16_t crc16_sd(const uint8_t *p, size_t n)
+{
+    uint16_t crc = 0;
+    for(size_t k = 0; k < n; k++) crc = (uint16_t)(crc << 8) ^ CRC16_TABLE[(uint8_t)(crc >> 8) ^ p[k]];
+    return crc;
+} // end
+
+
+#ifdef ARDUINO_ARCH_SAMD
+/*
+CRC-32 of the words at p with the DSU (p and n are multiples of 4).
+crc is the value of the CRC before the words (not inverted).
+Returns false if the DSU cannot read the memory or does not finish within CRC_DSU_POLLS_PER_WORD polls per word.
+*/
+static bool dsu_crc32(uint32_t &crc, const uint8_t *p, size_t n)
+{
+    PAC1->WPCLR.reg = PAC_WPCLR_WP(1UL << (ID_DSU % 32));     // the DSU is write protected after reset
+    DSU->STATUSA.reg = DSU_STATUSA_DONE | DSU_STATUSA_BERR;
+    DSU->ADDR.reg = DSU_ADDR_ADDR((uintptr_t)p >> 2);
+    DSU->LENGTH.reg = DSU_LENGTH_LENGTH(n >> 2);
+    DSU->DATA.reg = crc;
+    DSU->CTRL.reg = DSU_CTRL_CRC;
+    uint32_t polls = (uint32_t)(n >> 2) * CRC_DSU_POLLS_PER_WORD;
+    while (!DSU->STATUSA.bit.DONE)
+    {
+        if (polls-- == 0)
+        {
+            DSU->CTRL.reg = DSU_CTRL_SWRST;     // stop the DSU
+            return false;
+        }
+    }
+    bool good = !DSU->STATUSA.bit.BERR;
+    if (good) crc = DSU->DATA.reg;
+    DSU->STATUSA.reg = DSU_STATUSA_DONE | DSU_STATUSA_BERR;
+    return good;
+} // end
+#else
+// the DSU is not available on the host (native tests), so all of the words use the table
+static bool dsu_crc32(uint32_t &crc, const uint8_t *p, size_t n)
+{
+    return false;
+} // end
+#endif
+
+
+/*
+Add the bytes to the CRC-32.
+Start with crc = 0xFFFFFFFF and invert the CRC after the last byte.
+*/
+uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t n)
+{
+    while (n && ((uintptr_t)p & 3))
+    {
+        crc = (crc >> 8) ^ CRC32_TABLE[(uint8_t)crc ^ *p++];
+        n--;
+    }
+    size_t words = n & ~(size_t)3;
+    if (words >= CRC_DSU_MIN_SIZ && dsu_crc32(crc, p, words))
+    {
+        p += words;
+        n -= words;
+    }
+    for(size_t k = 0; k < n; k++) crc = (crc >> 8) ^ CRC32_TABLE[(uint8_t)crc ^ p[k]];
+    return crc;
+} // end
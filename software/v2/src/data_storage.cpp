@@ -18,6 +18,14 @@
 #include "experiment.h"
 #include "temperature1w.h"
 #include "WaterWatcherOptions.h"
+#include "gps_manager.h"
+#include "time_helper.h"
+#include "time_service.h"
+#include "rtc_discipline.h"
+#include "record.h"
+#include "power_policy.h"
+#include "event_detect.h"
+#include <DallasTemperature.h>
 
 
 //---------------------------------------------------------------------------------
@@ -41,15 +49,34 @@ struct main_data_storage ds;
 //---------------------------------------------------------------------------------
 void populate_data_first()
 { 
+    populate_data_analog();
+    populate_data_temperature(populate_values_temp_sensor());
+} // end
+
+
+// Sample the analog channels at the start of the sample
+void populate_data_analog()
+{
     WaterWatcherOptions *opt = get_options();
 
-    ds.start_time_str = get_time(); 
+    ds.start_time = time_service_epoch_ms();
     if(opt->is_sample_a0()) get_turbidity(ds.a0_voltage); 
     if(opt->is_sample_a1()) get_tds(ds.a1_voltage);
     if(opt->is_sample_a2()) obtain_a2(ds.a2_voltage); 
-    bool temp_good;
-    get_water_temperature(ds.water_temperature, temp_good);  
+} // end
+
+
+// Store the temperatures after the probes have been read
+void populate_data_temperature(bool temp_good)
+{
+    get_water_temperature_last(ds.water_temperature, temp_good);  
     if(temp_good==false) ds.water_temperature = NO_SAMPLE_VALUE;     
+    ds.num_temp_sensors = get_temperature_probe_count();
+    for(size_t k = 0; k < ds.num_temp_sensors; k++)
+    {
+      float v = temp_sensor_values[k];
+      ds.temperature[k] = (v == DEVICE_DISCONNECTED_C) ? NO_SAMPLE_VALUE : v;
+    }
 } // end
 
 
@@ -58,14 +85,56 @@ void populate_data_first()
 // EDIT THIS FUNCTION TO OBTAIN ADDITIONAL ANCILLARY DATA
 //---------------------------------------------------------------------------------
 void populate_data_second()
+{
+  populate_data_ancillary();
+  gps_obtain_data();                                  // GPS obtain data
+  ds.end_time = time_service_epoch_ms();              // ending time of operations
+  ds.rtc_gps_offset_valid = false;
+} // end
+
+
+// Obtain the ancillary data that does not depend on the GPS
+void populate_data_ancillary()
 {
   get_serial_number();                                // serial number of unit
   get_state_battery();                                // battery state
   obtain_bmon();                                      // battery monitor information
   get_rtc_temperature();                              // RTC temperature 
+  ds.pp_valid = get_power_profile(ds.pp_mah, ds.pp_ms); // power profile of the last cycle
 
-  gps_obtain_data();                                  // GPS obtain data
-  ds.end_time_str = get_time();                       // ending time of operations
+  // battery-aware policy for the next samples
+  power_policy_update(ds.bvoltage, ds.bcapacity, ds.battery_charging, ds.battery_fault);
+  ds.policy_tier = get_policy_tier();
+  ds.policy_m = power_policy_interval(get_m_alarm());
+} // end
+
+
+/*
+Poll the GPS for the sample without waiting.
+Returns true when the fix has been obtained (or is reused), or when timeout is true.
+The ending time of the sample is set when this function returns true.
+*/
+bool populate_data_gps(bool timeout)
+{
+  bool reused;
+  bool done = gps_poll_fix(ds.gdata, reused);
+  if (!done && !timeout) return false;
+  if (!done) ds.gdata.good = false;
+  ds.gps_reused = reused;
+  ds.gps_ttff = gps_get_ttff();
+  ds.gps_on_time = gps_take_on_time();
+  ds.end_time = time_service_epoch_ms();              // ending time of operations
+
+  // offset of the RTC from the GPS time (includes the delay of the sentences from the receiver)
+  uint64_t gps_ms = gps_fix_epoch_ms(ds.gdata);
+  ds.rtc_gps_offset_valid = done && !reused && ds.gdata.good && gps_ms != 0;
+  if (ds.rtc_gps_offset_valid)
+  {
+    uint64_t rtc_ms = time_service_epoch_ms() - (millis() - ds.gdata.rx_ms);
+    ds.rtc_gps_offset = (int32_t)(int64_t)(rtc_ms - gps_ms);
+    rtc_discipline_update(ds.rtc_gps_offset, gps_ms);
+  }
+  return true;
 } // end
 
 
@@ -108,7 +177,7 @@ void print_state_battery()
 
 void get_serial_number()
 {
-  ds.serial_number_good = uniqueSerial.getString(ds.serial_number);
+  ds.serial_number_good = uniqueSerial.getChars(ds.serial_number, sizeof(ds.serial_number));
 } // end
 
 
@@ -164,34 +233,47 @@ void time_function(String in)
   }
   bool rv = rtc.setTime(day, month, year, hour, minute, second);
   if (rv==false) printSerial(ERROR_STRING);
-  else printSerial(SUCCESS_STRING);
+  else
+  {
+    time_service_sync();
+    if (get_alarm_on()) set_next_alarm_rtc();   // the alarm matches the date, so the step could skip it
+    printSerial(SUCCESS_STRING);
+  }
 } // end
 
 
+static const char *const WDAYS[7] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+
 // Function to actually get the time
 String get_time(bool with_days)
 {
   char s[MAX_TIME_STR_SIZ];
-  const String wdays[7] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
-
-  int day, month, year, hour, minute, second, dayNum;
-  rtc.getTime(day, month, year, hour, minute, second, dayNum);
-  sprintf(s, TIME_FORMAT, day, month, year, hour, minute, second);
+  get_time_chars(s, sizeof(s));
   String sv = String(s);
   if(with_days)
   {
+    int day, month, year, hour, minute, second, dayNum;
+    time_service_time(day, month, year, hour, minute, second, dayNum);
     if (dayNum < 1 || dayNum > 7) return sv;
-    String dayS = wdays[dayNum-1];
-    return sv + "," + dayS;
+    return sv + "," + WDAYS[dayNum-1];
   }
   return sv;
 } // end
 
 
+// Write the time (TIME_FORMAT) to s without using String, so that the time can be logged during the sample
+void get_time_chars(char *s, size_t size)
+{
+  int day, month, year, hour, minute, second, dayNum;
+  time_service_time(day, month, year, hour, minute, second, dayNum);
+  snprintf(s, size, TIME_FORMAT, day, month, year, hour, minute, second);
+} // end
+
+
 // Function to obtain the time as ints
 void get_time_ints( int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum)
 {
-  rtc.getTime(day, month, year, hour, minute, second, dayNum);
+  time_service_time(day, month, year, hour, minute, second, dayNum);
 } // end
 
 
@@ -206,10 +288,13 @@ void print_time()
 
 /*
 Set the RTC to defaults on startup if the oscillator has been stopped 
+and start the time service from the RTC
 */
 void set_rtc_defaults()
 {
   rtc.setDefaultIfOscStopped();
+  setup_time_service(&rtc);
+  setup_rtc_discipline(&rtc);
 } // end
 
 
@@ -225,20 +310,24 @@ void read_status_print()
 
 /*
 Force the RTC to be set to the default time
+The alarm is set again from the new time, since the alarm matches the date of the next sample.
 */
 void set_default_time_rtc_force()
 {
-  rtc.setRTCDefaultTime();
+  if (!rtc.setRTCDefaultTime()) return;
+  time_service_sync();
+  if (get_alarm_on()) set_next_alarm_rtc();
 } // end
 
 
 /*
-Set the alarm minutely
+Set the alarm to sample every m minutes.
+The alarm is set for the time of the next sample, so that the board only wakes once per sample.
 */
 bool set_alarm_minutely(int m, bool store)
 {
   turn_off_alarms_rtc();  // ensure that alarms are initially turned off
-  if(m < 0) return false;
+  if(m < 1) return false;
   else if (m > MAX_NUM_MINUTES_RTC) return false;
   set_m(m);
   if (store) 
@@ -246,12 +335,40 @@ bool set_alarm_minutely(int m, bool store)
     set_m_flash(m);
     set_alarm_state_flash(ON_STATE);
   }
-  rtc.setAlarmOnceMinuteOrSecond(DS3231_ALARM2_ONCE_MINUTE);
+  if (!set_next_alarm_rtc()) return false;
   attach_alarm_interrupt();
   return true;
 } // end
 
 
+/*
+Set the alarm for the time of the next sample.
+This also clears the alarm that has fired.
+*/
+bool set_next_alarm_rtc()
+{
+  uint32_t next;
+  bool rv = rtc.setAlarmNextInterval(event_interval(power_policy_interval(get_m_alarm())), next);
+  #ifdef DEBUG_ALARM
+    int day, month, year, hour, minute, second, dayNum;
+    time_from_epoch(next, day, month, year, hour, minute, second, dayNum);
+    char buf[MAX_TIME_STR_SIZ+1];
+    snprintf(buf, MAX_TIME_STR_SIZ+1, TIME_FORMAT, day, month, year, hour, minute, second);
+    printSerial("Next alarm: " + String(buf));
+  #endif
+  return rv;
+} // end
+
+
+/*
+Returns true if alarm #2 has fired
+*/
+bool alarm_fired_rtc()
+{
+  return checkBit(rtc.readStatus(), 1);
+} // end
+
+
 /*
 Function to clear the RTC alarms in the status register
 */ 
@@ -298,12 +415,14 @@ Call this function to obtain the battery monitor information
 */
   void obtain_bmon()
   {
-    bmon.findAll();
-    Vector<DS2438Info> v;
-    bmon.getDataAll(v);
-    int siz = v.size();
-    if (siz != 1) return;
-    DS2438Info info = v[0];  // only one battery monitor
+    bmon.findIfRequired();
+    DS2438Info info;
+    if (bmon.count() != 1 || !bmon.getData(0, info))
+    {
+      bmon.invalidate();  // device count has changed, so search the bus at the next sample
+      return;
+    }
+    // only one battery monitor
     ds.btemperature = info.temperature;
     ds.bvoltage = info.voltage;
     ds.bcurrent = info.current;
@@ -312,13 +431,31 @@ Call this function to obtain the battery monitor information
   } // end
 
 
+/*
+Call this function to obtain only the battery current (A).
+Returns false if the battery monitor cannot be read.
+*/
+bool obtain_bmon_current(float &current)
+{
+  bmon.findIfRequired();
+  if (bmon.count() != 1) return false;
+  if (bmon.readCurrent(current)) return true;
+  bmon.invalidate();
+  return false;
+} // end
+
+
 void obtain_a2(float &v_out)
 {
-  bmon.findAll();
+  bmon.findIfRequired();
   Vector<DS2438VAD> v;
   bmon.getDataVAD(v);
   int siz = v.size();
-  if (siz != 1) return;
+  if (siz != 1)
+  {
+    bmon.invalidate();
+    return;
+  }
   DS2438VAD data = v[0];
   v_out = data.vad;
 } // end
@@ -329,7 +466,7 @@ Print the battery monitor information
 */
 void print_bmon()
 {
-  bmon.findAll();
+  bmon.findIfRequired();
   Vector<DS2438Info> v;
   bmon.getDataAll(v);
   int siz = v.size();
@@ -371,16 +508,25 @@ Get the RTC
 */ 
 void get_time_rtc(int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum)
 {
-  rtc.getTime(day, month, year, hour, minute, second, dayNum); 
+  time_service_time(day, month, year, hour, minute, second, dayNum);
 } // end
 
 
 /*
-Get the RTC time using C language binding
+Get the RTC time as seconds since 1970-01-01 00:00:00
+*/
+uint32_t get_epoch_rtc()
+{
+  return time_service_epoch();
+} // end
+
+
+/*
+Get the RTC time using C language binding (used for the FatFs timestamps)
 */
 void get_time_rtc_cbind(int *day, int *month, int *year, int *hour, int *minute, int *second, int *dayNum)
 {
-  rtc.getTime(*day, *month, *year, *hour, *minute, *second, *dayNum); 
+  time_service_time(*day, *month, *year, *hour, *minute, *second, *dayNum);
 } // end
 
 
@@ -393,6 +539,16 @@ void gps_run_poll()
   gps.run_poll();
 } // end 
 
+
+/*
+Function to parse the bytes that have arrived from the GPS.
+This is called from the main loop and from yield().
+*/
+void gps_feed()
+{
+  gps.feed();
+} // end
+
 /*
 Function to start the poll
 CLI: gps-start-poll
@@ -421,12 +577,15 @@ bool is_gps_data_good()
 } // end
 
 /* 
-Call this function to obtain data from the GPS
+Call this function to obtain data from the GPS for the sample
 */ 
 void gps_obtain_data()
 {
-    sample_gps();
-    gps.obtain_gps_data(&ds.gdata);
+    bool reused;
+    gps_get_fix(ds.gdata, reused);
+    ds.gps_reused = reused;
+    ds.gps_ttff = gps_get_ttff();
+    ds.gps_on_time = gps_take_on_time();
 } // end
 
 /*
@@ -435,53 +594,20 @@ CLI: print-gps
 void print_gps()
 {
     // actually obtain the GPS data, then...
-    gps_obtain_data();
+    sample_gps();
+    gps.obtain_gps_data(&ds.gdata);
 
     // ...print the data from the GPS
     printSerial("GPS data:");
-    printSerial("lat:");
-    printSerial(String(ds.gdata.lat));
-    printSerial("lng:");
-    printSerial(String(ds.gdata.lng));
-    printSerial("speed:");
-    printSerial(String(ds.gdata.speed));
-    printSerial("alt:");
-    printSerial(String(ds.gdata.alt));
-    printSerial("height:");
-    printSerial(String(ds.gdata.height));
-    printSerial("lat_err:");
-    printSerial(String(ds.gdata.lat_err));
-    printSerial("long_err:");
-    printSerial(String(ds.gdata.long_err));
-    printSerial("alt_err:");
-    printSerial(String(ds.gdata.alt_err));
-    printSerial("hours:");
-    printSerial(String(ds.gdata.hours));
-    printSerial("minutes:");
-    printSerial(String(ds.gdata.minutes));
-    printSerial("seconds:");
-    printSerial(String(ds.gdata.seconds));
-    printSerial("microseconds:");
-    printSerial(String(ds.gdata.microseconds));
-    printSerial("day:");
-    printSerial(String(ds.gdata.day));
-    printSerial("month:");
-    printSerial(String(ds.gdata.month));
-    printSerial("year:");
-    printSerial(String(ds.gdata.year));
-    printSerial("fix_quality:");
-    printSerial(String(ds.gdata.fix_quality));
-    printSerial("satellites:");
-    printSerial(String(ds.gdata.satellites));
-    printSerial("total_sats:"); 
-    printSerial(String(ds.gdata.total_sats));
+    record_print(ds, RG_GPS);
 } // end
 
 /*
 Sample from the GPS
+This waits for a current fix, and returns immediately if the fix is already current.
 */
 void sample_gps()
 {
-  gps.read_data();
+  gps.read_data(SERIAL_PORT_TIMEOUT);
 } // end
 
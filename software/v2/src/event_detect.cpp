@@ -0,0 +1,190 @@
+#include <Arduino.h>
+#include "event_detect.h"
+#include "constants.h"
+#include "flash_mem.h"
+#include "data_storage.h"
+#include "main_local.h"
+#include "sd_storage.h"
+#include "WaterWatcherOptions.h"
+
+/*
+Event detection on the transfer function outputs (event-on).
+
+Each channel {a0_out, a1_out, temp0_out} is checked at every sample for:
+1. Threshold: the output is above hi.
+2. Rate of change: the magnitude of the change since the last sample is above rate (per minute).
+3. CUSUM: the two-sided cumulative sum of the deviations from the baseline (less the drift k) is above h.
+   The baseline is an exponentially weighted moving average of the output.
+Each check is disabled when the limit is zero (set-event).
+
+When a check trips, the samples are taken every event_m minutes and the records are sent immediately.
+The event ends after event_cooldown samples without a trip, and the samples are then taken at the base interval.
+The start and end of each event are printed and logged to <name>.log on the SD card.
+*/
+
+const char *const EVENT_CHANNEL_NAMES[NUM_EVENT_CHANNELS] = {"a0", "a1", "temp0"};
+
+static struct event_channel_data
+{
+    bool init;              // true if the channel has a previous sample
+    float last;             // output at the previous sample
+    uint32_t last_time;     // RTC time (s) of the previous sample
+    float mean;             // baseline used by the CUSUM
+    float pos;              // CUSUM of the positive deviations
+    float neg;              // CUSUM of the negative deviations
+} ecd[NUM_EVENT_CHANNELS];
+
+static struct event_detect_data
+{
+    bool active;            // true during an event
+    int cooldown;           // samples without a trip before the event ends
+} edd;
+
+
+// Check a channel and return the flags of the checks that tripped
+static int event_check_channel(size_t ch, float v, uint32_t now)
+{
+    event_channel_data &c = ecd[ch];
+    if (isnan(v) || v == NO_SAMPLE_VALUE) return 0;
+
+    float hi, rate, k, h;
+    get_event_limits(ch, hi, rate, k, h);
+
+    int flags = 0;
+    if (hi != 0 && v > hi) flags |= EVENT_FLAG_THRESHOLD;
+    if (!c.init)
+    {
+        c.init = true;
+        c.mean = v;
+        c.pos = 0;
+        c.neg = 0;
+    }
+    else
+    {
+        if (rate != 0 && now > c.last_time)
+        {
+            float minutes = (now - c.last_time) / 60.0f;
+            if (fabs(v - c.last) / minutes > rate) flags |= EVENT_FLAG_RATE;
+        }
+        if (h != 0)
+        {
+            c.pos += v - c.mean - k;
+            c.neg += c.mean - v - k;
+            if (c.pos < 0) c.pos = 0;
+            if (c.neg < 0) c.neg = 0;
+            if (c.pos > h || c.neg > h)
+            {
+                flags |= EVENT_FLAG_CUSUM;
+                c.pos = 0;
+                c.neg = 0;
+            }
+        }
+        c.mean += EVENT_EWMA_ALPHA * (v - c.mean);
+    }
+    c.last = v;
+    c.last_time = now;
+    return flags;
+} // end
+
+
+void setup_event_detect()
+{
+    edd.active = false;
+    edd.cooldown = 0;
+    for(size_t k = 0; k < NUM_EVENT_CHANNELS; k++) ecd[k].init = false;
+} // end
+
+
+/*
+Call this function after the transfer function outputs have been computed for the sample.
+This sets d.event and d.event_flags.
+*/
+void event_detect_update(struct main_data_storage &d)
+{
+    d.event = false;
+    d.event_flags = 0;
+    if (!get_event_on())
+    {
+        if (edd.active) setup_event_detect();
+        return;
+    }
+
+    WaterWatcherOptions *opt = get_options();
+    uint32_t now = get_epoch_rtc();
+    if (opt->is_sample_a0()) d.event_flags |= event_check_channel(0, d.a0_out, now);
+    if (opt->is_sample_a1()) d.event_flags |= event_check_channel(1, d.a1_out, now) << 3;
+    if (opt->is_sample_temp0()) d.event_flags |= event_check_channel(2, d.water_temperature_out, now) << 6;
+
+    bool was_active = edd.active;
+    if (d.event_flags != 0)
+    {
+        edd.active = true;
+        edd.cooldown = get_event_cooldown();
+        if (!was_active)
+        {
+            char line[32];
+            snprintf(line, sizeof(line), "event start flags=%d", d.event_flags);
+            sd_write_log(line);
+        }
+    }
+    else if (edd.active && --edd.cooldown <= 0)
+    {
+        edd.active = false;
+        sd_write_log("event end");
+    }
+    d.event = edd.active;
+
+    // use the interval from the next sample
+    if (edd.active != was_active && get_alarm_on()) set_next_alarm_rtc();
+} // end
+
+
+/*
+Returns true during an event
+*/
+bool is_event_active()
+{
+    return edd.active;
+} // end
+
+
+/*
+Returns the interval (minutes) to be used for the next sample
+*/
+int event_interval(int m)
+{
+    if (!edd.active || get_event_m() > m) return m;
+    return get_event_m();
+} // end
+
+
+/*
+Returns the number of the channel with the name {a0, a1, temp0} or -1 if there is no channel with the name
+*/
+int get_event_channel(String name)
+{
+    for(size_t k = 0; k < NUM_EVENT_CHANNELS; k++)
+    {
+        if (name == EVENT_CHANNEL_NAMES[k]) return k;
+    }
+    return -1;
+} // end
+
+
+/*
+CLI: print-event
+*/
+void print_event_detect()
+{
+    printSerial("event_on: " + String(get_event_on()));
+    printSerial("active: " + String(edd.active));
+    printSerial("event_m: " + String(get_event_m()));
+    printSerial("cooldown: " + String(get_event_cooldown()));
+    printSerial("CHANNEL/HI/RATE/K/H");
+    for(size_t ch = 0; ch < NUM_EVENT_CHANNELS; ch++)
+    {
+        float hi, rate, k, h;
+        get_event_limits(ch, hi, rate, k, h);
+        printSerial(String(EVENT_CHANNEL_NAMES[ch]) + "/" + String(hi) + "/" + String(rate) + "/" + String(k) + "/" + String(h));
+    }
+} // end
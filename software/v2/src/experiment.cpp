@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Timer.h>
 #include "experiment.h"
 #include "main_local.h"
 #include "flash_mem.h"
@@ -9,31 +8,45 @@
 #include "sd_storage.h"
 #include  "spi_local.h"
 #include "constants.h"
-#include "jWrite.h"
 #include "safe_string.h"
 #include "temperature1w.h"
-#include "constants.h"
+#include "gps_manager.h"
+#include "SimpleTaskScheduler.h"
+#include "power_profile.h"
+#include "uplink.h"
+#include "event_detect.h"
+#include "record.h"
+#include "record_sink.h"
+#include "heap_check.h"
 
 //----------------------------------------------------------------------------------------
 
-static Timer t;                                 // timer to wait for the initial turn on 
 static struct main_data_storage d;              // struct to hold the data
-static String js;                               // string from last observation as JSON
-static String csv;                              // string to hold CSV
 
-// Buffers used for copying
-static char buff[MAX_BUFF_SIZ_JSON];
-static char small_buff[SMALL_BUFF_JSON_SIZ];
+// Stages of the sample.  Each stage is called from the sample task and returns instead of waiting.
+enum sample_stage
+{
+    STAGE_ANALOG,           // sample the analog channels and start the 1-wire conversion
+    STAGE_TEMPERATURE,      // read the 1-wire probes after the conversion
+    STAGE_ANCILLARY,        // obtain the ancillary data
+    STAGE_GPS,              // poll the GPS until the fix is obtained or GPS_FIX_WAIT
+    STAGE_STORE,            // format the data and write to the SD card
+    STAGE_SEND              // wait for the modem task to send the data
+}; // end
 
 // Experiment data used to establish state
 struct experiment_data
 {
     bool is_running;
-    int id;
+    int id;                 // id of the sample task
+    sample_stage stage;     // next stage of the sample
+    int temp_attempt;       // attempts to read the 1-wire probes
+    unsigned long gps_ms;   // millis() at the start of the GPS stage
+    char csv_checked[MAX_NUM_CHARS_SENSOR_NAME + sizeof(CSV_FILENAME_EXTENSION)];  // CSV file with the header checked since the reset
 } ed; // end
 
 
-void printSerialDebugCell(String s)
+void printSerialDebugCell(const char *s)
 {
     #ifdef DEBUG_CELLULAR
         printSerial(s);
@@ -41,21 +54,21 @@ void printSerialDebugCell(String s)
 } // end
 
 
-/* 
-Function to be called from the main loop
-*/ 
-void timer_update()
+/*
+Function to setup the experiment
+*/
+void setup_experiment()
 {
-    t.update();
+    ed.is_running = false;
 } // end
 
 
 /*
-Function to setup the experiment
+Returns true if the sample is being taken
 */
-void setup_experiment()
+bool is_experiment_running()
 {
-    ed.is_running = false;
+    return ed.is_running;
 } // end
 
 
@@ -76,16 +89,14 @@ void stop_experiment()
     // Turn off the SD card.  This is always necessary to ensure that the card is periodically reset after each write.
     off_sd_card();
 
-    if (get_shutdown_rails())
-    {
-        printSerialDebugCell("Shutting down 5V rail if GPS fix is good...");
-        // ensure that the GPS has a fix, if not then keep on the 5V rail so that the GPS can get a fix
-        if(is_gps_data_good()) 
-        {
-            printSerialDebugCell("GPS data is good, turning off the 5V rail...");
-            turn_off_5V_ext();
-        }
-    }
+    // Turn off the 5V rail (if required) or put the GPS into backup mode.
+    // If the GPS does not have a fix, then the 5V rail is kept on so that the GPS can get a fix.
+    printSerialDebugCell("Shutting down 5V rail if GPS fix is good...");
+    gps_end_sample(get_shutdown_rails());
+
+    // Put the modem back to sleep if the sample ended before the data was sent
+    cell_task_abort();
+    power_profile_end();
     clear_experiment();
 } // end
 
@@ -97,20 +108,105 @@ This is the function that is triggered by the RTC time clock
 */
 void start_experiment()
 {
+    if (ed.is_running)
+    {
+        printSerial("Sample is already running");
+        return;
+    }
     printSerialDebugCell("Starting the experiment...");
     clear_experiment();
+    power_profile_begin();
     ed.is_running = true;
+    ed.stage = STAGE_ANALOG;
+    unsigned long wait = TASK_NOW;
     if(!check_is_ext_on())
     {
         printSerialDebugCell("Turning on the 5V rail and then waiting...");
         turn_on_5V_ext();
-        ed.id = t.after(EXPERIMENT_TICK, start_experiment_second_stage_timer);
+        wait = EXPERIMENT_TICK;     // allow the sensors to settle
     }
     else
     {
         printSerialDebugCell("Not turning on 5V rail, continuing to second stage");
-        start_experiment_second_stage();
     }
+    gps_begin_sample();
+
+    // Wake the modem and attach to the network while the sensors settle and are sampled.
+    // The data is given to the modem task after the data is written to the SD card.
+    // The modem is only woken if the record of this sample completes the uplink batch.
+    if (get_send_cell() && uplink_due_next()) cell_task_start();
+    ed.id = scheduler.add(sample_task, wait);
+    if (ed.id == NO_TASK) stop_experiment();
+} // end
+
+
+/*
+Task that takes the sample.
+The sensors are sampled first, and the data that is geolocated with the GPS measurements is then obtained.
+The data is then cached to the SD card and sent over cellular.
+*/
+unsigned long sample_task()
+{
+    bool temp_good;
+    bool sending;
+    switch(ed.stage)
+    {
+        case STAGE_ANALOG:
+            heap_check_begin();
+            printSerialDebugCell("Starting the second stage, reading data and then GPS");
+            power_profile_mark(PP_SENSORS);
+            populate_data_analog();
+            ed.temp_attempt = 0;
+            ed.stage = STAGE_TEMPERATURE;
+            return start_temperature_conversion();
+
+        case STAGE_TEMPERATURE:
+            temp_good = read_temperature_conversion();
+            if (!temp_good && get_temperature_probe_count() != 0 && ++ed.temp_attempt < 2)
+            {
+                // search the bus again and try one more time
+                invalidate_temperature_bus();
+                return start_temperature_conversion();
+            }
+            populate_data_temperature(temp_good);
+            ed.stage = STAGE_ANCILLARY;
+            return TASK_NOW;
+
+        case STAGE_ANCILLARY:
+            populate_data_ancillary();
+            ed.gps_ms = millis();
+            power_profile_mark(PP_GPS);
+            ed.stage = STAGE_GPS;
+            return TASK_NOW;
+
+        case STAGE_GPS:
+            if (!populate_data_gps(millis() - ed.gps_ms >= GPS_FIX_WAIT)) return SAMPLE_GPS_POLL;
+            if (is_gps_data_good()) printSerialDebugCell("GPS data is good...");
+            ed.stage = STAGE_STORE;
+            return TASK_NOW;
+
+        case STAGE_STORE:
+            power_profile_mark(PP_SD);
+            printSerialDebugCell("Obtaining main data");
+            get_main_data_struct(d);  // obtain the data from the main routines
+            printSerialDebugCell("Obtained main data");
+            compute_data_outputs();
+            event_detect_update(d);
+            sending = format_data_for_storage_and_send();
+            if (!sending) break;
+            ed.stage = STAGE_SEND;
+            return CELL_TASK_POLL;
+
+        case STAGE_SEND:
+            if (cell_task_busy()) return CELL_TASK_POLL;
+            break;
+
+        default:
+            break;
+    }
+    heap_check_end();           // after the records have been sent
+    stop_experiment();
+    return TASK_DONE;
 } // end
 
 
@@ -125,87 +221,102 @@ void populate_first_and_second_data()
 
 
 /*
-Function to start the second stage and also stop the timer used to insert a delay 
-*/ 
-void start_experiment_second_stage_timer()
+Append the record in JSON to the observation file on the SD card.
+offset is set to the offset of the record in the file, so that the record can be read back to be sent in a batch.
+*/
+static bool store_data_json(uint32_t &offset)
 {
-    printSerialDebugCell("In second stage for timer");
-    t.stop(ed.id);
-    start_experiment_second_stage();
+    char fname[MAX_NUM_CHARS_SENSOR_NAME + sizeof(FILENAME_EXTENSION)];
+    get_name_of_file(fname);
+    printSerialWithoutLineEnding("file name: ");
+    printSerial(fname);
+
+    RecordSdSink file;
+    RecordCrcSink crc;
+    RecordTeeSink out(file, crc);
+    if (!file.open(fname, offset)) return false;
+    record_write_json(d, out);
+    file.write(CRLF);           // terminate with CRLF for readability
+    bool rv = file.close();
+    crc.print();
+    return rv;
 } // end
 
 
 /*
-Function to start the second stage of the sampling.
-In this function, the data is sent over cellular and also cached to SD card.
+Check the names of the columns in the CSV file against the header of this firmware (by the CRC of the header).
+The first line of the file is only read once after a reset or a change of the name of the file, since the header
+only changes with the firmware.  If the header is different, the file is rotated to <name>-<N>.csv so that the
+columns of each file match the header of the file.
 */
-void start_experiment_second_stage()
+static void check_csv_header(const char *fname)
 {
-    printSerialDebugCell("Starting the second stage, reading data and then GPS");
-    for(int i = 0; i < GPS_RETRIES; i++)
+    if (strcmp(fname, ed.csv_checked) == 0) return;
+    uint32_t size;
+    if (!sd_file_size(fname, size)) return;     // check again with the next sample
+    if (size != 0)
     {
-        printSerialDebugCell("i = " + String(i));
-        populate_first_and_second_data();           // populate the data that is geolocated with GPS measurements
-        if (is_gps_data_good()) 
+        RecordCrcSink header;
+        RecordCrcSink first;
+        uint32_t next;
+        record_write_csv_header(header);
+        if (!sd_stream_line(fname, 0, first, next) || first.value() != header.value())
         {
-            printSerialDebugCell("GPS data is good...");
-            break;
+            printSerial("CSV header changed, rotating the file");
+            if (!sd_rotate_file(fname)) return;
         }
     }
-    printSerialDebugCell("Obtaining main data");
-    get_main_data_struct(d);  // obtain the data from the main routines
-    printSerialDebugCell("Obtained main data");
-
-    // format the data to be sent to SD card and cellular
-    format_data_for_storage_and_send();
+    strlcpy(ed.csv_checked, fname, sizeof(ed.csv_checked));
 } // end
 
 
-// Format the SD card data for storage
-void format_data_for_storage_and_send()
+/*
+Append the record to the CSV file on the SD card.
+The names of the columns are written first if the file is new.
+*/
+static bool store_data_csv()
 {
-    String data_json, data_json_additional;
-    data_json = format_data_json();
-
-    printSerial("Writing text to file...");
-    write_text_to_obs_file(data_json.c_str());
-    printSerial("Done writing text to file.");
-
-    //--------------------------------------------
-    // Send the data to cellular (if required)
-    //--------------------------------------------
-    if (!get_send_cell())
+    char fname[MAX_NUM_CHARS_SENSOR_NAME + sizeof(CSV_FILENAME_EXTENSION)];
+    snprintf(fname, sizeof(fname), "%s" CSV_FILENAME_EXTENSION, get_sensor_name_str());
+    check_csv_header(fname);
+
+    RecordSdSink file;
+    uint32_t size;
+    if (!file.open(fname, size)) return false;
+    if (size == 0)
     {
-        stop_experiment();   
-    }
-    else
-    {
-        // the experiment needs to be stopped in the send_data_cell() function
-        send_data_cell(data_json);  
+        record_write_csv_header(file);
+        file.write(CRLF);
     }
+    record_write_csv(d, file);
+    file.write(CRLF);
+    return file.close();
 } // end
 
 
-void assemble_string_float(String &s, const float var)
-{
-    String value = String(var, DEC_PLACES_PRINT);
-    s += value + ",";
-} // end
-
-
-template <class T>
-void assemble_string_other(String &s, const T var)
+/*
+Format the SD card data for storage and start sending the data over cellular.
+Returns true if the data is being sent.
+*/
+bool format_data_for_storage_and_send()
 {
-    String value = String(var);
-    s += value + ",";
-} // end 
+    d.uplink_pending = get_uplink_pending();
 
+    // the records in the CSV file are not read back to be sent, so the records are sent as they are stored
+    printSerial("Writing text to file...");
+    bool stored = false;
+    uint32_t offset = 0;
+    if (get_sd_json()) stored = store_data_json(offset);
+    else store_data_csv();
+    printSerial("Done writing text to file.");
 
-// String copy function from const char to char
-char *string_cpy(String s)
-{
-	strlcpy(small_buff, s.c_str(), SMALL_BUFF_JSON_SIZ);
-	return small_buff;
+    //--------------------------------------------
+    // Send the data to cellular (if required)
+    //--------------------------------------------
+    if (!get_send_cell()) return false;
+    if (!uplink_record(d, stored, offset, d.event)) return false;
+    power_profile_mark(PP_MODEM);
+    return true;
 } // end
 
 
@@ -217,161 +328,13 @@ float check_nan(float n)
 } // end
 
 
-// Format the local data in JSON
-String format_data_json()
-{
-    // Format all of the data
-    printSerialDebugCell("Formatting the data...");
-
-    // obtain the options
-    WaterWatcherOptions *opt = get_options();
-
-    //--------------------------------------
-    // Assign the sampled data
-    //--------------------------------------
-    if(opt->is_sample_a0())
-    {
-        opt->set_a0_raw(d.a0_voltage);
-    }
-    if(opt->is_sample_a1())
-    {
-        opt->set_a1_raw(d.a1_voltage);
-    }
-    if(opt->is_sample_a2())
-    {
-        opt->set_a1_raw(d.a2_voltage);
-    }
-    if(opt->is_sample_temp0())
-    {
-        opt->set_temp0_raw(d.water_temperature);
-    }
-
-    //--------------------------------------
-    // Obtain the transfer function outputs
-    // This is done after assignment since 
-    // the transfer functions are dependent on the data
-    // being collected.
-    //--------------------------------------
-    if(opt->is_sample_a0())
-    {
-        d.a0_out = opt->get_a0_out();
-    }
-    if(opt->is_sample_a1())
-    {
-        d.a1_out = opt->get_a1_out();
-    }
-     if(opt->is_sample_a2())
-     {
-         d.a2_out = opt->get_a2_out();
-     }
-     if(opt->is_sample_temp0())
-     {
-         d.water_temperature_out = opt->get_temp0_out();
-     }
-
-    //--------------------------------------
-    // open the JSON object 
-    //--------------------------------------
-    jwOpen(buff, MAX_BUFF_SIZ_JSON, JW_OBJECT, JW_COMPACT);
-
-    //-----------------------------------------------------------------
-    // TOKEN KEY AND NUMBER (REQUIRED FOR SERVER COMMUNICATIONS)
-    //-----------------------------------------------------------------
-    jwObj_string("token", get_key());
-    jwObj_int("num", get_num());
-
-    //--------------------------------------
-    // place the outputs into JSON
-    //--------------------------------------
-    if(opt->is_sample_a0())
-    {
-        jwObj_double(string_cpy("a0_voltage"), d.a0_voltage);
-        jwObj_double(string_cpy("a0_out"), d.a0_out);
-    }
-    if(opt->is_sample_a1())
-    {
-        jwObj_double(string_cpy("a1_voltage"), d.a1_voltage);
-        jwObj_double(string_cpy("a1_out"), d.a1_out);
-    }
-    if(opt->is_sample_a2())
-    {
-        jwObj_double(string_cpy("a2_voltage"), d.a2_voltage);
-        jwObj_double(string_cpy("a2_out"), d.a2_out);
-    }
-    if(opt->is_sample_temp0())
-    {
-       jwObj_double(string_cpy("temp0"), d.water_temperature);
-       jwObj_double(string_cpy("temp0_out"), d.water_temperature_out);  
-    }
-
-    //-----------------------------------------------------------------
-    // ADDITIONAL OUTPUTS
-    //-----------------------------------------------------------------
-    jwObj_string("serial_number", string_cpy(d.serial_number));
-    jwObj_bool("serial_number_good", d.serial_number_good);
-    jwObj_bool("battery_fault", d.battery_fault);
-    jwObj_bool("battery_charging", d.battery_charging);
-    jwObj_double("rtc_temperature", check_nan(d.rtc_temperature));
-    jwObj_string("start_time_str", string_cpy(d.start_time_str));
-    jwObj_string("end_time_str", string_cpy(d.end_time_str));
-    jwObj_double("btemperature", check_nan(d.btemperature)); 
-    jwObj_double("bvoltage", check_nan(d.bvoltage));
-    jwObj_double("bcurrent", check_nan(d.bcurrent));
-    jwObj_double("bcapacity", check_nan(d.bcapacity));
-    jwObj_int("uptime", d.uptime);
-    jwObj_string("name", get_sensor_name_str());
-
-    jwObj_double("latitude", check_nan(d.gdata.lat));
-    jwObj_double("longitude", check_nan(d.gdata.lng));
-    jwObj_double("speed", check_nan(d.gdata.speed));
-    jwObj_double("altitude", check_nan(d.gdata.alt));
-    jwObj_double("height", check_nan(d.gdata.height));
-    jwObj_double("lat_err", check_nan(d.gdata.lat_err));
-    jwObj_double("long_err", check_nan(d.gdata.long_err));
-    jwObj_double("alt_err", check_nan(d.gdata.alt_err));
-    jwObj_int("gps_hours", d.gdata.hours);
-    jwObj_int("gps_minutes", d.gdata.minutes);
-    jwObj_int("gps_seconds", d.gdata.seconds);
-    jwObj_int("gps_microseconds", d.gdata.microseconds);
-    jwObj_int("gps_day", d.gdata.day);
-    jwObj_int("gps_month", d.gdata.month);
-    jwObj_int("gps_year", d.gdata.year);
-    jwObj_int("gps_fix_quality", d.gdata.fix_quality);
-    jwObj_int("gps_satellites", d.gdata.satellites);
-    jwObj_int("gps_total_sats", d.gdata.total_sats);
-    jwObj_bool("gps_gdata_good", d.gdata.good);
-
-    jwClose();                          // close the JSON string (required)
-
-    String out = String(buff);          // convert the JSON data to string (may contain nan)
-
-    printSerialDebugCell("--------DONE JSON-------");
-    printSerialDebugCell(out); 
-    printSerialDebugCell("-----DONE print JSON--------");
-    return out;
-} // end
-
-
 /*
-Function to save the data to an SD card
+Apply the transfer functions to the sampled data (see WaterWatcher.h).
+Call this function before format_data_for_storage_and_send().
 */
-void save_data_to_sd()
-{   
-    printSerialDebugCell("Writing to observation file"); 
-    String swrite = "[" + js + "]" + "\r\n";
-    bool rv = write_text_to_obs_file(swrite.c_str());
-    printSerialDebugCell("DONE writing to observation file");
-    printSerialDebugCell("rv = " + String(rv));
-} // end
-
-
-/*
-Send the data via cellular.
-*/
-void send_data_cell(String s)
+void compute_data_outputs()
 {
-    send_to_server_over_cellular(s);
-    stop_experiment();
+    get_transfer_outputs()(get_options(), d);
 } // end
 
 
@@ -0,0 +1,205 @@
+#include <Arduino.h>
+#include <string.h>
+#include <math.h>
+#include "fixed_format.h"
+
+/*
+Fixed-point formatter of a float with a number of decimal places.
+
+The float is split into the 24-bit mantissa and the exponent, and the integer part and the scaled fraction
+are computed with integer shifts and one multiply, so there is no sprintf() and no double arithmetic
+(the Cortex-M0+ has no FPU).  The output is the exact value of the float rounded half up to the decimal
+places, which is the same as printf("%.*f") except for exact ties (such as 0.125 to 2 places).
+The comparison with printf() and the timing are in test/test_fixed_format (pio test -e native).
+
+Values of 2^64 or more are written as the first 8 digits with an exponent (such as 40000000e+12), and NaN and
+infinity are written as "nan" and "inf".
+
+format_general() writes the significant digits (as printf("%.9g")) for the text that is read back.
+*/
+
+static const uint32_t POW10[FIXED_FORMAT_MAX_PRECISION + 1] =
+{
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+
+// Write the digits of v and return the number of digits
+static size_t format_uint(uint64_t v, char *out)
+{
+    char tmp[20];
+    size_t n = 0;
+    if (v >> 32)
+    {
+        do { tmp[n++] = '0' + v % 10; v /= 10; } while (v >> 32);
+    }
+    uint32_t w = (uint32_t)v;       // 32-bit division is much faster than 64-bit division on the M0+
+    do { tmp[n++] = '0' + w % 10; w /= 10; } while (w);
+    for (size_t k = 0; k < n; k++) out[k] = tmp[n - 1 - k];
+    return n;
+} // end
+
+
+/*
+Format v with precision decimal places into out (at least FIXED_FORMAT_SIZ).
+Returns the length of the text (out is terminated).
+*/
+size_t format_fixed(float v, uint8_t precision, char *out)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    if (precision > FIXED_FORMAT_MAX_PRECISION) precision = FIXED_FORMAT_MAX_PRECISION;
+
+    size_t n = 0;
+    int exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent == 0xFF)
+    {
+        strcpy(out, mantissa ? "nan" : ((bits >> 31) ? "-inf" : "inf"));
+        return strlen(out);
+    }
+    if (bits >> 31) out[n++] = '-';
+
+    // v = mantissa * 2^e
+    int e;
+    if (exponent == 0) e = -149;                    // subnormal
+    else
+    {
+        mantissa |= 0x800000;
+        e = exponent - 150;
+    }
+
+    uint64_t ip;                                    // integer part
+    uint32_t fp = 0;                                // fraction scaled by 10^precision
+    if (e >= 0)
+    {
+        if (e > 40)
+        {
+            // larger than 2^64, so write the first digits and the exponent
+            int e10 = 0;
+            float a = (bits >> 31) ? -v : v;
+            while (a >= 1.0e8f)
+            {
+                a /= 10.0f;
+                e10++;
+            }
+            n += format_uint((uint64_t)a, out + n);
+            out[n++] = 'e';
+            out[n++] = '+';
+            n += format_uint(e10, out + n);
+            out[n] = '\0';
+            return n;
+        }
+        ip = (uint64_t)mantissa << e;
+    }
+    else
+    {
+        int k = -e;
+        uint64_t frac = mantissa;
+        ip = 0;
+        if (k < 32)
+        {
+            ip = mantissa >> k;
+            frac = mantissa - (ip << k);
+        }
+        // frac < 2^24 and 10^9 < 2^30, so the product fits into 64 bits
+        uint64_t scaled = frac * POW10[precision];
+        uint64_t r = (k >= 64) ? 0 : (scaled + ((uint64_t)1 << (k - 1))) >> k;
+        if (r >= POW10[precision])
+        {
+            ip++;
+            r -= POW10[precision];
+        }
+        fp = (uint32_t)r;
+    }
+
+    n += format_uint(ip, out + n);
+    if (precision)
+    {
+        out[n++] = '.';
+        for (int k = precision - 1; k >= 0; k--)
+        {
+            out[n + k] = '0' + fp % 10;
+            fp /= 10;
+        }
+        n += precision;
+    }
+    out[n] = '\0';
+    return n;
+} // end
+
+
+/*
+Format v with FIXED_FORMAT_DIGITS significant digits into out (at least FIXED_FORMAT_SIZ), as printf("%.9g").
+The trailing zeros are removed, and the exponent is used below 1e-4 and from 1e9.  Nine digits are enough for
+strtof() to read back the same float, so this is used to print the values that are entered again (calibrations,
+constants and transfer expressions).  The digits are scaled with double, so this is much slower than
+format_fixed() and is not used in the sample.
+Returns the length of the text (out is terminated).
+*/
+size_t format_general(float v, char *out)
+{
+    if (isnan(v) || isinf(v)) return format_fixed(v, 0, out);
+    size_t n = 0;
+    double a = v;
+    if (signbit(v))
+    {
+        out[n++] = '-';
+        a = -a;
+    }
+    if (a == 0)
+    {
+        strcpy(out + n, "0");
+        return n + 1;
+    }
+
+    // the digits of a rounded to FIXED_FORMAT_DIGITS (the float is exact in a double)
+    int e10 = (int)floor(log10(a));
+    double scaled = a * pow(10.0, FIXED_FORMAT_DIGITS - 1 - e10);
+    if (scaled < POW10[FIXED_FORMAT_DIGITS - 1] - 0.5)
+    {
+        scaled *= 10;       // log10() rounded up to the next power of 10
+        e10--;
+    }
+    uint32_t d = (uint32_t)(scaled + 0.5);
+    if (d >= POW10[FIXED_FORMAT_DIGITS])
+    {
+        d /= 10;            // rounded up to the next power of 10
+        e10++;
+    }
+    char digits[FIXED_FORMAT_DIGITS];
+    for (int k = FIXED_FORMAT_DIGITS - 1; k >= 0; k--)
+    {
+        digits[k] = '0' + d % 10;
+        d /= 10;
+    }
+    int num = FIXED_FORMAT_DIGITS;
+    while (num > 1 && digits[num - 1] == '0') num--;
+
+    if (e10 < -4 || e10 >= FIXED_FORMAT_DIGITS)
+    {
+        out[n++] = digits[0];
+        if (num > 1) out[n++] = '.';
+        for (int k = 1; k < num; k++) out[n++] = digits[k];
+        out[n++] = 'e';
+        out[n++] = e10 < 0 ? '-' : '+';
+        unsigned int x = e10 < 0 ? -e10 : e10;
+        if (x < 10) out[n++] = '0';
+        n += format_uint(x, out + n);
+    }
+    else if (e10 < 0)
+    {
+        out[n++] = '0';
+        out[n++] = '.';
+        for (int k = -1; k > e10; k--) out[n++] = '0';
+        for (int k = 0; k < num; k++) out[n++] = digits[k];
+    }
+    else
+    {
+        for (int k = 0; k <= e10; k++) out[n++] = k < num ? digits[k] : '0';
+        if (num > e10 + 1) out[n++] = '.';
+        for (int k = e10 + 1; k < num; k++) out[n++] = digits[k];
+    }
+    out[n] = '\0';
+    return n;
+} // end
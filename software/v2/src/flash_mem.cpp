@@ -6,6 +6,7 @@
 #include "data_storage.h"
 #include "safe_string.h"
 #include "XbeeCell.h"
+#include "calibration.h"
 
 /*
 Store variables in the microcontroller flash
@@ -32,6 +33,28 @@ typedef struct
     char apn_addr[CELL_SIZ_CHAR];                       // holds the apn address
     char server_addr[CELL_SIZ_CHAR];                    // holds the server address
 
+    uint8_t temp_rom_num;                               // number of temperature probes bound to names
+    uint8_t temp_rom[MAX_TEMP_SENSORS][8];              // ROM address of the probe bound to {t0, t1,...}
+
+    uint8_t gps_refix;                                  // obtain a new GPS position every gps_refix samples
+    uint16_t m_minutes;                                 // sampling interval (m only holds intervals < 256 minutes)
+    uint8_t power_profile;                              // 1 to profile the charge of each phase of the sample
+    uint8_t policy_on;                                  // 1 to scale the interval and uplink batch with the battery state
+
+    uint8_t event_on;                                   // 1 to sample faster after an event
+    uint8_t event_cooldown;                             // samples without a trip before the event ends
+    uint16_t event_m;                                   // sampling interval (minutes) during an event
+    float event_hi[NUM_EVENT_CHANNELS];                 // threshold of each channel (0 to disable)
+    float event_rate[NUM_EVENT_CHANNELS];               // rate of change limit (per minute) of each channel (0 to disable)
+    float event_k[NUM_EVENT_CHANNELS];                  // CUSUM drift of each channel
+    float event_h[NUM_EVENT_CHANNELS];                  // CUSUM threshold of each channel (0 to disable)
+
+    uint8_t sd_csv;                                     // 1 to store the records on the SD card as CSV instead of JSON
+
+    struct calibration cal[NUM_CAL_CHANNELS];           // calibration of each transfer function output (set-transfer)
+    char const_name[NUM_TRANSFER_CONSTANTS][MAX_CONSTANT_NAME];     // names of the constants of the expressions ("" if free)
+    float const_value[NUM_TRANSFER_CONSTANTS];                      // values of the constants
+
 } FlashData;
 
 FlashData fm;
@@ -63,6 +86,100 @@ void set_num(int n)
 } // end
 
 
+/*
+Set the number of samples between GPS position fixes (1 to fix every sample)
+*/
+void set_gps_refix(int n)
+{
+    if (n < 1) n = 1;
+    if (n > 254) n = 254;
+    fm.gps_refix = n;
+} // end
+
+
+void set_power_profile_on(bool state)
+{
+    fm.power_profile = state ? 1 : 0;
+} // end
+
+
+void set_policy_on(bool state)
+{
+    fm.policy_on = state ? 1 : 0;
+} // end
+
+
+void set_event_on(bool state)
+{
+    fm.event_on = state ? 1 : 0;
+} // end
+
+
+void set_sd_json(bool state)
+{
+    fm.sd_csv = state ? 0 : 1;
+} // end
+
+
+/*
+Set the sampling interval during an event and the number of samples without a trip before the event ends
+*/
+void set_event_fast(int m, int cooldown)
+{
+    if (m < 1) m = 1;
+    if (m > MAX_NUM_MINUTES_RTC) m = MAX_NUM_MINUTES_RTC;
+    if (cooldown < 1) cooldown = 1;
+    if (cooldown > 255) cooldown = 255;
+    fm.event_m = m;
+    fm.event_cooldown = cooldown;
+} // end
+
+
+/*
+Set the limits of the event detection for the channel (0 to disable each check)
+*/
+void set_event_limits(size_t ch, float hi, float rate, float k, float h)
+{
+    if (ch >= NUM_EVENT_CHANNELS) return;
+    fm.event_hi[ch] = hi;
+    fm.event_rate[ch] = rate;
+    fm.event_k[ch] = k;
+    fm.event_h[ch] = h;
+} // end
+
+
+/*
+Set the calibration of the channel (see calibration.cpp)
+*/
+void set_calibration(size_t ch, const struct calibration &c)
+{
+    if (ch >= NUM_CAL_CHANNELS) return;
+    fm.cal[ch] = c;
+} // end
+
+
+/*
+Set the name and value of constant k of the transfer expressions (an empty name frees the constant)
+*/
+void set_constant(size_t k, const char *name, float v)
+{
+    if (k >= NUM_TRANSFER_CONSTANTS) return;
+    strncpy(fm.const_name[k], name, MAX_CONSTANT_NAME - 1);
+    fm.const_name[k][MAX_CONSTANT_NAME - 1] = '\0';
+    fm.const_value[k] = v;
+} // end
+
+
+// Set the event detection to defaults (off)
+static void set_event_defaults()
+{
+    fm.event_on = 0;
+    fm.event_m = EVENT_M_DEFAULT;
+    fm.event_cooldown = EVENT_COOLDOWN_DEFAULT;
+    for(size_t k = 0; k < NUM_EVENT_CHANNELS; k++) set_event_limits(k, 0, 0, 0, 0);
+} // end
+
+
 void set_send_cell(bool state)
 {
     fm.send_cell = state ? 1 : 0;
@@ -83,7 +200,8 @@ Set the m value in the flash
 */
 void set_m_flash(int m)
 {
-    fm.m = m;
+    fm.m = m > 255 ? 255 : m;
+    fm.m_minutes = m;
 } // end
 
 
@@ -108,6 +226,15 @@ void setup_flash_mem_defaults()
     fm.m = 1;
     fm.num = 1;
     strcpy(fm.name, DEFAULT_NAME_SENSOR); 
+    fm.temp_rom_num = 0;
+    fm.gps_refix = GPS_REFIX_DEFAULT;
+    fm.m_minutes = fm.m;
+    fm.power_profile = 0;
+    fm.policy_on = 0;
+    set_event_defaults();
+    fm.sd_csv = 0;
+    for(size_t k = 0; k < NUM_CAL_CHANNELS; k++) calibration_clear(fm.cal[k]);
+    for(size_t k = 0; k < NUM_TRANSFER_CONSTANTS; k++) set_constant(k, "", 0);
 } // end
 
 
@@ -124,6 +251,22 @@ void read_from_flash()
     }
     else
     {
+        if (fm.temp_rom_num > MAX_TEMP_SENSORS) fm.temp_rom_num = 0;   // flash written before the probes were bound
+        if (fm.gps_refix == 0 || fm.gps_refix == 0xFF) fm.gps_refix = GPS_REFIX_DEFAULT;
+        if (fm.m_minutes == 0 || fm.m_minutes > MAX_NUM_MINUTES_RTC) fm.m_minutes = fm.m;   // flash written before m_minutes
+        if (fm.power_profile > 1) fm.power_profile = 0;
+        if (fm.policy_on > 1) fm.policy_on = 0;
+        if (fm.event_on > 1) set_event_defaults();     // flash written before the event detection
+        if (fm.sd_csv > 1) fm.sd_csv = 0;
+        for(size_t k = 0; k < NUM_TRANSFER_CONSTANTS; k++)
+        {
+            if (fm.const_name[k][MAX_CONSTANT_NAME - 1] != '\0') set_constant(k, "", 0);    // flash written before the constants
+        }
+        for(size_t k = 0; k < NUM_CAL_CHANNELS; k++)
+        {
+            if (!calibration_valid(fm.cal[k])) calibration_clear(fm.cal[k]);     // flash written before the calibrations
+        }
+
         cell.setCachedNetworkInfo(String(fm.apn_addr), String(fm.server_addr), fm.server_port);
     }
 } // end
@@ -171,7 +314,7 @@ void print_flash()
 {
     printSerial("COEFFICIENTS:");
     printSerial("valid: " + String(fm.valid)); 
-    printSerial("m: " + String(fm.m));
+    printSerial("m: " + String(fm.m_minutes));
     printSerial("alarm_on: " + String(fm.alarm_on));
     printSerial("name: " + String(fm.name));
     printSerial("key: " + String(fm.key));                        // required to communicate with the server
@@ -181,6 +324,12 @@ void print_flash()
     printSerial("Server Port: " + String(fm.server_port));        // required by the cellular modem
     printSerial("send_cell: " + String(fm.send_cell));               // required by the cellular modem
     printSerial("powersave: " + String(fm.shutdown_rails_after_rtc_sample));
+    printSerial("temp_probes: " + String(fm.temp_rom_num));
+    printSerial("gps_refix: " + String(fm.gps_refix));
+    printSerial("power_profile: " + String(fm.power_profile));
+    printSerial("policy_on: " + String(fm.policy_on));
+    printSerial("event_on: " + String(fm.event_on));
+    printSerial("sd_format: " + String(fm.sd_csv ? "csv" : "json"));
     printSerial("DONE");
 } // end
 
@@ -194,7 +343,7 @@ void read_flash_and_setup()
     if (fm.alarm_on)
     {
         // For some reason, we need to STORE_MEM again for this to work properly
-        set_alarm_minutely(fm.m, STORE_MEM);
+        set_alarm_minutely(fm.m_minutes, STORE_MEM);
     }
     else
     {
@@ -213,6 +362,77 @@ bool get_send_cell()
 
 
 
+bool get_power_profile_on()
+{
+    return fm.power_profile ? true : false;
+} // end
+
+
+bool get_policy_on()
+{
+    return fm.policy_on ? true : false;
+} // end
+
+
+bool get_event_on()
+{
+    return fm.event_on ? true : false;
+} // end
+
+
+/*
+Returns true if the records are stored on the SD card as JSON (false if CSV)
+*/
+bool get_sd_json()
+{
+    return fm.sd_csv ? false : true;
+} // end
+
+
+int get_event_m()
+{
+    return fm.event_m;
+} // end
+
+
+int get_event_cooldown()
+{
+    return fm.event_cooldown;
+} // end
+
+
+const struct calibration &get_calibration(size_t ch)
+{
+    if (ch >= NUM_CAL_CHANNELS) ch = 0;
+    return fm.cal[ch];
+} // end
+
+
+const char *get_constant_name(size_t k)
+{
+    if (k >= NUM_TRANSFER_CONSTANTS) return "";
+    return fm.const_name[k];
+} // end
+
+
+// Values of the constants of the transfer expressions (indexed by the bytecode)
+const float *get_constant_values()
+{
+    return fm.const_value;
+} // end
+
+
+void get_event_limits(size_t ch, float &hi, float &rate, float &k, float &h)
+{
+    hi = rate = k = h = 0;
+    if (ch >= NUM_EVENT_CHANNELS) return;
+    hi = fm.event_hi[ch];
+    rate = fm.event_rate[ch];
+    k = fm.event_k[ch];
+    h = fm.event_h[ch];
+} // end
+
+
 bool get_shutdown_rails()
 {
     return fm.shutdown_rails_after_rtc_sample ? true: false;
@@ -221,7 +441,7 @@ bool get_shutdown_rails()
 
 int get_m()
 {
-    return fm.m;
+    return fm.m_minutes;
 } // end
 
 
@@ -255,6 +475,54 @@ int get_num()
 } // end
 
 
+int get_gps_refix()
+{
+    return fm.gps_refix;
+} // end
+
+
+/*
+Functions to store the ROM addresses of the temperature probes
+so that each probe keeps the same name {t0, t1,...} across restarts
+*/
+size_t get_temp_rom_num()
+{
+    return fm.temp_rom_num;
+} // end
+
+
+void set_temp_rom_num(size_t n)
+{
+    if (n > MAX_TEMP_SENSORS) n = MAX_TEMP_SENSORS;
+    fm.temp_rom_num = n;
+} // end
+
+
+void get_temp_rom(size_t k, uint8_t *addr)
+{
+    memcpy(addr, fm.temp_rom[k], 8);
+} // end
+
+
+void set_temp_rom(size_t k, const uint8_t *addr)
+{
+    memcpy(fm.temp_rom[k], addr, 8);
+} // end
+
+
+/*
+Write the bindings of the temperature probes to flash (with the other variables) and read them back.
+Returns false if the bindings in flash do not match.
+*/
+bool save_temp_rom()
+{
+    write_to_flash();
+    FlashData check = flash_store.read();
+    return check.valid == fm.valid && check.temp_rom_num == fm.temp_rom_num &&
+        memcmp(check.temp_rom, fm.temp_rom, sizeof(fm.temp_rom)) == 0;
+} // end
+
+
 void get_apn_server_port(String &apn, String &server, unsigned int &port)
 {
     apn = String(fm.apn_addr);
@@ -3,6 +3,8 @@
 #include "constants.h"
 #include "data_storage.h"
 #include "main_local.h"
+#include "gps_manager.h"
+#include "sleep_local.h"
 
 struct gpio_data
 {
@@ -19,6 +21,7 @@ void turn_on_5V_ext()
 {
   digitalWrite(EXT_5V_PIN, HIGH);
   gd.is_ext_on = true;
+  gps_power_event(true);
 } // end 
 
 
@@ -29,6 +32,7 @@ void turn_off_5V_ext()
 {
   digitalWrite(EXT_5V_PIN, LOW);
   gd.is_ext_on = false;
+  gps_power_event(false);
 } // end 
 
 
@@ -89,6 +93,7 @@ void off_sd()
 void attach_alarm_interrupt()
 {
   attachInterrupt(digitalPinToInterrupt(RTC_INT_PIN), handleRTC, FALLING);
+  sleep_configure_wake_pin(RTC_INT_PIN);    // wake from STANDBY on the alarm
 } // end
 
 
@@ -99,6 +104,15 @@ void detach_alarm_interrupt()
 } // end
 
 
+/*
+Returns true if the RTC alarm has fired and has not been handled by the main loop
+*/
+bool rtc_event_pending()
+{
+  return gd.rtc_flag;
+} // end
+
+
 /*
 Set the m as required for the alarm
 */
@@ -109,13 +123,23 @@ void set_m(int m)
 
 
 /*
-Check whether we need to take the sample or not
+Obtain the m used for the alarm
+*/
+int get_m_alarm()
+{
+  return gd.m;
+} // end 
+
+
+/*
+Check whether we need to take the sample or not.
+The alarm is set for the time of the sample, so the sample is taken when the alarm has fired.
 */
 void check_take_sample()
 {
-  int day, month, year, hour, minute, second, dayNum;
-  get_time_rtc(day, month, year, hour, minute, second, dayNum);
-  if (minute % gd.m == 0) take_sample();
+  if (!alarm_fired_rtc()) return;
+  set_next_alarm_rtc();     // set the alarm for the next sample (this clears the alarm)
+  take_sample();
 } // end
 
 
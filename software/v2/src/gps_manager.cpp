@@ -0,0 +1,293 @@
+#include <Arduino.h>
+#include "gps_manager.h"
+#include "GPS.h"
+#include "gpio.h"
+#include "flash_mem.h"
+#include "experiment.h"
+#include "main_local.h"
+#include "constants.h"
+#include "time_helper.h"
+
+/*
+GPS manager to reduce the time that the GPS is powered for each sample.
+
+1. The position is only obtained every gps_refix samples (set-gps-refix), since a moored buoy does not move.
+   The last good fix is used for the other samples.
+2. The wait for a fix ends as soon as a fix meets GPS_MIN_SATS and GPS_MAX_HDOP.
+3. If the fix is not obtained during the sample, the 5V rail is kept on after the sample for up to GPS_MAX_HOLD
+   and is turned off as soon as the fix is obtained.
+4. If the 5V rail is kept on between samples (powersave off), the receiver is put into backup mode so that the
+   next fix is a hot start.
+5. The time to first fix (TTFF) and the time that the GPS is on are logged with each sample.
+
+NOTE that the receiver can only do a hot start after the 5V rail is turned off if the backup supply of the
+receiver is kept powered.
+*/
+
+extern GPS gps;
+
+static struct gps_manager_data
+{
+  bool powered;                 // true if the 5V rail powering the GPS is on
+  bool standby;                 // true if the receiver is in backup mode with the rail on
+  bool required;                // true if a fix is required for the current sample
+  bool hold;                    // true if the rail is kept on after the sample to obtain a fix
+  bool ttff_done;               // true if the TTFF has been measured since the GPS was turned on
+  bool have_fix;                // true if last_fix holds a fix that meets the thresholds
+  int samples_since_fix;        // samples since the last fix
+  long ttff;                    // last TTFF (ms) or -1 if there is no TTFF
+  unsigned long on_ms;          // millis() when the GPS was turned on or woken
+  unsigned long seg_ms;         // millis() at the start of the on-time segment
+  unsigned long on_total;       // ms that the GPS has been on since the last sample was logged
+  unsigned long hold_ms;        // millis() when the hold started
+  struct last_gps_fix last_fix; // last fix that met the thresholds
+} gm;
+
+
+// Returns true if the GPS is drawing full power
+static bool gps_awake()
+{
+  return gm.powered && !gm.standby;
+} // end
+
+
+static void gps_awake_start()
+{
+  gm.on_ms = millis();
+  gm.seg_ms = gm.on_ms;
+  gm.ttff_done = false;
+} // end
+
+
+static void gps_awake_stop()
+{
+  if (gps_awake()) gm.on_total += millis() - gm.seg_ms;
+} // end
+
+
+// Store a fix that meets the thresholds
+static void gps_note_fix(const struct last_gps_fix &f)
+{
+  if (!gm.ttff_done)
+  {
+    gm.ttff = (long)(millis() - gm.on_ms);
+    gm.ttff_done = true;
+  }
+  gm.last_fix = f;
+  gm.have_fix = true;
+  gm.samples_since_fix = 0;
+} // end
+
+
+// Put the receiver into backup mode with the rail on
+static void gps_standby()
+{
+  if (!gps_awake()) return;
+  gps_awake_stop();
+  gps.standby();
+  gm.standby = true;
+} // end
+
+
+// End the hold after a fix or a timeout
+static void gps_release_hold()
+{
+  gm.hold = false;
+  if (get_shutdown_rails()) turn_off_5V_ext();
+  else gps_standby();
+} // end
+
+
+void setup_gps_manager()
+{
+  gm.powered = check_is_ext_on();
+  gm.standby = false;
+  gm.required = true;
+  gm.hold = false;
+  gm.have_fix = false;
+  gm.samples_since_fix = 0;
+  gm.ttff = -1;
+  gm.on_total = 0;
+  gps_awake_start();
+} // end
+
+
+/*
+Called when the 5V rail is turned on or off
+*/
+void gps_power_event(bool on)
+{
+  if (on && !gm.powered)
+  {
+    gps.reset_epoch();
+    gm.powered = true;
+    gm.standby = false;
+    gps_awake_start();
+  }
+  else if (!on && gm.powered)
+  {
+    gps_awake_stop();
+    gm.powered = false;
+    gm.standby = false;
+    gm.hold = false;
+  }
+} // end
+
+
+/*
+Returns true if the fix meets the thresholds
+*/
+bool gps_fix_acceptable(const struct last_gps_fix &f)
+{
+  if (!f.good) return false;
+  if (f.satellites < GPS_MIN_SATS) return false;
+  if (isnan(f.hdop) || f.hdop > GPS_MAX_HDOP) return false;
+  return true;
+} // end
+
+
+/*
+Call this function at the start of the sample after the 5V rail is turned on
+*/
+void gps_begin_sample()
+{
+  gm.samples_since_fix++;
+  gm.required = !gm.have_fix || gm.samples_since_fix >= get_gps_refix();
+  gm.hold = false;
+  if (gm.required && gm.powered && gm.standby)
+  {
+    gps.wake();
+    gm.standby = false;
+    gps_awake_start();
+  }
+} // end
+
+
+/*
+Obtain the fix for the sample.
+If a fix is required, this waits up to GPS_FIX_WAIT and returns as soon as the fix meets the thresholds.
+Otherwise the last fix is returned and reused is set to true.
+*/
+void gps_get_fix(struct last_gps_fix &f, bool &reused)
+{
+  unsigned long start = millis();
+  while (!gps_poll_fix(f, reused))
+  {
+    if (millis() - start >= GPS_FIX_WAIT)
+    {
+      f.good = false;
+      return;
+    }
+    delay(1);
+  }
+} // end
+
+
+/*
+Poll for the fix for the sample without waiting.
+Returns true if the fix meets the thresholds or if the last fix is reused.
+*/
+bool gps_poll_fix(struct last_gps_fix &f, bool &reused)
+{
+  if (!gm.required)
+  {
+    f = gm.last_fix;
+    reused = true;
+    return true;
+  }
+  reused = false;
+  gps.obtain_gps_data(&f);
+  if (!gps_fix_acceptable(f)) return false;
+  gps_note_fix(f);
+  return true;
+} // end
+
+
+/*
+Call this function at the end of the sample
+*/
+void gps_end_sample(bool shutdown_rails)
+{
+  bool need_fix = gm.required && gm.samples_since_fix != 0;
+  if (need_fix)
+  {
+    // keep the GPS on to obtain the fix
+    #ifdef DEBUG_GPS
+      printSerial("Keeping the GPS on to obtain a fix...");
+    #endif
+    gm.hold = true;
+    gm.hold_ms = millis();
+    return;
+  }
+  if (shutdown_rails)
+  {
+    #ifdef DEBUG_GPS
+      printSerial("Turning off the 5V rail...");
+    #endif
+    turn_off_5V_ext();
+  }
+  else gps_standby();
+} // end
+
+
+/*
+Call this function from the main loop to end the hold when the fix is obtained
+*/
+void gps_manager_poll()
+{
+  if (!gm.hold || is_experiment_running()) return;
+  struct last_gps_fix f;
+  gps.obtain_gps_data(&f);
+  if (gps_fix_acceptable(f))
+  {
+    gps_note_fix(f);
+    gps_release_hold();
+  }
+  else if (millis() - gm.hold_ms >= GPS_MAX_HOLD)
+  {
+    gps_release_hold();
+  }
+} // end
+
+
+/*
+Returns true if the GPS is kept on after the sample to obtain a fix
+*/
+bool gps_is_holding()
+{
+  return gm.hold;
+} // end
+
+
+/*
+Returns the UTC time of the fix as ms since 1970-01-01 00:00:00 or 0 if the fix does not have a date
+*/
+uint64_t gps_fix_epoch_ms(const struct last_gps_fix &f)
+{
+  if (f.day < 1 || f.month < 1) return 0;
+  int year = f.year < 100 ? f.year + 2000 : f.year;   // RMC has a two digit year
+  uint32_t t = epoch_from_time(f.day, f.month, year, f.hours, f.minutes, f.seconds);
+  return (uint64_t)t * 1000 + f.microseconds / 1000;
+} // end
+
+
+/*
+Returns the last TTFF (ms) or -1 if the TTFF has not been measured
+*/
+long gps_get_ttff()
+{
+  return gm.ttff;
+} // end
+
+
+/*
+Returns the time (ms) that the GPS has been on since the last call
+*/
+unsigned long gps_take_on_time()
+{
+  gps_awake_stop();
+  unsigned long total = gm.on_total;
+  gm.on_total = 0;
+  gm.seg_ms = millis();
+  return total;
+} // end
@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include "heap_check.h"
+#include "constants.h"
+#include "main_local.h"
+
+/*
+Check that the sample does not use the heap.
+
+Build with the mkrzero_heap environment (platformio.ini), which defines DEBUG_HEAP and wraps malloc(), calloc()
+and realloc() with the linker.  Each call between heap_check_begin() and heap_check_end() is counted, and the
+count is printed at the end of the sample.  The sample should not allocate (populate_data_* -> format -> store
+-> send), since allocations every few minutes for weeks fragment the 32 KB of RAM.  The logs of the changes of
+state during the sample are written with sd_write_log() for the same reason.
+
+The native environment also defines DEBUG_HEAP, and test/test_heap runs the sample task on the host with
+fakes of the sensors, the SD card and the modem, and fails if the sample allocates.
+
+Without DEBUG_HEAP, the functions do nothing.
+*/
+
+static struct heap_check_data
+{
+    bool armed;             // true if the allocations are being counted
+    size_t count;           // allocations since heap_check_begin()
+} hcd;
+
+
+#ifdef DEBUG_HEAP
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t num, size_t size);
+    void *__real_realloc(void *p, size_t size);
+
+    void *__wrap_malloc(size_t size)
+    {
+        if (hcd.armed) hcd.count++;
+        return __real_malloc(size);
+    } // end
+
+    void *__wrap_calloc(size_t num, size_t size)
+    {
+        if (hcd.armed) hcd.count++;
+        return __real_calloc(num, size);
+    } // end
+
+    void *__wrap_realloc(void *p, size_t size)
+    {
+        if (hcd.armed) hcd.count++;
+        return __real_realloc(p, size);
+    } // end
+}
+#endif
+
+
+/*
+Start counting the allocations
+*/
+void heap_check_begin()
+{
+    hcd.count = 0;
+    hcd.armed = true;
+} // end
+
+
+/*
+Stop counting and print the number of allocations (DEBUG_HEAP only).
+Returns the number of allocations.
+*/
+size_t heap_check_end()
+{
+    hcd.armed = false;
+    #ifdef DEBUG_HEAP
+        char line[48];
+        snprintf(line, sizeof(line), "HEAP: %u allocations in the sample", (unsigned int)hcd.count);
+        printSerial(line);
+    #endif
+    return hcd.count;
+} // end
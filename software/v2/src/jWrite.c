@@ -133,6 +133,17 @@ void modp_itoa10u(int32_t value, char* str)
 } // end
 
 
+// unsigned 64-bit integer (newlib-nano printf does not support %llu)
+void modp_itoa10u64(uint64_t value, char* str)
+{
+    char buf[21];
+    int n = 0;
+    do buf[n++] = (char)('0' + (value % 10)); while (value /= 10);
+    while (n > 0) *str++ = buf[--n];
+    *str = '\0';
+} // end
+
+
 //------------------------------------------
 // Object insert functions
 //
@@ -166,6 +177,12 @@ void jwObj_uint( JWC_DECL char *key, uint32_t value )
     jwObj_raw( JWC_PARAM key, JWC(tmpbuf) );
 }
 
+void jwObj_uint64( JWC_DECL char *key, uint64_t value )
+{
+    modp_itoa10u64( value, JWC(tmpbuf) );
+    jwObj_raw( JWC_PARAM key, JWC(tmpbuf) );
+}
+
 void jwObj_double( JWC_DECL char *key, double value )
 {
 	modp_dtoa2( value, JWC(tmpbuf), 6 );
@@ -593,7 +610,7 @@ void modp_dtoa2(double value, char* str, int prec)
     *wstr='\0';
     strreverse(str, wstr-1);
 #else
-    sprintf(str, "%0.10lf", value);
+    sprintf(str, "%.*f", prec, value);
 #endif
 
 }
@@ -17,35 +17,34 @@ class MyWaterWatcherOptions : public WaterWatcherOptions
         //-------------------------------------------------
         // TRANSFER FUNCTION OUTPUTS
         // OVERRIDE THESE FUNCTIONS IF REQUIRED
+        // (the defaults apply the calibrations stored in flash with set-transfer)
         //-------------------------------------------------
-        float get_a0_out()
+        float get_a0_out() override
         {
-            float out = get_a0_raw(); 
-            return out;
+            return WaterWatcherOptions::get_a0_out();
         } // end
 
-        float get_a1_out()
+        float get_a1_out() override
         {
-            float out = get_a1_raw(); 
-            return out;
+            return WaterWatcherOptions::get_a1_out();
         } // end
             
-        float get_a2_out()
+        float get_a2_out() override
         {
-            float out = get_a2_raw(); 
-            return out;
+            return WaterWatcherOptions::get_a2_out();
         } // end
         
-        float get_temp0_out()
+        float get_temp0_out() override
         {
-            float out = get_temp0_raw(); 
-            return out;
+            return WaterWatcherOptions::get_temp0_out();
         } // end
 
 }; // end
 
 // Create an instance of the WaterWatcher object
-WaterWatcher ww;
+// The transfer functions of MyWaterWatcherOptions are inlined into the sample.
+// Use WaterWatcher<> to call the transfer functions through the virtual table instead.
+WaterWatcher<MyWaterWatcherOptions> ww;
 
 // Create an instance of the options object
 MyWaterWatcherOptions opt;
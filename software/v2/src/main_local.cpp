@@ -15,6 +15,13 @@
 #include "cellular.h"
 #include "experiment.h"
 #include "WaterWatcherOptions.h"
+#include "gps_manager.h"
+#include "sleep_local.h"
+#include "power_profile.h"
+#include "power_policy.h"
+#include "uplink.h"
+#include "event_detect.h"
+#include "arena.h"
 
 /*
 WaterWatcher Code
@@ -64,12 +71,14 @@ Then do a power cycle.
 
 //--------------------------------------------
 WDTZero watchdog;
+SimpleTaskScheduler scheduler;
 //--------------------------------------------
 
 static struct main_data
 {
   int serial_port;              // sets the serial port to print
   WaterWatcherOptions *opt;     // options used to set up how the WW operates
+  transfer_outputs_fn transfer; // applies the transfer functions of the options to the sample
 } md;
 
 
@@ -82,6 +91,15 @@ WaterWatcherOptions *get_options()
 } // end
 
 
+/*
+Function to obtain the transfer functions of the options (see WaterWatcher.h)
+*/
+transfer_outputs_fn get_transfer_outputs()
+{
+  return md.transfer;
+} // end
+
+
 /*
 Set the serial port that needs to be printed
 */
@@ -93,7 +111,14 @@ void set_serial_main(int port)
 /*
 Function to print to the serial port
 */
-void printSerial(String s)
+void printSerial(const String &s)
+{
+  Serial.println(s);
+} // end
+
+
+// Print the text without constructing a String (does not use the heap)
+void printSerial(const char *s)
 {
   Serial.println(s);
 } // end
@@ -102,7 +127,13 @@ void printSerial(String s)
 /*
 Print to the serial without line endings
 */ 
-void printSerialWithoutLineEnding(String s)
+void printSerialWithoutLineEnding(const String &s)
+{
+  Serial.print(s);  // default to USB
+} // end
+
+
+void printSerialWithoutLineEnding(const char *s)
 {
   Serial.print(s);  // default to USB
 } // end
@@ -141,17 +172,22 @@ void shutdown_func()
 /*
  * Setup function 
  */
-void setup_local(WaterWatcherOptions *opt) 
+void setup_local(WaterWatcherOptions *opt, transfer_outputs_fn transfer) 
 {
+  // fill the free RAM so that the depth of the stack can be checked (mem)
+  setup_arena();
+
   // USB serial port as the default
   md.serial_port = USB_STREAM;
 
   // set the options
   md.opt = opt;
+  md.transfer = transfer;
 
   // setup the watchdog
   watchdog.attachShutdown(shutdown_func);
   watchdog.setup(WDT_SOFTCYCLE16M); // 2 minute watchdog shutdown
+  setup_sleep();                    // clocks required to wake from STANDBY
 
   // Setup I2C (required before using any I2C libraries)
   Wire.begin();
@@ -167,6 +203,11 @@ void setup_local(WaterWatcherOptions *opt)
   
   // rest of the setups
   setup_gpio();
+  setup_gps_manager();
+  setup_power_profile();
+  setup_power_policy();
+  setup_uplink();
+  setup_event_detect();
   setup_commands();
   set_rtc_defaults();
   read_flash_and_setup();
@@ -188,9 +229,22 @@ void setup_local(WaterWatcherOptions *opt)
 void loop_local()
 {
   watchdog.clear();
+  gps_feed();
+  gps_manager_poll();
   check_rtc();
   poll_cmd();
-  timer_update();
+  scheduler.run();
+  sleep_local();    // sleep until the next event
 
 } // end 
 
+
+/*
+  The core calls yield() while waiting in delay(), so the GPS bytes are also parsed during the
+  blocking delays elsewhere in the code.  This keeps the serial ring buffer from overflowing.
+*/
+extern "C" void yield()
+{
+  gps_feed();
+} // end
+
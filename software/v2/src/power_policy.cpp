@@ -0,0 +1,148 @@
+#include <Arduino.h>
+#include "power_policy.h"
+#include "constants.h"
+#include "flash_mem.h"
+#include "data_storage.h"
+#include "sd_storage.h"
+#include "main_local.h"
+#include "fixed_format.h"
+
+/*
+Battery-aware sampling and transmission policy (policy-on).
+
+The battery state from each sample selects a tier.  The tier scales the sampling interval m and the number of
+records that are sent each time the modem is woken (the uplink batch):
+
+TIER        INTERVAL    BATCH
+charging    m/2         1
+normal      m           1
+low         2m          4
+critical    4m          8
+
+The battery is low or critical when the voltage or the remaining capacity (if known) is below the thresholds
+in constants.h.  The tier only goes back up when the voltage and capacity are above the thresholds plus the
+hysteresis, so that the tier does not change at every sample.  When the charger reports a fault, the battery
+is not charging and the tier is selected from the voltage and capacity.
+
+Each change of the tier is printed and logged to <name>.log on the SD card.
+*/
+
+struct policy_tier_info
+{
+    const char *name;
+    uint8_t num;            // the interval is scaled by num/den
+    uint8_t den;
+    uint8_t batch;          // records sent each time the modem is woken
+}; // end
+
+static const policy_tier_info TIERS[NUM_POLICY_TIERS] =
+{
+    {"charging", 1, 2, 1},
+    {"normal", 1, 1, 1},
+    {"low", 2, 1, 4},
+    {"critical", 4, 1, 8}
+};
+
+static struct power_policy_data
+{
+    policy_tier tier;
+} pd;
+
+
+// Returns true if the value is below the limit (with hysteresis if the value was below the limit)
+static bool policy_below(float v, float limit, float hyst, bool was_below)
+{
+    if (was_below) return v < limit + hyst;
+    return v < limit;
+} // end
+
+
+// Log the change of the tier
+static void policy_log(float bvoltage, float bcapacity, bool charging, bool fault)
+{
+    char v[FIXED_FORMAT_SIZ];
+    char c[FIXED_FORMAT_SIZ];
+    format_fixed(bvoltage, 3, v);
+    format_fixed(bcapacity, 3, c);
+    char line[MAX_LOG_LINE_SIZ];
+    snprintf(line, sizeof(line), "policy=%s bvoltage=%s bcapacity=%s charging=%d fault=%d m=%d batch=%u",
+        TIERS[pd.tier].name, v, c, charging, fault, power_policy_interval(get_m()), (unsigned int)get_policy_batch());
+    sd_write_log(line);
+} // end
+
+
+void setup_power_policy()
+{
+    pd.tier = POLICY_NORMAL;
+} // end
+
+
+/*
+Select the tier from the battery state of the sample
+*/
+void power_policy_update(float bvoltage, float bcapacity, bool charging, bool fault)
+{
+    if (!get_policy_on())
+    {
+        pd.tier = POLICY_NORMAL;
+        return;
+    }
+
+    policy_tier tier = pd.tier;
+    if (charging && !fault) tier = POLICY_CHARGING;
+    else if (!isnan(bvoltage))
+    {
+        bool has_cap = !isnan(bcapacity) && bcapacity > 0;  // capacity is zero if the battery monitor is not calibrated
+        bool critical = policy_below(bvoltage, POLICY_V_CRITICAL, POLICY_V_HYST, pd.tier == POLICY_CRITICAL);
+        if (has_cap) critical = critical || policy_below(bcapacity, POLICY_CAP_CRITICAL, POLICY_CAP_HYST, pd.tier == POLICY_CRITICAL);
+        bool low = policy_below(bvoltage, POLICY_V_LOW, POLICY_V_HYST, pd.tier >= POLICY_LOW);
+        if (has_cap) low = low || policy_below(bcapacity, POLICY_CAP_LOW, POLICY_CAP_HYST, pd.tier >= POLICY_LOW);
+        if (critical) tier = POLICY_CRITICAL;
+        else if (low) tier = POLICY_LOW;
+        else tier = POLICY_NORMAL;
+    }
+    if (tier == pd.tier) return;
+
+    pd.tier = tier;
+    policy_log(bvoltage, bcapacity, charging, fault);
+    if (get_alarm_on()) set_next_alarm_rtc();   // use the new interval from the next sample
+} // end
+
+
+int get_policy_tier()
+{
+    return pd.tier;
+} // end
+
+
+/*
+Returns the interval (minutes) scaled by the tier
+*/
+int power_policy_interval(int m)
+{
+    long scaled = (long)m * TIERS[pd.tier].num / TIERS[pd.tier].den;
+    if (scaled < 1) scaled = 1;
+    if (scaled > MAX_NUM_MINUTES_RTC) scaled = MAX_NUM_MINUTES_RTC;
+    return scaled;
+} // end
+
+
+/*
+Returns the number of records to send each time the modem is woken
+*/
+size_t get_policy_batch()
+{
+    return TIERS[pd.tier].batch;
+} // end
+
+
+/*
+CLI: print-policy
+*/
+void print_power_policy()
+{
+    printSerial("policy_on: " + String(get_policy_on()));
+    printSerial("tier: " + String(TIERS[pd.tier].name));
+    printSerial("m: " + String(power_policy_interval(get_m())));
+    printSerial("batch: " + String(get_policy_batch()));
+} // end
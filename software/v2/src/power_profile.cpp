@@ -0,0 +1,172 @@
+#include <Arduino.h>
+#include "power_profile.h"
+#include "data_storage.h"
+#include "fixed_format.h"
+#include "flash_mem.h"
+#include "main_local.h"
+
+/*
+Power profile of the sample cycle (power-profile-on).
+
+The current from the DS2438 battery monitor is read at each boundary between the phases of the sample,
+and the charge of each phase is integrated with the trapezoidal rule.  The sleep phase is integrated
+from the current at the end of the sample and at the start of the next sample, with the time from the RTC,
+since millis() does not advance in STANDBY.
+
+The profile of a cycle is complete at the start of the next sample, so the profile logged with each sample
+is the profile of the previous cycle (including the sleep after it).  The charge has the same sign as bcurrent.
+*/
+
+const char *const PP_PHASE_NAMES[NUM_PP_PHASES] = {"rail", "sensors", "gps", "sd", "modem", "send", "sleep"};
+
+static const float MS_PER_HOUR = 3600000.0f;
+static const float S_PER_HOUR = 3600.0f;
+
+static struct power_profile_data
+{
+    bool active;                        // true during the sample
+    bool have_end;                      // true if the current at the end of the last sample is known
+    bool valid;                         // true if the last profile is complete
+    power_phase phase;                  // current phase
+    float current;                      // current (A) at the start of the current phase
+    bool current_good;                  // true if current could be read
+    unsigned long ms;                   // millis() at the start of the current phase
+    float end_current;                  // current (A) at the end of the last sample
+    uint32_t end_epoch;                 // RTC time (s) at the end of the last sample
+    float mah[NUM_PP_PHASES];           // charge of each phase of the cycle being measured
+    uint32_t phase_ms[NUM_PP_PHASES];   // duration of each phase of the cycle being measured
+    float last_mah[NUM_PP_PHASES];      // charge of each phase of the last complete cycle
+    uint32_t last_ms[NUM_PP_PHASES];    // duration of each phase of the last complete cycle
+} ppd;
+
+
+static void pp_clear()
+{
+    for(size_t k = 0; k < NUM_PP_PHASES; k++)
+    {
+        ppd.mah[k] = 0;
+        ppd.phase_ms[k] = 0;
+    }
+} // end
+
+
+// Close the current phase at the boundary
+static void pp_boundary()
+{
+    float current;
+    bool good = obtain_bmon_current(current);
+    unsigned long now = millis();
+    unsigned long dt = now - ppd.ms;
+    ppd.phase_ms[ppd.phase] += dt;
+    if (good && ppd.current_good) ppd.mah[ppd.phase] += 0.5f * (ppd.current + current) * 1000.0f * dt / MS_PER_HOUR;
+    ppd.current = current;
+    ppd.current_good = good;
+    ppd.ms = now;
+} // end
+
+
+void setup_power_profile()
+{
+    ppd.active = false;
+    ppd.have_end = false;
+    ppd.valid = false;
+    pp_clear();
+} // end
+
+
+/*
+Call this function at the start of the sample
+*/
+void power_profile_begin()
+{
+    ppd.active = false;
+    if (!get_power_profile_on())
+    {
+        setup_power_profile();
+        return;
+    }
+    ppd.current_good = obtain_bmon_current(ppd.current);
+    ppd.ms = millis();
+
+    // the sleep after the last sample completes the last cycle
+    if (ppd.have_end)
+    {
+        uint32_t now = get_epoch_rtc();
+        uint32_t dt = now >= ppd.end_epoch ? now - ppd.end_epoch : 0;
+        ppd.phase_ms[PP_SLEEP] = dt * 1000UL;
+        if (ppd.current_good) ppd.mah[PP_SLEEP] = 0.5f * (ppd.end_current + ppd.current) * 1000.0f * dt / S_PER_HOUR;
+        for(size_t k = 0; k < NUM_PP_PHASES; k++)
+        {
+            ppd.last_mah[k] = ppd.mah[k];
+            ppd.last_ms[k] = ppd.phase_ms[k];
+        }
+        ppd.valid = true;
+    }
+    pp_clear();
+    ppd.phase = PP_RAIL;
+    ppd.active = true;
+} // end
+
+
+/*
+Call this function at the start of each phase.
+Phases that are not in order are ignored, since the modem task runs at the same time as the sample.
+*/
+void power_profile_mark(power_phase phase)
+{
+    if (!ppd.active || phase <= ppd.phase || phase >= PP_SLEEP) return;
+    pp_boundary();
+    ppd.phase = phase;
+} // end
+
+
+/*
+Call this function at the end of the sample
+*/
+void power_profile_end()
+{
+    if (!ppd.active) return;
+    pp_boundary();
+    ppd.active = false;
+    ppd.have_end = ppd.current_good;
+    ppd.end_current = ppd.current;
+    ppd.end_epoch = get_epoch_rtc();
+} // end
+
+
+/*
+Obtain the profile of the last complete cycle.
+Returns false if there is no complete cycle.
+*/
+bool get_power_profile(float *mah, uint32_t *ms)
+{
+    if (!ppd.valid) return false;
+    for(size_t k = 0; k < NUM_PP_PHASES; k++)
+    {
+        mah[k] = ppd.last_mah[k];
+        ms[k] = ppd.last_ms[k];
+    }
+    return true;
+} // end
+
+
+/*
+CLI: print-power-profile
+*/
+void print_power_profile()
+{
+    if (!ppd.valid)
+    {
+        printSerial("No power profile");
+        return;
+    }
+    printSerial("PHASE/CHARGE(mAh)/TIME(ms)");
+    for(size_t k = 0; k < NUM_PP_PHASES; k++)
+    {
+        char num[FIXED_FORMAT_SIZ];
+        format_fixed(ppd.last_mah[k], 6, num);
+        char line[64];
+        snprintf(line, sizeof(line), "%s/%s/%lu", PP_PHASE_NAMES[k], num, (unsigned long)ppd.last_ms[k]);
+        printSerial(line);
+    }
+} // end
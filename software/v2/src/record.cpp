@@ -0,0 +1,551 @@
+#include <Arduino.h>
+#include <string.h>
+#include "record.h"
+#include "constants.h"
+#include "flash_mem.h"
+#include "main_local.h"
+#include "power_profile.h"
+#include "jWrite.h"
+#include "fixed_format.h"
+#include "WaterWatcherOptions.h"
+
+/*
+Serializers of the record.
+
+The fields of the record are described once in RECORD_FIELDS (and RECORD_ARRAYS for the members that are arrays).
+The serializer loop is a template over the writer, so that the JSON, CSV and binary formats are generated from
+the same table.  The writers stream the record into a RecordSink (see record_sink.h) in chunks of
+RECORD_WINDOW_SIZ bytes, so the record is written to the SD card or the modem without a buffer of the whole record.
+
+JSON:   the fields that are enabled for the record (NaN and inf are replaced by NAN_VALUE_REPLACE).
+        The token, number and name of the sensor are written first for the server.
+CSV:    all of the fields in the order of the table (a field that is not enabled, NaN or inf is empty),
+        so that the columns match the header from record_format_csv_header().
+BINARY: version (1 byte), groups (1 byte), num_temp_sensors (1 byte) and then the fields that are enabled
+        in the order of the table (little endian, bool as 1 byte, string as the length (1 byte) and characters).
+*/
+
+static constexpr record_field RECORD_FIELDS[] =
+{
+    RECORD_FIELD("a0_voltage", a0_voltage, 4, RG_A0),
+    RECORD_FIELD("a0_out", a0_out, 4, RG_A0),
+    RECORD_FIELD("a1_voltage", a1_voltage, 4, RG_A1),
+    RECORD_FIELD("a1_out", a1_out, 4, RG_A1),
+    RECORD_FIELD("a2_voltage", a2_voltage, 4, RG_A2),
+    RECORD_FIELD("a2_out", a2_out, 4, RG_A2),
+    RECORD_FIELD("temp0", water_temperature, 3, RG_TEMP),
+    RECORD_FIELD("temp0_out", water_temperature_out, 3, RG_TEMP),
+
+    RECORD_FIELD("serial_number", serial_number, 0, RG_ALWAYS),
+    RECORD_FIELD("serial_number_good", serial_number_good, 0, RG_ALWAYS),
+    RECORD_FIELD("battery_fault", battery_fault, 0, RG_ALWAYS),
+    RECORD_FIELD("battery_charging", battery_charging, 0, RG_ALWAYS),
+    RECORD_FIELD("rtc_temperature", rtc_temperature, 2, RG_ALWAYS),
+    RECORD_FIELD("start_time", start_time, 0, RG_ALWAYS),
+    RECORD_FIELD("end_time", end_time, 0, RG_ALWAYS),
+    RECORD_FIELD("rtc_gps_offset", rtc_gps_offset, 0, RG_RTC_GPS),
+    RECORD_FIELD("btemperature", btemperature, 2, RG_ALWAYS),
+    RECORD_FIELD("bvoltage", bvoltage, 3, RG_ALWAYS),
+    RECORD_FIELD("bcurrent", bcurrent, 4, RG_ALWAYS),
+    RECORD_FIELD("bcapacity", bcapacity, 4, RG_ALWAYS),
+    RECORD_FIELD("uptime", uptime, 0, RG_ALWAYS),
+
+    RECORD_FIELD("latitude", gdata.lat, 6, RG_GPS),
+    RECORD_FIELD("longitude", gdata.lng, 6, RG_GPS),
+    RECORD_FIELD("speed", gdata.speed, 2, RG_GPS),
+    RECORD_FIELD("altitude", gdata.alt, 1, RG_GPS),
+    RECORD_FIELD("height", gdata.height, 1, RG_GPS),
+    RECORD_FIELD("lat_err", gdata.lat_err, 2, RG_GPS),
+    RECORD_FIELD("long_err", gdata.long_err, 2, RG_GPS),
+    RECORD_FIELD("alt_err", gdata.alt_err, 2, RG_GPS),
+    RECORD_FIELD("gps_hours", gdata.hours, 0, RG_GPS),
+    RECORD_FIELD("gps_minutes", gdata.minutes, 0, RG_GPS),
+    RECORD_FIELD("gps_seconds", gdata.seconds, 0, RG_GPS),
+    RECORD_FIELD("gps_microseconds", gdata.microseconds, 0, RG_GPS),
+    RECORD_FIELD("gps_day", gdata.day, 0, RG_GPS),
+    RECORD_FIELD("gps_month", gdata.month, 0, RG_GPS),
+    RECORD_FIELD("gps_year", gdata.year, 0, RG_GPS),
+    RECORD_FIELD("gps_fix_quality", gdata.fix_quality, 0, RG_GPS),
+    RECORD_FIELD("gps_satellites", gdata.satellites, 0, RG_GPS),
+    RECORD_FIELD("gps_hdop", gdata.hdop, 2, RG_GPS),
+    RECORD_FIELD("gps_pdop", gdata.pdop, 2, RG_GPS),
+    RECORD_FIELD("gps_vdop", gdata.vdop, 2, RG_GPS),
+    RECORD_FIELD("gps_total_sats", gdata.total_sats, 0, RG_GPS),
+    RECORD_FIELD("gps_gdata_good", gdata.good, 0, RG_GPS),
+    RECORD_FIELD("gps_reused", gps_reused, 0, RG_ALWAYS),
+    RECORD_FIELD("gps_ttff", gps_ttff, 0, RG_ALWAYS),
+    RECORD_FIELD("gps_on_time", gps_on_time, 0, RG_ALWAYS),
+
+    RECORD_FIELD("policy_tier", policy_tier, 0, RG_ALWAYS),
+    RECORD_FIELD("policy_m", policy_m, 0, RG_ALWAYS),
+    RECORD_FIELD("uplink_pending", uplink_pending, 0, RG_ALWAYS),
+    RECORD_FIELD("event", event, 0, RG_ALWAYS),
+    RECORD_FIELD("event_flags", event_flags, 0, RG_ALWAYS)
+};
+
+static constexpr record_array_field RECORD_ARRAYS[] =
+{
+    // additional 1-wire temperature probes {temp1, temp2,...}
+    RECORD_ARRAY("temp%u", temperature, 3, RG_TEMP, 1, MAX_TEMP_SENSORS, NULL, true),
+    RECORD_ARRAY("temp%u_out", temperature_out, 3, RG_TEMP, 1, MAX_TEMP_SENSORS, NULL, true),
+
+    // charge (mAh) and time (ms) of each phase of the last sample cycle
+    RECORD_ARRAY("pp_%s_mah", pp_mah, 4, RG_PP, 0, NUM_PP_PHASES, PP_PHASE_NAMES, false),
+    RECORD_ARRAY("pp_%s_ms", pp_ms, 0, RG_PP, 0, NUM_PP_PHASES, PP_PHASE_NAMES, false)
+};
+
+const size_t NUM_RECORD_FIELDS = sizeof(RECORD_FIELDS) / sizeof(RECORD_FIELDS[0]);
+const size_t NUM_RECORD_ARRAYS = sizeof(RECORD_ARRAYS) / sizeof(RECORD_ARRAYS[0]);
+const size_t RECORD_KEY_SIZ = 32;
+const size_t RECORD_WINDOW_SIZ = 64;
+
+
+//------------------------------------------------------------------------------------
+// OUTPUT BUFFERS
+//------------------------------------------------------------------------------------
+
+// Text output to the sink through a small window (call flush() at the end)
+class RecordText
+{
+public:
+    RecordText(RecordSink &sink) : sink(sink), len(0) {}
+    void put(char c)
+    {
+        if (len == RECORD_WINDOW_SIZ) flush();
+        window[len++] = c;
+    }
+    void puts(const char *s)
+    {
+        while (*s) put(*s++);
+    }
+    void put_float(float v, uint8_t precision)
+    {
+        char tmp[FIXED_FORMAT_SIZ];
+        format_fixed(v, precision, tmp);
+        puts(tmp);
+    }
+    void put_int(int32_t v)
+    {
+        char tmp[16];
+        modp_itoa10(v, tmp);
+        puts(tmp);
+    }
+    void put_uint(uint32_t v)
+    {
+        char tmp[16];
+        modp_itoa10u(v, tmp);
+        puts(tmp);
+    }
+    void put_uint64(uint64_t v)
+    {
+        char tmp[24];
+        modp_itoa10u64(v, tmp);
+        puts(tmp);
+    }
+    void flush()
+    {
+        sink.write(window, len);
+        len = 0;
+    }
+private:
+    RecordSink &sink;
+    char window[RECORD_WINDOW_SIZ];
+    size_t len;
+}; // end
+
+
+//------------------------------------------------------------------------------------
+// WRITERS
+// ALL_FIELDS is true if skip() is called for the fields that are not enabled.
+//------------------------------------------------------------------------------------
+
+class RecordJsonWriter
+{
+public:
+    static const bool ALL_FIELDS = false;
+    RecordJsonWriter(RecordText &out) : out(out), first(true) {}
+    void begin(const struct main_data_storage &d, uint8_t groups)
+    {
+        out.put('{');
+        value_string("token", get_key());
+        value_int("num", get_num());
+        value_string("name", get_sensor_name_str());
+    }
+    void end()
+    {
+        out.put('}');
+        out.flush();
+    }
+    void skip(const char *key) {}
+    void value_float(const char *key, float v, uint8_t precision)
+    {
+        begin_key(key);
+        if (!isfinite(v)) v = NAN_VALUE_REPLACE;     // such as a transfer expression that divides by zero
+        out.put_float(v, precision);
+    }
+    void value_bool(const char *key, bool v)
+    {
+        begin_key(key);
+        out.puts(v ? "true" : "false");
+    }
+    void value_int(const char *key, int32_t v)
+    {
+        begin_key(key);
+        out.put_int(v);
+    }
+    void value_uint(const char *key, uint32_t v)
+    {
+        begin_key(key);
+        out.put_uint(v);
+    }
+    void value_uint64(const char *key, uint64_t v)
+    {
+        begin_key(key);
+        out.put_uint64(v);
+    }
+    void value_string(const char *key, const char *v)
+    {
+        begin_key(key);
+        out.put('"');
+        for (; *v; v++)
+        {
+            if (*v == '"' || *v == '\\') out.put('\\');
+            if ((uint8_t)*v >= ' ') out.put(*v);
+        }
+        out.put('"');
+    }
+private:
+    void begin_key(const char *key)
+    {
+        if (!first) out.put(',');
+        first = false;
+        out.put('"');
+        out.puts(key);
+        out.puts("\":");
+    }
+    RecordText &out;
+    bool first;
+}; // end
+
+
+class RecordCsvWriter
+{
+public:
+    static const bool ALL_FIELDS = true;
+    RecordCsvWriter(RecordText &out) : out(out), first(true) {}
+    void begin(const struct main_data_storage &d, uint8_t groups) {}
+    void end() { out.flush(); }
+    void skip(const char *key) { separator(); }
+    void value_float(const char *key, float v, uint8_t precision)
+    {
+        separator();
+        if (isfinite(v)) out.put_float(v, precision);
+    }
+    void value_bool(const char *key, bool v)
+    {
+        separator();
+        out.put(v ? '1' : '0');
+    }
+    void value_int(const char *key, int32_t v)
+    {
+        separator();
+        out.put_int(v);
+    }
+    void value_uint(const char *key, uint32_t v)
+    {
+        separator();
+        out.put_uint(v);
+    }
+    void value_uint64(const char *key, uint64_t v)
+    {
+        separator();
+        out.put_uint64(v);
+    }
+    void value_string(const char *key, const char *v)
+    {
+        separator();
+        for (; *v; v++) if (*v != ',' && (uint8_t)*v >= ' ') out.put(*v);
+    }
+private:
+    void separator()
+    {
+        if (!first) out.put(',');
+        first = false;
+    }
+    RecordText &out;
+    bool first;
+}; // end
+
+
+// Writes the names of the CSV columns
+class RecordCsvHeaderWriter
+{
+public:
+    static const bool ALL_FIELDS = true;
+    RecordCsvHeaderWriter(RecordText &out) : out(out), first(true) {}
+    void begin(const struct main_data_storage &d, uint8_t groups) {}
+    void end() { out.flush(); }
+    void skip(const char *key) { name(key); }
+    void value_float(const char *key, float v, uint8_t precision) { name(key); }
+    void value_bool(const char *key, bool v) { name(key); }
+    void value_int(const char *key, int32_t v) { name(key); }
+    void value_uint(const char *key, uint32_t v) { name(key); }
+    void value_uint64(const char *key, uint64_t v) { name(key); }
+    void value_string(const char *key, const char *v) { name(key); }
+private:
+    void name(const char *key)
+    {
+        if (!first) out.put(',');
+        first = false;
+        out.puts(key);
+    }
+    RecordText &out;
+    bool first;
+}; // end
+
+
+class RecordBinaryWriter
+{
+public:
+    static const bool ALL_FIELDS = false;
+    RecordBinaryWriter(RecordSink &out) : out(out) {}
+    void begin(const struct main_data_storage &d, uint8_t groups)
+    {
+        uint8_t header[3] = {RECORD_BINARY_VERSION, groups, (uint8_t)d.num_temp_sensors};
+        out.write(header, sizeof(header));
+    }
+    void end() {}
+    void skip(const char *key) {}
+    void value_float(const char *key, float v, uint8_t precision) { out.write(&v, sizeof(v)); }
+    void value_bool(const char *key, bool v)
+    {
+        uint8_t b = v ? 1 : 0;
+        out.write(&b, 1);
+    }
+    void value_int(const char *key, int32_t v) { out.write(&v, sizeof(v)); }
+    void value_uint(const char *key, uint32_t v) { out.write(&v, sizeof(v)); }
+    void value_uint64(const char *key, uint64_t v) { out.write(&v, sizeof(v)); }
+    void value_string(const char *key, const char *v)
+    {
+        size_t n = strlen(v);
+        uint8_t len = n > 255 ? 255 : n;
+        out.write(&len, 1);
+        out.write(v, len);
+    }
+private:
+    RecordSink &out;
+}; // end
+
+
+// Prints one line for each field (used by the CLI)
+class RecordPrintWriter
+{
+public:
+    static const bool ALL_FIELDS = false;
+    RecordPrintWriter() : sink(line, sizeof(line)), out(sink) {}
+    void begin(const struct main_data_storage &d, uint8_t groups) {}
+    void end() {}
+    void skip(const char *key) {}
+    void value_float(const char *key, float v, uint8_t precision)
+    {
+        begin_key(key);
+        out.put_float(v, precision);
+        print();
+    }
+    void value_bool(const char *key, bool v)
+    {
+        begin_key(key);
+        out.put(v ? '1' : '0');
+        print();
+    }
+    void value_int(const char *key, int32_t v)
+    {
+        begin_key(key);
+        out.put_int(v);
+        print();
+    }
+    void value_uint(const char *key, uint32_t v)
+    {
+        begin_key(key);
+        out.put_uint(v);
+        print();
+    }
+    void value_uint64(const char *key, uint64_t v)
+    {
+        begin_key(key);
+        out.put_uint64(v);
+        print();
+    }
+    void value_string(const char *key, const char *v)
+    {
+        begin_key(key);
+        out.puts(v);
+        print();
+    }
+private:
+    void begin_key(const char *key)
+    {
+        sink = RecordBufferSink(line, sizeof(line));
+        out.puts(key);
+        out.puts(": ");
+    }
+    void print()
+    {
+        out.flush();
+        printSerial(line);
+    }
+    char line[SMALL_BUFF_JSON_SIZ];
+    RecordBufferSink sink;
+    RecordText out;
+}; // end
+
+
+//------------------------------------------------------------------------------------
+// SERIALIZER
+//------------------------------------------------------------------------------------
+
+static size_t record_type_size(record_field_type type)
+{
+    switch (type)
+    {
+        case RF_FLOAT: return sizeof(float);
+        case RF_BOOL: return sizeof(bool);
+        case RF_INT: return sizeof(int);
+        case RF_UINT: return sizeof(unsigned int);
+        case RF_LONG: return sizeof(long);
+        case RF_ULONG: return sizeof(unsigned long);
+        case RF_ULLONG: return sizeof(unsigned long long);
+        case RF_STRING: return 0;      // there are no arrays of text
+    }
+    return 0;
+} // end
+
+
+// Groups of the fields that are enabled for the record
+static uint8_t record_groups(const struct main_data_storage &d)
+{
+    WaterWatcherOptions *opt = get_options();
+    uint8_t groups = RG_ALWAYS | RG_GPS;
+    if (opt->is_sample_a0()) groups |= RG_A0;
+    if (opt->is_sample_a1()) groups |= RG_A1;
+    if (opt->is_sample_a2()) groups |= RG_A2;
+    if (opt->is_sample_temp0()) groups |= RG_TEMP;
+    if (d.rtc_gps_offset_valid) groups |= RG_RTC_GPS;
+    if (d.pp_valid) groups |= RG_PP;
+    return groups;
+} // end
+
+
+// Write the member at p to the writer
+template <class W>
+static void record_put(W &w, const char *key, record_field_type type, uint8_t precision, const uint8_t *p)
+{
+    switch (type)
+    {
+        case RF_FLOAT: w.value_float(key, *reinterpret_cast<const float *>(p), precision); break;
+        case RF_BOOL: w.value_bool(key, *reinterpret_cast<const bool *>(p)); break;
+        case RF_INT: w.value_int(key, *reinterpret_cast<const int *>(p)); break;
+        case RF_UINT: w.value_uint(key, *reinterpret_cast<const unsigned int *>(p)); break;
+        case RF_LONG: w.value_int(key, *reinterpret_cast<const long *>(p)); break;
+        case RF_ULONG:
+            if (sizeof(unsigned long) > sizeof(uint32_t)) w.value_uint64(key, *reinterpret_cast<const unsigned long *>(p));
+            else w.value_uint(key, *reinterpret_cast<const unsigned long *>(p));
+            break;
+        case RF_ULLONG: w.value_uint64(key, *reinterpret_cast<const unsigned long long *>(p)); break;
+        case RF_STRING: w.value_string(key, reinterpret_cast<const char *>(p)); break;
+    }
+} // end
+
+
+template <class W>
+static void record_serialize(const struct main_data_storage &d, uint8_t groups, W &w)
+{
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(&d);
+    w.begin(d, groups);
+    for (size_t k = 0; k < NUM_RECORD_FIELDS; k++)
+    {
+        const record_field &f = RECORD_FIELDS[k];
+        if (groups & f.group) record_put(w, f.name, f.type, f.precision, base + f.offset);
+        else if (W::ALL_FIELDS) w.skip(f.name);
+    }
+
+    char key[RECORD_KEY_SIZ];
+    for (size_t k = 0; k < NUM_RECORD_ARRAYS; k++)
+    {
+        const record_array_field &a = RECORD_ARRAYS[k];
+        size_t stride = record_type_size(a.type);
+        for (size_t i = a.first; i < a.count; i++)
+        {
+            bool on = (groups & a.group) && (!a.counted || i < d.num_temp_sensors);
+            if (!on && !W::ALL_FIELDS) continue;
+            if (a.labels) snprintf(key, sizeof(key), a.name, a.labels[i]);
+            else snprintf(key, sizeof(key), a.name, (unsigned int)i);
+            if (on) record_put(w, key, a.type, a.precision, base + a.offset + i*stride);
+            else w.skip(key);
+        }
+    }
+    w.end();
+} // end
+
+
+/*
+Write the record as JSON to out.
+Returns the length or 0 if the record could not be written.
+*/
+size_t record_write_json(const struct main_data_storage &d, RecordSink &out)
+{
+    RecordText text(out);
+    RecordJsonWriter w(text);
+    record_serialize(d, record_groups(d), w);
+    return out.length();
+} // end
+
+
+/*
+Write the record as a CSV line (without the line ending) to out.
+Returns the length or 0 if the record could not be written.
+*/
+size_t record_write_csv(const struct main_data_storage &d, RecordSink &out)
+{
+    RecordText text(out);
+    RecordCsvWriter w(text);
+    record_serialize(d, record_groups(d), w);
+    return out.length();
+} // end
+
+
+/*
+Write the names of the CSV columns (without the line ending) to out.
+Returns the length or 0 if the header could not be written.
+*/
+size_t record_write_csv_header(RecordSink &out)
+{
+    // with no groups, only the names of the fields are written and the record is not read
+    static const struct main_data_storage empty = {};       // constant data in flash
+    RecordText text(out);
+    RecordCsvHeaderWriter w(text);
+    record_serialize(empty, 0, w);
+    return out.length();
+} // end
+
+
+/*
+Write the record as binary to out.
+Returns the length or 0 if the record could not be written.
+*/
+size_t record_write_binary(const struct main_data_storage &d, RecordSink &out)
+{
+    RecordBinaryWriter w(out);
+    record_serialize(d, record_groups(d), w);
+    return out.length();
+} // end
+
+
+/*
+Print the fields of the groups (such as RG_GPS) with one line per field
+*/
+void record_print(const struct main_data_storage &d, uint8_t groups)
+{
+    RecordPrintWriter w;
+    record_serialize(d, groups, w);
+} // end
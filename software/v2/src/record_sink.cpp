@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include "record_sink.h"
+#include "constants.h"
+#include "main_local.h"
+#include "crc.h"
+
+/*
+Sinks of the record serializers.
+
+The serializers write the record in chunks of up to RECORD_WINDOW_SIZ bytes, so the SD card file, the modem
+and the CRC receive the record as it is formatted.  The FatFs sector buffer of the file collects the chunks
+before the sector is written to the SD card.
+*/
+
+RecordBufferSink::RecordBufferSink(char *buf, size_t size) : buf(buf), size(size), len(0)
+{
+    if (size) buf[0] = '\0';
+} // end
+
+
+bool RecordBufferSink::emit(const uint8_t *p, size_t n)
+{
+    if (len + n >= size) return false;
+    memcpy(buf + len, p, n);
+    len += n;
+    buf[len] = '\0';
+    return true;
+} // end
+
+
+/*
+Open the file to append the record.  The file is created if it does not exist.
+size is set to the size of the file before the record, which is the offset of the record in the file.
+*/
+bool RecordSdSink::open(const char *filename, uint32_t &size)
+{
+    close();
+    for (int cnt = 0; cnt <= SD_CARD_MAX_TRIES_WRITE; cnt++)
+    {
+        check_sdcard_mounted();
+        if (f_open(&fil, filename, FA_OPEN_ALWAYS | FA_WRITE)) continue;
+        size = f_size(&fil);
+        if (f_lseek(&fil, size) != FR_OK)
+        {
+            f_close(&fil);
+            continue;
+        }
+        is_open = true;
+        return true;
+    }
+    return false;
+} // end
+
+
+/*
+Write the remaining data to the SD card and close the file.
+Returns false if any of the record could not be written.
+*/
+bool RecordSdSink::close()
+{
+    if (!is_open) return false;
+    is_open = false;
+    bool rv = f_sync(&fil) == FR_OK;
+    rv = f_close(&fil) == FR_OK && rv;
+    return rv && good();
+} // end
+
+
+bool RecordSdSink::emit(const uint8_t *p, size_t n)
+{
+    UINT bw;
+    if (!is_open) return false;
+    return f_write(&fil, p, n, &bw) == FR_OK && bw == n;
+} // end
+
+
+bool RecordUartSink::emit(const uint8_t *p, size_t n)
+{
+    return serial->sendChars(reinterpret_cast<const char *>(p), n);
+} // end
+
+
+bool RecordCrcSink::emit(const uint8_t *p, size_t n)
+{
+    crc = crc32_update(crc, p, n);
+    return true;
+} // end
+
+
+// Print the length and CRC of the record
+void RecordCrcSink::print() const
+{
+    char line[48];
+    snprintf(line, sizeof(line), "Record: %u bytes, crc32 0x%08lx", (unsigned int)length(), (unsigned long)value());
+    printSerial(line);
+} // end
+
+
+bool RecordTeeSink::emit(const uint8_t *p, size_t n)
+{
+    a.write(p, n);
+    b.write(p, n);
+    return a.good() && b.good();
+} // end
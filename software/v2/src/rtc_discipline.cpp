@@ -0,0 +1,180 @@
+#include <Arduino.h>
+#include "rtc_discipline.h"
+#include "constants.h"
+#include "data_storage.h"
+#include "fixed_format.h"
+#include "flash_mem.h"
+#include "main_local.h"
+#include "sd_storage.h"
+#include "time_helper.h"
+#include "time_service.h"
+
+/*
+Discipline of the DS3231 from the GPS time.
+
+Each sample with a new GPS fix measures the offset of the RTC from the GPS time (rtc_gps_offset).
+The time is read from the time service, which is aligned to the DS3231 every TIME_RESYNC_S, and the fix is
+time stamped when the sentence is parsed in the main loop, so each offset has an error of up to
+RTC_OFFSET_JITTER_MS (the SD card, I2C and 1-Wire block the main loop).
+
+1. If the offset is larger than RTC_STEP_MS, the DS3231 is set to the GPS time at the start of the next
+   GPS second.  The DS3231 alarm is set again, since the time of the alarm might have been skipped.
+2. Otherwise, the offsets are collected into windows of RTC_OFFSET_WINDOW, and the median of each window is
+   used so that a single late time stamp does not move the estimate.  The drift is estimated from the change
+   of the median from a reference window that is at least RTC_DRIFT_MIN_S before.  The reference is kept
+   until the change is larger than RTC_OFFSET_JITTER_MS, so the drift is not estimated from the jitter.
+   If the drift is larger than RTC_DRIFT_DEADBAND_PPM, the aging offset of the DS3231 is trimmed by up to
+   RTC_AGING_MAX_STEP to reduce the drift.  The aging offset is kept by the DS3231 backup battery.
+
+Each step and trim is printed and logged to <name>.log on the SD card.
+
+NOTE that the offset includes the delay of the sentences from the GPS receiver, which is
+mostly constant and so has little effect on the drift.
+
+REFERENCE:
+DS3231 Data Sheet, Aging Offset (0x10)
+*/
+
+static struct rtc_discipline_data
+{
+    DS3231 *rtc;
+    size_t num;                                 // offsets in the current window
+    uint32_t time[RTC_OFFSET_WINDOW];           // GPS time (s) of each offset in the window
+    int32_t offset[RTC_OFFSET_WINDOW];          // offsets (ms) in the window
+    bool ref_valid;         // true if there is a window to estimate the drift from
+    uint32_t ref_time;      // GPS time (s) of the reference window
+    int32_t ref_offset;     // median offset (ms) of the reference window
+    bool have_offset;       // true if an offset has been measured since the reset
+    int32_t last_offset;    // last offset (ms) of the RTC from the GPS time
+    float drift;            // last drift (ppm, positive if the RTC is fast)
+    int steps;              // number of times that the time has been set since the reset
+    int trims;              // number of times that the aging offset has been changed since the reset
+} rdd;
+
+
+// Set the DS3231 to the GPS time at the start of the next GPS second
+static void rtc_step(int32_t offset)
+{
+    int64_t gps_ms = (int64_t)time_service_epoch_ms() - offset;
+    uint32_t next = gps_ms / 1000 + 1;
+    unsigned long start = millis();
+    while ((int64_t)time_service_epoch_ms() - offset < (int64_t)next * 1000 && millis() - start < TIME_SYNC_EDGE_WAIT);
+
+    int day, month, year, hour, minute, second, dayNum;
+    time_from_epoch(next, day, month, year, hour, minute, second, dayNum);
+    if (!rdd.rtc->setTime(day, month, year, hour, minute, second)) return;
+    time_service_sync();
+    if (get_alarm_on()) set_next_alarm_rtc();
+    rdd.steps++;
+    char line[40];
+    snprintf(line, sizeof(line), "rtc step offset_ms=%ld", (long)offset);
+    sd_write_log(line);
+} // end
+
+
+// Trim the aging offset from the drift
+static void rtc_trim(float drift)
+{
+    long step = lround(drift / RTC_AGING_PPM_PER_LSB);
+    if (step > RTC_AGING_MAX_STEP) step = RTC_AGING_MAX_STEP;
+    if (step < -RTC_AGING_MAX_STEP) step = -RTC_AGING_MAX_STEP;
+    int aging = rdd.rtc->getAgingOffset();
+    long next = aging + step;
+    if (next > INT8_MAX) next = INT8_MAX;
+    if (next < INT8_MIN) next = INT8_MIN;
+    if (next == aging) return;
+    rdd.rtc->setAgingOffset(next);
+    rdd.trims++;
+    char num[FIXED_FORMAT_SIZ];
+    format_fixed(drift, 3, num);
+    char line[64];
+    snprintf(line, sizeof(line), "rtc trim drift_ppm=%s aging=%ld", num, next);
+    sd_write_log(line);
+} // end
+
+
+// Median of the offsets and mean of the times of the window
+static void rtc_window(int32_t &offset, uint32_t &t)
+{
+    int32_t v[RTC_OFFSET_WINDOW];
+    uint32_t dt = 0;
+    for(size_t k = 0; k < rdd.num; k++)
+    {
+        // insertion sort of the few offsets
+        size_t j = k;
+        for(; j > 0 && v[j - 1] > rdd.offset[k]; j--) v[j] = v[j - 1];
+        v[j] = rdd.offset[k];
+        dt += rdd.time[k] - rdd.time[0];
+    }
+    offset = v[rdd.num / 2];
+    t = rdd.time[0] + dt / rdd.num;
+} // end
+
+
+void setup_rtc_discipline(DS3231 *rtc)
+{
+    rdd.rtc = rtc;
+    rdd.num = 0;
+    rdd.ref_valid = false;
+    rdd.have_offset = false;
+    rdd.drift = NAN;
+    rdd.steps = 0;
+    rdd.trims = 0;
+} // end
+
+
+/*
+Call this function with the offset (ms) of the RTC from the GPS time and the GPS time (ms since 1970-01-01 00:00:00)
+*/
+void rtc_discipline_update(int32_t offset, uint64_t gps_ms)
+{
+    rdd.last_offset = offset;
+    rdd.have_offset = true;
+    uint32_t t = gps_ms / 1000;
+
+    if (offset > RTC_STEP_MS || offset < -RTC_STEP_MS)
+    {
+        rtc_step(offset);
+        rdd.num = 0;
+        rdd.ref_valid = false;  // the offset after the step is measured with the next fix
+        return;
+    }
+    if (rdd.num > 0 && t <= rdd.time[rdd.num - 1]) rdd.num = 0;     // the GPS time went back
+    rdd.time[rdd.num] = t;
+    rdd.offset[rdd.num++] = offset;
+    if (rdd.num < RTC_OFFSET_WINDOW) return;
+    rtc_window(offset, t);
+    rdd.num = 0;
+
+    if (!rdd.ref_valid || t <= rdd.ref_time)
+    {
+        rdd.ref_valid = true;
+        rdd.ref_time = t;
+        rdd.ref_offset = offset;
+        return;
+    }
+    uint32_t elapsed = t - rdd.ref_time;
+    if (elapsed < RTC_DRIFT_MIN_S) return;
+    int32_t change = offset - rdd.ref_offset;
+    if (change <= RTC_OFFSET_JITTER_MS && change >= -RTC_OFFSET_JITTER_MS) return;    // keep the reference
+
+    rdd.drift = change * 1000.0f / elapsed;     // ms per s to ppm
+    rdd.ref_time = t;
+    rdd.ref_offset = offset;
+    if (fabs(rdd.drift) >= RTC_DRIFT_DEADBAND_PPM) rtc_trim(rdd.drift);
+} // end
+
+
+/*
+CLI: print-rtc-discipline
+*/
+void print_rtc_discipline()
+{
+    printSerial("aging: " + String(rdd.rtc->getAgingOffset()));
+    if (rdd.have_offset) printSerial("offset_ms: " + String(rdd.last_offset));
+    else printSerial("offset_ms: none");
+    printSerial("window: " + String((unsigned int)rdd.num) + "/" + String((unsigned int)RTC_OFFSET_WINDOW));
+    printSerial("drift_ppm: " + String(rdd.drift, 3));
+    printSerial("steps: " + String(rdd.steps));
+    printSerial("trims: " + String(rdd.trims));
+} // end
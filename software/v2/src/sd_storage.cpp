@@ -12,13 +12,15 @@
 #include "flash_mem.h"
 #include "experiment.h"
 #include "data_storage.h"
+#include "record_sink.h"
+#include "arena.h"
 
 
 //-------------------------------------------------------------------------------------------
 static struct sd_storage_data
 {
-    char buff[SD_CHAR_BUFFER];
-    char buff2[SD_CHAR_BUFFER];
+    char *buff;                 // SD_CHAR_BUFFER bytes from the arena
+    char *buff2;                // SD_CHAR_BUFFER bytes from the arena
     bool is_mounted;
     FATFS fs;
     bool print_file_cancel_flag;
@@ -31,6 +33,8 @@ static struct sd_storage_data
  */
 void set_startup_setup_sd()
 {
+    if (!sdd.buff) sdd.buff = static_cast<char *>(arena_alloc(ARENA_SD, SD_CHAR_BUFFER));
+    if (!sdd.buff2) sdd.buff2 = static_cast<char *>(arena_alloc(ARENA_SD, SD_CHAR_BUFFER));
     sdd.is_mounted = false;
     sdd.print_file_cancel_flag = false;
     sd_clear_buffer();
@@ -43,8 +47,8 @@ void set_startup_setup_sd()
  */
 void sd_clear_buffer()
 {
-    memset(sdd.buff,0,sizeof(sdd.buff));
-    memset(sdd.buff2,0,sizeof(sdd.buff2));
+    memset(sdd.buff,0,SD_CHAR_BUFFER);
+    memset(sdd.buff2,0,SD_CHAR_BUFFER);
 } // end
 
 
@@ -119,7 +123,7 @@ bool sd_print_file(const char *fname)
     if (fr) return false;
 
     /* Read all lines and display it */
-    while (f_gets(sdd.buff, sizeof(sdd.buff), &fil))
+    while (f_gets(sdd.buff, SD_CHAR_BUFFER, &fil))
     {
         if( sdd.print_file_cancel_flag) break;
         printSerialWithoutLineEnding(String(sdd.buff));
@@ -264,6 +268,104 @@ bool sd_write_text_to_file(const char *filename, const char *text)
 } // end
 
 
+/*
+ * Print the text with the time and append the line to the log file of the station (<name>.log).
+ * This is used to log the changes of state during the sample, so String is not used.
+ */
+bool sd_write_log(const char *text)
+{
+    char line[MAX_LOG_LINE_SIZ];
+    get_time_chars(line, sizeof(line));
+    size_t n = strlen(line);
+    snprintf(line + n, sizeof(line) - n, " %s", text);
+    printSerial(line);
+
+    char fname[MAX_NUM_CHARS_SENSOR_NAME + sizeof(POLICY_LOG_EXTENSION)];
+    snprintf(fname, sizeof(fname), "%s" POLICY_LOG_EXTENSION, get_sensor_name_str());
+    return sd_write_text_to_file(fname, line);
+} // end
+
+
+/*
+ * Obtain the size of a file in bytes.  The size is zero if the file does not exist.
+ */
+bool sd_file_size(const char *filename, uint32_t &size)
+{
+    FILINFO fno;
+    check_sdcard_mounted();
+
+    size = 0;
+    FRESULT fr = f_stat(filename, &fno);
+    if (fr == FR_NO_FILE) return true;
+    if (fr != FR_OK) return false;
+    size = fno.fsize;
+    return true;
+} // end
+
+
+/*
+ * Write the line that starts at offset in the file to out.
+ * The line is written without the line ending, and next is set to the offset of the following line.
+ * Returns false if there is no complete line at the offset (a line without the line ending at the end of
+ * the file has not been written completely).  Check out.good() for errors of the output.
+ */
+bool sd_stream_line(const char *filename, uint32_t offset, RecordSink &out, uint32_t &next)
+{
+    FIL fil;       /* File object */
+    UINT br;
+    check_sdcard_mounted();
+
+    next = offset;
+    if (f_open(&fil, filename, FA_READ)) return false;
+    if (f_lseek(&fil, offset) != FR_OK)
+    {
+        f_close(&fil);
+        return false;
+    }
+
+    // the line can be longer than the buffer, so the line is written in parts
+    bool eol = false;
+    bool cr = false;        // CR at the end of the last part
+    while (!eol && out.good())
+    {
+        if (f_read(&fil, sdd.buff, SD_CHAR_BUFFER, &br) != FR_OK || br == 0) break;
+        size_t n = 0;
+        while (n < br && sdd.buff[n] != '\n') n++;
+        eol = n < br;
+        next += eol ? n + 1 : br;
+        if (cr && n != 0) out.write("\r", 1);
+        cr = n != 0 && sdd.buff[n-1] == '\r';
+        out.write(sdd.buff, cr ? n - 1 : n);
+    }
+    f_close(&fil);
+    return eol || !out.good();
+} // end
+
+
+/*
+ * Rename the file to <name>-<N><extension> with the first N that is not used, so that the next write
+ * starts a new file with the name.  Returns false if the file could not be renamed.
+ */
+bool sd_rotate_file(const char *filename)
+{
+    FILINFO fno;
+    check_sdcard_mounted();
+
+    const char *ext = strrchr(filename, '.');
+    if (ext == NULL) ext = filename + strlen(filename);
+    char rotated[MAX_NUM_CHARS_SENSOR_NAME + 16];
+    for(int k = 1; k <= SD_ROTATE_MAX; k++)
+    {
+        snprintf(rotated, sizeof(rotated), "%.*s-%d%s", (int)(ext - filename), filename, k, ext);
+        FRESULT fr = f_stat(rotated, &fno);
+        if (fr == FR_OK) continue;
+        if (fr != FR_NO_FILE) return false;
+        return f_rename(filename, rotated) == FR_OK;
+    }
+    return false;
+} // end
+
+
 /*
  * Write the text to the observation file.
  * This code ensures that the observations are split into separate files per month
@@ -5,6 +5,7 @@
 #include "main_local.h"
 #include "sdlib.h"
 #include "crc_7.h"
+#include "crc.h"
 #include "string_helper.h"
 #include "spi_local.h"
 
@@ -46,7 +47,9 @@ bool spi_read_write_sdcard(uint8_t *in, uint8_t *out, uint32_t siz, uint32_t opt
 
 3. Although rare, there are some cards that always require a valid CRC in SPI mode.  Therefore, a valid
 CRC is always sent when sending commands.  This will increase the processing time slightly, but it is better to be safe and send
-a valid CRC.  A valid CRC is not sent in the code when reading and writing data.  This is similar to other implementations, and it should work.
+a valid CRC.  CRC checking is turned on with CMD59, so the CRC-16 is also sent after each data block that is written,
+and the CRC-16 of each data block that is read is checked.  The CRC tables are in flash (crc.h), so the CRC of a block
+takes much less time than the transfer of the block.
 
 4. This code only supports SD 2.0 version cards.  Test each card before use.
 
@@ -79,6 +82,7 @@ static struct sd_card_data
 	bool is_version2;		// true if the SD card supports version 2 
 	bool is_setup;			// true if the SD card is setup
 	bool is_hc;				// true if the card is high capacity
+	bool crc_on;			// true if the card checks the CRC (CMD59)
 } sd;
 
 
@@ -112,7 +116,7 @@ bool init_sdcard_sdlib()
 	sd.is_setup = false; 
 	sd.is_version2 = false;
 	sd.is_hc = false;  
-	GenerateCRCTable();  // CRC requires table generation
+	sd.crc_on = false;
 
 	// ensure that the SD card is on by checking the power
 	check_sd_power();
@@ -231,6 +235,12 @@ bool init_sdcard_sdlib()
 
 	// \CS needs to be deselected here
 
+	// turn on the CRC so that the data blocks are checked
+	arg = 0x01;
+	rv = send_sdcard_command(&r1, R1_RESP_SIZE, SD_CMD59, arg, send_crc);
+	if (!rv) return false;
+	sd.crc_on = (r1 == 0x00);
+
 	// By default, the block length should be 512 bytes, so we do not have to explicitly set it.
 
 	// Change the clock rate to the MHz range if supported by the processor.
@@ -244,6 +254,27 @@ bool init_sdcard_sdlib()
 } // end
 
 
+/*
+Returns true if the CRC-16 received after the data block (bcrc0 is the MSB) is the CRC-16 of the block
+*/
+bool check_data_crc_sd(const uint8_t *buff, uint8_t bcrc0, uint8_t bcrc1)
+{
+	uint16_t crc = crc16_sd(buff, DATA_BYTES_READ_SD);
+	return crc == (((uint16_t)bcrc0 << 8) | bcrc1);
+} // end
+
+
+/*
+Send the CRC-16 of the data block (MSB first) after the data block
+*/
+bool write_data_crc_sd(const uint8_t *buff)
+{
+	uint16_t crc = crc16_sd(buff, BYTES_PER_SECTOR_SD);
+	uint8_t b[2] = {(uint8_t)(crc >> 8), (uint8_t)crc};
+	return spi_write_sdcard(b, 2, SPI_TRANSFER_OPTIONS_NONE);
+} // end
+
+
 /*
 Set the address location based on the type of card
 */
@@ -332,6 +363,7 @@ bool read_multiple_sector_sd(uint8_t *buff, uint32_t starting_sector, uint32_t n
 	if (rv == false) return false;
 
 	uint32_t cnt = 0;
+	bool crc_good = true;
 	for (uint32_t k = 0; k < num; k++)	// loop over the number of sectors
 	{
 		// print_string_then_unsigned_number("sector = ", k);
@@ -354,6 +386,7 @@ bool read_multiple_sector_sd(uint8_t *buff, uint32_t starting_sector, uint32_t n
 		// print_uart("Received CRC");
 		// print_string_then_unsigned_number("bcrc0 = ", bcrc0);
 		// print_string_then_unsigned_number("bcrc1 = ", bcrc1);
+		if (sd.crc_on && !check_data_crc_sd(sd.data_resp, bcrc0, bcrc1)) crc_good = false;
 		
 		// copy into the buffer
 		for (uint32_t k = 0; k < DATA_BYTES_READ_SD; k++)
@@ -393,7 +426,7 @@ bool read_multiple_sector_sd(uint8_t *buff, uint32_t starting_sector, uint32_t n
 	}
 	*/
 
-	return true;
+	return crc_good;
 
 } // end
 
@@ -445,6 +478,7 @@ bool read_single_sector_sd(uint8_t *buff, uint32_t sector)
 
 	//print_string_then_unsigned_number("bcrc0 = ", bcrc0);
 	//print_string_then_unsigned_number("bcrc1 = ", bcrc1);
+	if (sd.crc_on && !check_data_crc_sd(sd.data_resp, bcrc0, bcrc1)) return false;
 
 	// copy the buffer
 	for (uint32_t k = 0; k < DATA_BYTES_READ_SD; k++)
@@ -497,11 +531,8 @@ bool write_single_sector_sd(uint8_t *buff, uint32_t sector)
 	rv = spi_write_sdcard(buff, BYTES_PER_SECTOR_SD, SPI_TRANSFER_OPTIONS_NONE);
 	if (rv == false) { cleanup_sd(); return false; }
 
-	// send dummy CRC (two bytes)
-	cmd = 0xFF;
-	rv = spi_write_sdcard(&cmd, 1, SPI_TRANSFER_OPTIONS_NONE);
-	if (rv == false) { cleanup_sd(); return false; }
-	rv = spi_write_sdcard(&cmd, 1, SPI_TRANSFER_OPTIONS_NONE);
+	// send the CRC (two bytes)
+	rv = write_data_crc_sd(buff);
 	if (rv == false) { cleanup_sd(); return false; }
 
 	// obtain response to see if the sd card accepts the data
@@ -600,11 +631,8 @@ bool write_multiple_sector_sd(uint8_t *buff, uint32_t starting_sector, uint32_t
 		rv = spi_write_sdcard(buff, BYTES_PER_SECTOR_SD, SPI_TRANSFER_OPTIONS_NONE);
 		if (rv == false) { cleanup_sd(); return false; }
 
-		// send dummy CRC (two bytes)
-		cmd = 0xFF;
-		rv = spi_write_sdcard(&cmd, 1, SPI_TRANSFER_OPTIONS_NONE);
-		if (rv == false) { cleanup_sd(); return false; }
-		rv = spi_write_sdcard(&cmd, 1, SPI_TRANSFER_OPTIONS_NONE);
+		// send the CRC (two bytes)
+		rv = write_data_crc_sd(buff);
 		if (rv == false) { cleanup_sd(); return false; }
 
 		//print_uart("Obtaining response to see if SD card accepted write");
@@ -0,0 +1,128 @@
+#include <Arduino.h>
+#include "sleep_local.h"
+#include "constants.h"
+#include "experiment.h"
+#include "gps_manager.h"
+#include "gpio.h"
+#include "main_local.h"
+
+/*
+Sleep between events in the main loop.
+
+The MCU is put into STANDBY (the lowest power mode that keeps RAM) when there is nothing to do.
+The MCU wakes on:
+1. The falling edge of the DS3231 alarm on RTC_INT_PIN (the EIC is clocked from OSCULP32K so that it runs in STANDBY).
+2. The early warning interrupt of the watchdog, so that the watchdog is cleared in the main loop.
+
+STANDBY is not used when:
+1. USB is connected, since the console needs the USB clocks.  The MCU goes into IDLE and wakes on USB activity.
+   USBDevice.connected() only reports that the USB peripheral is enabled (it stays true after the cable is
+   removed), so the state of the USB device state machine is read: the device is suspended by the hardware
+   when there are no start of frame packets from the host for 3 ms.
+2. A task is waiting in the scheduler, since the tasks use millis() (SysTick wakes the MCU every 1 ms in IDLE).
+3. The GPS is being read after the sample, since the UART needs the clocks.
+
+NOTE that millis() does not advance in STANDBY.
+
+REFERENCE:
+SAM D21 Family Data Sheet, Section 16.6.2.8 (Sleep Mode Controller) and Section 21.6.8 (EIC Sleep Mode Operation)
+SAM D21 Family Data Sheet, Section 32.8.2.3 (USB Finite State Machine Status)
+SAM D21 Errata 1.14.2 (NVMCTRL SLEEPPRM)
+*/
+
+static const uint8_t GCLK_SLEEP_EIC = 5;   // generic clock generator used to clock the EIC in STANDBY
+
+// Wait for the generic clock controller to synchronize
+static void gclk_sync()
+{
+  while (GCLK->STATUS.bit.SYNCBUSY);
+} // end
+
+
+/*
+Setup the clocks so that the MCU can wake from STANDBY
+*/
+void setup_sleep()
+{
+  // GCLK5 from OSCULP32K runs in STANDBY and clocks the EIC for edge detection
+  GCLK->GENDIV.reg = GCLK_GENDIV_ID(GCLK_SLEEP_EIC) | GCLK_GENDIV_DIV(0);
+  gclk_sync();
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(GCLK_SLEEP_EIC) | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_OSCULP32K | GCLK_GENCTRL_RUNSTDBY;
+  gclk_sync();
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(GCM_EIC) | GCLK_CLKCTRL_GEN(GCLK_SLEEP_EIC) | GCLK_CLKCTRL_CLKEN;
+  gclk_sync();
+
+  // the watchdog clock (GCLK2) needs to run in STANDBY for the early warning interrupt
+  *((uint8_t *)&GCLK->GENCTRL.reg) = GCLK_GENCTRL_ID(2);
+  gclk_sync();
+  GCLK->GENCTRL.reg |= GCLK_GENCTRL_RUNSTDBY;
+  gclk_sync();
+
+  // errata: the NVM can be corrupted on wake from STANDBY if the NVM goes to sleep
+  NVMCTRL->CTRLB.bit.SLEEPPRM = NVMCTRL_CTRLB_SLEEPPRM_DISABLED_Val;
+} // end
+
+
+/*
+Configure the pin so that the EIC can wake the MCU from STANDBY.
+Call this function after attachInterrupt(), since attachInterrupt() clocks the EIC from GCLK0.
+*/
+void sleep_configure_wake_pin(uint32_t pin)
+{
+  uint32_t line = g_APinDescription[pin].ulExtInt;
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(GCM_EIC) | GCLK_CLKCTRL_GEN(GCLK_SLEEP_EIC) | GCLK_CLKCTRL_CLKEN;
+  gclk_sync();
+  EIC->WAKEUP.reg |= (1UL << line);
+} // end
+
+
+/*
+Returns true if a USB host is sending start of frame packets to the device
+*/
+static bool usb_active()
+{
+  if (!USB->DEVICE.CTRLA.bit.ENABLE) return false;
+  uint8_t state = USB->DEVICE.FSMSTATUS.bit.FSMSTATE;
+  return state != USB_FSMSTATUS_FSMSTATE_OFF_Val && state != USB_FSMSTATUS_FSMSTATE_SUSPEND_Val;
+} // end
+
+
+/*
+Returns true if the MCU can go into STANDBY
+*/
+bool sleep_standby_allowed()
+{
+  if (usb_active()) return false;
+  if (is_experiment_running()) return false;
+  if (!scheduler.idle()) return false;
+  if (gps_is_holding()) return false;
+  return true;
+} // end
+
+
+/*
+Call this function at the end of the main loop to sleep until the next event.
+The interrupts are disabled while checking for events so that an event cannot be missed before the WFI.
+*/
+void sleep_local()
+{
+  __disable_irq();
+  if (rtc_event_pending())
+  {
+    __enable_irq();
+    return;
+  }
+  if (sleep_standby_allowed())
+  {
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+  }
+  else
+  {
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    PM->SLEEP.reg = PM_SLEEP_IDLE(0);
+  }
+  __DSB();
+  __WFI();                  // a pending interrupt wakes the MCU even with the interrupts disabled
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+  __enable_irq();
+} // end
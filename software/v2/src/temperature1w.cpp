@@ -1,47 +1,150 @@
 #include <Arduino.h>
-#include <DallasTemperature.h> 
+#include <DallasTemperature.h>
 #include <OneWire.h>
 #include "temperature1w.h"
 #include "constants.h"
 #include "Vector.h"
-#include "temperature1w.h"
+#include "flash_mem.h"
+#include "main_local.h"
+#include "WaterWatcherOptions.h"
 
 // Objects used to obtain the water temperature
-OneWire oneWire(ONE_WIRE_TEMP_PIN); 
+OneWire oneWire(ONE_WIRE_TEMP_PIN);
 DallasTemperature sensors(&oneWire);
-Vector<String> temp_sensor_names;
-Vector<float> temp_sensor_tf_out;
+// The vectors are sized when the bus is searched and are only indexed by the sample, so the
+// elements are in the heap instead of in the inline storage of each global.
+Vector<String, 0> temp_sensor_names;
+Vector<float, 0> temp_sensor_values;
+Vector<float, 0> temp_sensor_tf_out;
+
+// Cached state of the bus so that the ROM search (sensors.begin()) is not done for every sample.
+// The probe in slot k is always named tk, and the slots are bound to the ROM addresses
+// stored in flash so that the names do not change when probes are added or the search order changes.
+static struct temperature_bus_data
+{
+  bool enumerated;                              // true if sensors.begin() has been called and the addresses are cached
+  size_t num;                                   // number of probes bound to names
+  DeviceAddress addr[MAX_TEMP_SENSORS];         // address of the probe bound to tk
+  bool present[MAX_TEMP_SENSORS];               // true if the probe bound to tk was found on the bus
+} tbd;
 
 
-Vector<float> get_tf_temperature()
+const Vector<float, 0> &get_tf_temperature()
 {
   return temp_sensor_tf_out;
 } // end
 
 /*
  * Function to obtain the water temperature via the 1-wire temperature sensor.
- * NOTE that this code sets the temperature to a default temperature if the 1-wire device cannot be read.
- * This function is only good for reading the first temperature sensor that is on the wire.
+ * All of the probes are read, and the temperature of the first probe (t0) is returned.
+ * NOTE that this code sets the temperature to DEVICE_DISCONNECTED_C if the 1-wire device cannot be read.
  */
 void get_water_temperature(float &temperature_C, bool &temp_good)
 {
-  setup_temperature();   // will call sensors.begin() as required for 1w communications
-  if (1)
+  temp_good = populate_values_temp_sensor();
+  get_water_temperature_last(temperature_C, temp_good);
+} // end
+
+/*
+ * Function to obtain the water temperature from the last read of the probes.
+ * temp_good is set to the result of the read before calling this function.
+ */
+void get_water_temperature_last(float &temperature_C, bool &temp_good)
+{
+  temperature_C = DEVICE_DISCONNECTED_C;
+  if (tbd.num == 0 || tbd.present[0] == false)
   {
-    sensors.requestTemperatures();
-    temperature_C = sensors.getTempCByIndex(0); 
-    temp_good = true;
-    if (temperature_C == DEVICE_DISCONNECTED_C) 
-    {
-        temp_good = false;
-    }
+    temp_good = false;
+    return;
+  }
+  temperature_C = temp_sensor_values[0];
+  if (temperature_C == DEVICE_DISCONNECTED_C) temp_good = false;
+} // end
+
+
+// Find the slot that is bound to an address, or return MAX_TEMP_SENSORS if there is no slot
+static size_t find_slot(const uint8_t *addr)
+{
+  for(size_t k = 0; k < tbd.num; k++)
+  {
+    if (memcmp(tbd.addr[k], addr, sizeof(DeviceAddress)) == 0) return k;
   }
-} // end 
+  return MAX_TEMP_SENSORS;
+} // end
+
+
+// Write the bindings to flash so that the names are kept across restarts
+static void store_temperature_bindings()
+{
+  if (!save_temp_rom()) printSerial("ERROR: temperature probes not stored in flash");
+} // end
 
 // Call this function to setup the 1w temperature bus
+// This will always search the bus for devices and bind them to the names {t0, t1,...}
+// The bindings are written to flash when a new probe is bound.
 void setup_temperature()
 {
   sensors.begin();
+
+  // start with the bindings in flash
+  tbd.num = get_temp_rom_num();
+  for(size_t k = 0; k < tbd.num; k++)
+  {
+    get_temp_rom(k, tbd.addr[k]);
+    tbd.present[k] = false;
+  }
+
+  // bind the probes on the bus, with new probes appended to the end.
+  // The bus is searched once (as in DS2438::findAll()) since sensors.getAddress(a, k) searches
+  // the bus from the start for each index.
+  DeviceAddress a;
+  bool changed = false;
+  oneWire.reset_search();
+  while (oneWire.search(a))
+  {
+    if (!sensors.validAddress(a) || !sensors.validFamily(a)) continue;
+    size_t slot = find_slot(a);
+    if (slot == MAX_TEMP_SENSORS)
+    {
+      if (tbd.num >= MAX_TEMP_SENSORS) continue;  // no more room for probes
+      slot = tbd.num++;
+      memcpy(tbd.addr[slot], a, sizeof(DeviceAddress));
+      set_temp_rom(slot, a);
+      changed = true;
+    }
+    tbd.present[slot] = true;
+  }
+  set_temp_rom_num(tbd.num);
+  if (changed) store_temperature_bindings();
+  populate_names_temp_sensor();
+  tbd.enumerated = true;
+} // end
+
+// Call this function to setup the 1w temperature bus only if the cached addresses
+// cannot be used.  A reset with a presence pulse is much cheaper than a ROM search.
+void setup_temperature_if_required()
+{
+  if (tbd.enumerated && tbd.num != 0)
+  {
+    if (oneWire.reset() == 1) return;    // presence pulse, so use the cache
+  }
+  setup_temperature();
+} // end
+
+// Call this function to ensure that the bus is searched at the next read
+void invalidate_temperature_bus()
+{
+  tbd.enumerated = false;
+} // end
+
+// Call this function to remove all of the name bindings
+// CLI: clear-temperature
+void clear_temperature_bindings()
+{
+  set_temp_rom_num(0);
+  tbd.num = 0;
+  store_temperature_bindings();
+  invalidate_temperature_bus();
 } // end
 
 // Obtain the number of devices on the bus
@@ -50,15 +153,29 @@ int get_temperature_device_count()
   return sensors.getDeviceCount();
 } // end
 
+// Obtain the number of probes bound to names
+size_t get_temperature_probe_count()
+{
+  return tbd.num;
+} // end
+
 
 // Function to populate the names of the temperature sensors
 // {t0, t1, t2,...}
 void populate_names_temp_sensor()
 {
-  int n = get_temperature_device_count();
+  size_t n = tbd.num;
+  if (n == 0)
+  {
+    temp_sensor_names.clear();
+    temp_sensor_values.clear();
+    temp_sensor_tf_out.clear();
+    return;
+  }
   temp_sensor_names.resize(static_cast<unsigned int>(n));
+  temp_sensor_values.resize(static_cast<unsigned int>(n));
   temp_sensor_tf_out.resize(static_cast<unsigned int>(n));
-  for(int k = 0; k < n; k++)
+  for(size_t k = 0; k < n; k++)
   {
     temp_sensor_names[k] = TEMP_SENSOR_INITIAL_NAME + String(k);
   }
@@ -67,30 +184,74 @@ void populate_names_temp_sensor()
 
 //-------------------------------------------------------------------------------------------
 
-// Populate temperature sensor values in the transfer function object. 
-// Note that this function is safe to call
-// since if the 1w device is disconnected, the getTempCByIndex() function
-// will only return DEVICE_DISCONNECTED_C.
-// CALL THIS FUNCTION DURING THE SAMPLING PROCEDURE
-void populate_values_temp_sensor()
-{
-  // size_t n = temp_sensor_names.size();
-  // setup_temperature();                // call to setup the bus 
-  // sensors.requestTemperatures();      // obtain all temperatures
-  // float out;                          // output temperature
-  // for(size_t k = 0; k < n; k++)
-  // {
-  //   tf.set_measurement_val(temp_sensor_names[k], sensors.getTempCByIndex(k), false);
-  //   tf.evaluate(temp_sensor_names[k], out);
-  //   temp_sensor_tf_out[k] = out;
-  // }
-} // end 
+// Populate temperature sensor values and the transfer function outputs.
+// All of the probes convert at the same time (one broadcast conversion) and are then
+// read by ROM address.  If a probe that was on the bus does not respond, the bus is
+// searched again and the read is tried one more time.
+// Returns true if all of the probes found on the bus could be read.
+// This function waits for the conversion.  The sample uses start_temperature_conversion() and
+// read_temperature_conversion() so that other tasks can run during the conversion.
+bool populate_values_temp_sensor()
+{
+  bool good = false;
+  for(int attempt = 0; attempt < 2; attempt++)
+  {
+    unsigned long wait = start_temperature_conversion();
+    if (tbd.num == 0) return false;
+    delay(wait);
+    good = read_temperature_conversion();
+    if (good) break;
+    invalidate_temperature_bus();
+  }
+  return good;
+} // end
+
+
+// Start the conversion of all of the probes without waiting.
+// Returns the time (ms) to wait before calling read_temperature_conversion().
+unsigned long start_temperature_conversion()
+{
+  setup_temperature_if_required();
+  if (tbd.num == 0) return 0;
+  sensors.setWaitForConversion(false);
+  sensors.requestTemperatures();      // all probes convert in parallel
+  sensors.setWaitForConversion(true);
+  return sensors.millisToWaitForConversion(sensors.getResolution());
+} // end
+
+
+// Read the probes after the conversion and apply the transfer functions.
+// Returns true if all of the probes found on the bus could be read.
+bool read_temperature_conversion()
+{
+  size_t n = tbd.num;
+  if (n == 0) return false;
+  bool good = true;
+  for(size_t k = 0; k < n; k++)
+  {
+    float v = DEVICE_DISCONNECTED_C;
+    if (tbd.present[k])
+    {
+      v = sensors.getTempC(tbd.addr[k]);
+      if (v == DEVICE_DISCONNECTED_C) good = false;
+    }
+    temp_sensor_values[k] = v;
+  }
+
+  WaterWatcherOptions *opt = get_options();
+  for(size_t k = 0; k < n; k++)
+  {
+    opt->set_temp_raw(k, temp_sensor_values[k]);
+    temp_sensor_tf_out[k] = opt->get_temp_out(k);
+  }
+  return good;
+} // end
 
 //-------------------------------------------------------------------------------------------
 
-String print_addr(DeviceAddress Thermometer) 
+String print_addr(DeviceAddress Thermometer)
 {
-  String out = ""; 
+  String out = "";
    for (uint8_t k = 0; k < 8; k++)
   {
     out += String(Thermometer[k], HEX) + " ";
@@ -103,15 +264,16 @@ String print_addr(DeviceAddress Thermometer)
 // CLI: scan-temperature
 String temperature_bus_info()
 {
-  setup_temperature();  // turn on the 1w bus
-  DeviceAddress Thermometer;
-  String s = "POSITION/TEMPERATURE(deg C)/ADDRESS\n";
-  int n = get_temperature_device_count();
-  for(int k = 0; k < n; k++)
+  setup_temperature();  // search the bus
+  populate_values_temp_sensor();
+  String s = "NAME/TEMPERATURE(deg C)/ADDRESS\n";
+  size_t n = tbd.num;
+  for(size_t k = 0; k < n; k++)
   {
-    sensors.getAddress(Thermometer, k);
-    s += String(k) + "/" + String(sensors.getTempCByIndex(k)) + "/" + print_addr(Thermometer) + "\n";
+    s += temp_sensor_names[k] + "/";
+    if (tbd.present[k]) s += String(temp_sensor_values[k]);
+    else s += "MISSING";
+    s += "/" + print_addr(tbd.addr[k]) + "\n";
   }
   return s;
   } // end
-
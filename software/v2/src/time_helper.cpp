@@ -0,0 +1,76 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "time_helper.h"
+
+/*
+Functions to convert between the calendar date and the number of seconds since 1970-01-01 00:00:00 (UTC).
+The conversion is done with integer arithmetic so that it can be used to compute the times of the RTC alarms.
+
+REFERENCE:
+http://howardhinnant.github.io/date_algorithms.html
+*/
+
+const int32_t SECONDS_PER_DAY = 86400L;
+
+
+// Number of days since 1970-01-01
+int32_t days_from_civil(int year, int month, int day)
+{
+    int32_t y = year - (month <= 2 ? 1 : 0);
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    int32_t yoe = y - era * 400;                                                  // [0, 399]
+    int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;       // [0, 365]
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                          // [0, 146096]
+    return era * 146097L + doe - 719468L;
+} // end
+
+
+// Calendar date from the number of days since 1970-01-01
+void civil_from_days(int32_t z, int &year, int &month, int &day)
+{
+    z += 719468L;
+    int32_t era = (z >= 0 ? z : z - 146096L) / 146097L;
+    int32_t doe = z - era * 146097L;                                              // [0, 146096]
+    int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;          // [0, 399]
+    int32_t y = yoe + era * 400;
+    int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                        // [0, 365]
+    int32_t mp = (5 * doy + 2) / 153;                                             // [0, 11]
+    day = doy - (153 * mp + 2) / 5 + 1;                                           // [1, 31]
+    month = mp < 10 ? mp + 3 : mp - 9;                                            // [1, 12]
+    year = y + (month <= 2 ? 1 : 0);
+} // end
+
+
+// Seconds since 1970-01-01 00:00:00
+uint32_t epoch_from_time(int day, int month, int year, int hour, int minute, int second)
+{
+    int32_t days = days_from_civil(year, month, day);
+    return (uint32_t)days * SECONDS_PER_DAY + hour * 3600UL + minute * 60UL + second;
+} // end
+
+
+// Calendar date and time from the seconds since 1970-01-01 00:00:00
+// dayNum is the day of the week (1 to 7, with 1 as Sunday)
+void time_from_epoch(uint32_t t, int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum)
+{
+    int32_t days = t / SECONDS_PER_DAY;
+    uint32_t s = t % SECONDS_PER_DAY;
+    civil_from_days(days, year, month, day);
+    hour = s / 3600;
+    minute = (s % 3600) / 60;
+    second = s % 60;
+    dayNum = (days + 4) % 7 + 1;    // 1970-01-01 was a Thursday
+} // end
+
+
+/*
+Time of the next sample at an interval of m minutes.
+The samples are aligned to multiples of m minutes since 1970-01-01 00:00:00,
+so that an interval that divides one day always samples at the same times each day.
+*/
+uint32_t next_interval_epoch(uint32_t now, uint32_t m)
+{
+    if (m == 0) m = 1;
+    uint32_t minutes = now / 60;
+    return (minutes / m + 1) * m * 60;
+} // end
@@ -0,0 +1,224 @@
+#include <Arduino.h>
+#include "time_service.h"
+#include "constants.h"
+#include "time_helper.h"
+#include "main_local.h"
+
+/*
+Time service that reads the DS3231 once and serves the time from the SAMD21 RTC counter.
+
+The SAMD21 RTC runs as a 32-bit counter at 1024 Hz from the 32.768 kHz crystal (XOSC32K / 32 on GCLK4).
+The counter, the generic clock and the crystal run in STANDBY, so the time is kept while the MCU sleeps.
+
+On a sync, the DS3231 seconds register is polled until it changes, so the counter is aligned to the start
+of the DS3231 second.  The time (seconds since 1970-01-01 00:00:00) and sub-second time are then computed from
+the counter without any I2C traffic.
+
+Every TIME_RESYNC_S seconds, the counter is aligned again by a task in the scheduler, so that reading the time
+never waits for the DS3231 (the time is read by FatFs and the records).  The task sleeps until just before the
+second that is expected from the counter and then reads the DS3231 seconds once for each pass of the main loop.
+
+Call time_service_sync() each time the DS3231 time is set (this waits for the DS3231 second).
+
+NOTE that the DS3231 alarms still read the DS3231, since the alarm needs the DS3231 time.
+
+REFERENCE:
+SAM D21 Family Data Sheet, Section 19 (RTC, Mode 0)
+*/
+
+static const uint8_t GCLK_TIME = 4;             // generic clock generator used to clock the RTC
+static const uint32_t TICKS_PER_S = 1024;       // XOSC32K divided by 32
+
+// Stages of the resync task
+enum resync_stage
+{
+    RESYNC_WAIT,            // waiting for the expected DS3231 second
+    RESYNC_FIRST,           // read the DS3231 seconds before the edge
+    RESYNC_POLL             // polling for the DS3231 seconds to change
+}; // end
+
+static struct time_service_data
+{
+    DS3231 *rtc;
+    bool synced;            // true if the counter has been aligned to the DS3231
+    uint32_t epoch;         // DS3231 time (s) when the counter was at count
+    uint32_t count;         // counter at the start of the second epoch
+    uint32_t attempt;       // counter at the last sync or resync attempt
+    int task;               // id of the resync task (NO_TASK if the task is not running)
+    resync_stage stage;
+    int s0;                 // DS3231 seconds before the edge
+    unsigned long start;    // millis() when the polling started
+} tsd;
+
+
+// Wait for the generic clock controller to synchronize
+static void gclk_sync()
+{
+    while (GCLK->STATUS.bit.SYNCBUSY);
+} // end
+
+
+// Wait for the RTC to synchronize
+static void rtc_sync()
+{
+    while (RTC->MODE0.STATUS.bit.SYNCBUSY);
+} // end
+
+
+// Value of the counter (the counter is read continuously)
+static uint32_t counter()
+{
+    return RTC->MODE0.COUNT.reg;
+} // end
+
+
+// Setup the RTC as a 32-bit counter at TICKS_PER_S
+static void setup_counter()
+{
+    SYSCTRL->XOSC32K.reg |= SYSCTRL_XOSC32K_RUNSTDBY;
+    PM->APBAMASK.reg |= PM_APBAMASK_RTC;
+
+    GCLK->GENDIV.reg = GCLK_GENDIV_ID(GCLK_TIME) | GCLK_GENDIV_DIV(32);
+    gclk_sync();
+    GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(GCLK_TIME) | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_XOSC32K | GCLK_GENCTRL_RUNSTDBY;
+    gclk_sync();
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(GCM_RTC) | GCLK_CLKCTRL_GEN(GCLK_TIME) | GCLK_CLKCTRL_CLKEN;
+    gclk_sync();
+
+    RTC->MODE0.CTRL.reg &= ~RTC_MODE0_CTRL_ENABLE;
+    rtc_sync();
+    RTC->MODE0.CTRL.reg = RTC_MODE0_CTRL_SWRST;
+    rtc_sync();
+    RTC->MODE0.CTRL.reg = RTC_MODE0_CTRL_MODE_COUNT32 | RTC_MODE0_CTRL_PRESCALER_DIV1;
+    rtc_sync();
+    RTC->MODE0.READREQ.reg = RTC_READREQ_RREQ | RTC_READREQ_RCONT | RTC_READREQ_ADDR(0x10);
+    RTC->MODE0.CTRL.reg |= RTC_MODE0_CTRL_ENABLE;
+    rtc_sync();
+} // end
+
+
+// Align the counter value c to the start of the DS3231 second
+static void time_service_align(uint32_t c)
+{
+    int day, month, year, hour, minute, second, dayNum;
+    tsd.rtc->getTime(day, month, year, hour, minute, second, dayNum);
+    tsd.epoch = epoch_from_time(day, month, year, hour, minute, second);
+    tsd.count = c;
+    tsd.attempt = c;
+    tsd.synced = true;
+} // end
+
+
+/*
+Task that aligns the counter to the DS3231 second without waiting in a loop.
+If the DS3231 seconds do not change within TIME_SYNC_EDGE_WAIT, the counter is kept until the next resync.
+*/
+static unsigned long time_service_resync_task()
+{
+    uint32_t c;
+    uint32_t ticks;
+    unsigned long left;
+    switch (tsd.stage)
+    {
+        case RESYNC_WAIT:
+            tsd.stage = RESYNC_FIRST;
+            if (!tsd.synced) return TASK_NOW;
+            ticks = TICKS_PER_S - (counter() - tsd.count) % TICKS_PER_S;
+            left = ticks * 1000 / TICKS_PER_S;
+            return left > TIME_SYNC_EDGE_GUARD ? left - TIME_SYNC_EDGE_GUARD : TASK_NOW;
+
+        case RESYNC_FIRST:
+            tsd.s0 = tsd.rtc->getSeconds();
+            tsd.start = millis();
+            tsd.stage = RESYNC_POLL;
+            return TASK_NOW;
+
+        case RESYNC_POLL:
+            c = counter();
+            if (tsd.rtc->getSeconds() != tsd.s0) time_service_align(c);
+            else if (millis() - tsd.start < TIME_SYNC_EDGE_WAIT) return TASK_NOW;
+            break;
+    }
+    tsd.task = NO_TASK;
+    return TASK_DONE;
+} // end
+
+
+// Start the resync task if the DS3231 has not been read for TIME_RESYNC_S
+static void time_service_resync_if_due()
+{
+    if (tsd.task != NO_TASK) return;
+    if (tsd.synced && counter() - tsd.attempt < TIME_RESYNC_S * TICKS_PER_S) return;
+    tsd.stage = RESYNC_WAIT;
+    tsd.task = scheduler.add(time_service_resync_task, TASK_NOW);
+    if (tsd.task != NO_TASK) tsd.attempt = counter();
+} // end
+
+
+void setup_time_service(DS3231 *rtc)
+{
+    tsd.rtc = rtc;
+    tsd.synced = false;
+    tsd.task = NO_TASK;
+    setup_counter();
+    time_service_sync();
+} // end
+
+
+/*
+Read the DS3231 and align the counter to the start of the DS3231 second.
+This can take up to one second.
+*/
+void time_service_sync()
+{
+    int s0 = tsd.rtc->getSeconds();
+    unsigned long start = millis();
+    while (tsd.rtc->getSeconds() == s0 && millis() - start < TIME_SYNC_EDGE_WAIT);
+    time_service_align(counter());
+} // end
+
+
+/*
+Time as seconds since 1970-01-01 00:00:00 and milliseconds into the second
+This does not read the DS3231, so the time can be read from any code without waiting.
+*/
+void time_service_now(uint32_t &epoch, uint16_t &ms)
+{
+    time_service_resync_if_due();
+    uint32_t ticks = counter() - tsd.count;
+    epoch = tsd.epoch + ticks / TICKS_PER_S;
+    ms = (ticks % TICKS_PER_S) * 1000 / TICKS_PER_S;
+} // end
+
+
+/*
+Time as seconds since 1970-01-01 00:00:00
+*/
+uint32_t time_service_epoch()
+{
+    uint32_t epoch;
+    uint16_t ms;
+    time_service_now(epoch, ms);
+    return epoch;
+} // end
+
+
+/*
+Time as milliseconds since 1970-01-01 00:00:00
+*/
+uint64_t time_service_epoch_ms()
+{
+    uint32_t epoch;
+    uint16_t ms;
+    time_service_now(epoch, ms);
+    return (uint64_t)epoch * 1000 + ms;
+} // end
+
+
+/*
+Calendar date and time (dayNum is the day of the week from 1 to 7, with 1 as Sunday)
+*/
+void time_service_time(int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum)
+{
+    time_from_epoch(time_service_epoch(), day, month, year, hour, minute, second, dayNum);
+} // end
@@ -0,0 +1,568 @@
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include "transfer_expr.h"
+#include "calibration.h"
+#include "constants.h"
+#include "flash_mem.h"
+#include "main_local.h"
+#include "fixed_format.h"
+#include "WaterWatcherOptions.h"
+
+/*
+Transfer functions written as expressions, such as:
+
+    a0 < 2.5 ? k1*exp(k2*a0) : k3
+
+The expression is compiled once (setup-transfer) to a stack bytecode that is stored in flash with the
+calibration of the channel, so each sample runs the bytecode without parsing the text or allocating memory.
+
+The expression can use:
+1. The raw values a0, a1, a2 and temp0.
+2. The named constants (set-constant), which are looked up when the expression is run,
+   so a constant can be changed without compiling the expression again.
+3. Numbers, + - * / (and unary -), the comparisons < > <= >= == != (1 if true, 0 if false),
+   c ? a : b, and the functions exp, log, sqrt, abs, pow, min and max.
+Both sides of c ? a : b are computed, since the bytecode has no jumps.
+
+The result is NO_SAMPLE_VALUE if any of the raw values used is a missing sample.
+
+Bytecode (one byte per operation):
+0x01 followed by the 4 bytes of a float pushes the number.
+0x02 followed by a signed byte pushes the integer (most of the numbers in the expressions are small integers).
+0x1v pushes raw value v and 0x2k pushes constant k.
+The other operations pop their arguments and push the result.
+
+The compiler and the interpreter are tested and timed against native code in test/test_transfer_expr (pio test -e native).
+*/
+
+static const uint8_t OP_NUM = 0x01;
+static const uint8_t OP_INT = 0x02;
+static const uint8_t OP_VAR = 0x10;
+static const uint8_t OP_CONST = 0x20;
+static const uint8_t OP_ADD = 0x30;
+static const uint8_t OP_SUB = 0x31;
+static const uint8_t OP_MUL = 0x32;
+static const uint8_t OP_DIV = 0x33;
+static const uint8_t OP_LT = 0x34;
+static const uint8_t OP_GT = 0x35;
+static const uint8_t OP_LE = 0x36;
+static const uint8_t OP_GE = 0x37;
+static const uint8_t OP_EQ = 0x38;
+static const uint8_t OP_NE = 0x39;
+static const uint8_t OP_POW = 0x3A;
+static const uint8_t OP_MIN = 0x3B;
+static const uint8_t OP_MAX = 0x3C;
+static const uint8_t OP_NEG = 0x40;
+static const uint8_t OP_EXP = 0x41;
+static const uint8_t OP_LOG = 0x42;
+static const uint8_t OP_SQRT = 0x43;
+static const uint8_t OP_ABS = 0x44;
+static const uint8_t OP_SELECT = 0x50;
+
+// Text of the binary operations (indexed by op - OP_ADD)
+static const char *const BINARY_NAMES[] = {"+", "-", "*", "/", "<", ">", "<=", ">=", "==", "!=", "pow", "min", "max"};
+// Text of the unary operations (indexed by op - OP_NEG)
+static const char *const UNARY_NAMES[] = {"-", "exp", "log", "sqrt", "abs"};
+
+static const struct
+{
+    const char *name;
+    uint8_t op;
+    uint8_t args;
+} FUNCTIONS[] = {{"exp", OP_EXP, 1}, {"log", OP_LOG, 1}, {"sqrt", OP_SQRT, 1}, {"abs", OP_ABS, 1},
+                 {"pow", OP_POW, 2}, {"min", OP_MIN, 2}, {"max", OP_MAX, 2}};
+static const size_t NUM_FUNCTIONS = sizeof(FUNCTIONS) / sizeof(FUNCTIONS[0]);
+
+
+/*
+Returns the number of values that the operation pops (-1 if the operation is not valid)
+*/
+static int op_args(uint8_t op)
+{
+    if (op == OP_NUM || op == OP_INT) return 0;
+    if ((op & 0xF0) == OP_VAR) return (op & 0x0F) < NUM_CAL_CHANNELS ? 0 : -1;
+    if ((op & 0xF0) == OP_CONST) return (op & 0x0F) < NUM_TRANSFER_CONSTANTS ? 0 : -1;
+    if (op >= OP_ADD && op <= OP_MAX) return 2;
+    if (op >= OP_NEG && op <= OP_ABS) return 1;
+    if (op == OP_SELECT) return 3;
+    return -1;
+} // end
+
+
+//------------------------------------------------
+// COMPILER
+//------------------------------------------------
+struct expr_parser
+{
+    const char *p;          // next character of the text
+    uint8_t *code;
+    size_t size;
+    size_t len;
+    size_t depth;           // depth of the stack after the code
+    size_t nest;            // nesting of the expressions (limits the recursion of the parser)
+    const char *error;      // first error (NULL if none)
+}; // end
+
+
+static void fail(expr_parser &e, const char *error)
+{
+    if (!e.error) e.error = error;
+} // end
+
+
+static void emit(expr_parser &e, uint8_t op)
+{
+    if (e.error) return;
+    if (e.len >= e.size)
+    {
+        fail(e, "expression is too long");
+        return;
+    }
+    e.code[e.len++] = op;
+    e.depth = e.depth + 1 - op_args(op);
+    if (e.depth > EXPR_MAX_STACK) fail(e, "expression is too deep");
+} // end
+
+
+static void emit_number(expr_parser &e, float v)
+{
+    bool is_int = v >= -128.0f && v <= 127.0f && v == (float)(int)v;
+    emit(e, is_int ? OP_INT : OP_NUM);
+    if (e.error) return;
+    size_t n = is_int ? 1 : sizeof(v);
+    if (e.len + n > e.size)
+    {
+        fail(e, "expression is too long");
+        return;
+    }
+    if (is_int) e.code[e.len] = (uint8_t)(int8_t)v;
+    else memcpy(e.code + e.len, &v, sizeof(v));
+    e.len += n;
+} // end
+
+
+static void skip_space(expr_parser &e)
+{
+    while (*e.p == ' ' || *e.p == '\t') e.p++;
+} // end
+
+
+// Consume the token if it is next
+static bool accept(expr_parser &e, const char *token)
+{
+    skip_space(e);
+    size_t n = strlen(token);
+    if (strncmp(e.p, token, n) != 0) return false;
+    e.p += n;
+    return true;
+} // end
+
+
+static void expect(expr_parser &e, const char *token)
+{
+    if (!accept(e, token)) fail(e, "syntax error");
+} // end
+
+
+static bool is_name_start(char c)
+{
+    return isalpha(c) || c == '_';
+} // end
+
+
+static bool is_name_char(char c)
+{
+    return isalnum(c) || c == '_';
+} // end
+
+
+// Returns the index of the constant with the name (n characters) or -1
+static int find_constant(const char *name, size_t n)
+{
+    for(size_t k = 0; k < NUM_TRANSFER_CONSTANTS; k++)
+    {
+        const char *s = get_constant_name(k);
+        if (s[0] && strlen(s) == n && strncmp(s, name, n) == 0) return k;
+    }
+    return -1;
+} // end
+
+
+// Returns true if the name (n characters) is a raw value or a function
+static bool is_reserved(const char *name, size_t n)
+{
+    for(size_t k = 0; k < NUM_CAL_CHANNELS; k++)
+    {
+        if (strlen(CAL_CHANNEL_NAMES[k]) == n && strncmp(CAL_CHANNEL_NAMES[k], name, n) == 0) return true;
+    }
+    for(size_t k = 0; k < NUM_FUNCTIONS; k++)
+    {
+        if (strlen(FUNCTIONS[k].name) == n && strncmp(FUNCTIONS[k].name, name, n) == 0) return true;
+    }
+    return false;
+} // end
+
+
+static void parse_ternary(expr_parser &e);
+
+
+// name, name(args), number or (expression)
+static void parse_primary(expr_parser &e)
+{
+    skip_space(e);
+    if (accept(e, "("))
+    {
+        parse_ternary(e);
+        expect(e, ")");
+        return;
+    }
+    if (isdigit(*e.p) || *e.p == '.')
+    {
+        char *end;
+        float v = strtof(e.p, &end);
+        if (end == e.p) fail(e, "syntax error");
+        e.p = end;
+        emit_number(e, v);
+        return;
+    }
+    if (!is_name_start(*e.p))
+    {
+        fail(e, "syntax error");
+        return;
+    }
+    const char *name = e.p;
+    while (is_name_char(*e.p)) e.p++;
+    size_t n = e.p - name;
+
+    for(size_t k = 0; k < NUM_FUNCTIONS; k++)
+    {
+        if (strlen(FUNCTIONS[k].name) != n || strncmp(FUNCTIONS[k].name, name, n) != 0) continue;
+        expect(e, "(");
+        for(uint8_t a = 0; a < FUNCTIONS[k].args; a++)
+        {
+            if (a) expect(e, ",");
+            parse_ternary(e);
+        }
+        expect(e, ")");
+        emit(e, FUNCTIONS[k].op);
+        return;
+    }
+    for(size_t k = 0; k < NUM_CAL_CHANNELS; k++)
+    {
+        if (strlen(CAL_CHANNEL_NAMES[k]) != n || strncmp(CAL_CHANNEL_NAMES[k], name, n) != 0) continue;
+        emit(e, OP_VAR | k);
+        return;
+    }
+    int k = find_constant(name, n);
+    if (k < 0)
+    {
+        fail(e, "unknown name (set-constant)");
+        return;
+    }
+    emit(e, OP_CONST | k);
+} // end
+
+
+static void parse_unary(expr_parser &e)
+{
+    bool neg = false;
+    while (!e.error)
+    {
+        if (accept(e, "-")) neg = !neg;
+        else if (!accept(e, "+")) break;
+    }
+    parse_primary(e);
+    if (neg) emit(e, OP_NEG);
+} // end
+
+
+static void parse_product(expr_parser &e)
+{
+    parse_unary(e);
+    while (!e.error)
+    {
+        uint8_t op;
+        if (accept(e, "*")) op = OP_MUL;
+        else if (accept(e, "/")) op = OP_DIV;
+        else return;
+        parse_unary(e);
+        emit(e, op);
+    }
+} // end
+
+
+static void parse_sum(expr_parser &e)
+{
+    parse_product(e);
+    while (!e.error)
+    {
+        uint8_t op;
+        if (accept(e, "+")) op = OP_ADD;
+        else if (accept(e, "-")) op = OP_SUB;
+        else return;
+        parse_product(e);
+        emit(e, op);
+    }
+} // end
+
+
+static void parse_compare(expr_parser &e)
+{
+    parse_sum(e);
+    while (!e.error)
+    {
+        uint8_t op;
+        // the two character tokens are checked first
+        if (accept(e, "<=")) op = OP_LE;
+        else if (accept(e, ">=")) op = OP_GE;
+        else if (accept(e, "==")) op = OP_EQ;
+        else if (accept(e, "!=")) op = OP_NE;
+        else if (accept(e, "<")) op = OP_LT;
+        else if (accept(e, ">")) op = OP_GT;
+        else return;
+        parse_sum(e);
+        emit(e, op);
+    }
+} // end
+
+
+static void parse_ternary(expr_parser &e)
+{
+    if (++e.nest > EXPR_MAX_STACK) fail(e, "expression is too deep");
+    if (e.error) return;
+    parse_compare(e);
+    if (!e.error && accept(e, "?"))
+    {
+        parse_ternary(e);
+        expect(e, ":");
+        parse_ternary(e);
+        emit(e, OP_SELECT);
+    }
+    e.nest--;
+} // end
+
+
+/*
+Compile the expression into code (at most size bytes).
+Returns NULL if the expression is compiled (len is the number of bytes) or the error.
+*/
+const char *expr_compile(const char *src, uint8_t *code, size_t size, size_t &len)
+{
+    expr_parser e = {src, code, size, 0, 0, 0, NULL};
+    len = 0;
+    if (strlen(src) >= MAX_STRING_SIZE_TRANSFER_FUNC) return "expression is too long";
+    parse_ternary(e);
+    skip_space(e);
+    if (*e.p) fail(e, "syntax error");
+    if (e.error) return e.error;
+    len = e.len;
+    return NULL;
+} // end
+
+
+//------------------------------------------------
+// INTERPRETER
+//------------------------------------------------
+
+/*
+Returns true if the code can be run (the operations are valid and use the stack correctly).
+The code read from flash is checked before it is run, so the interpreter does not check the stack.
+*/
+bool expr_valid(const uint8_t *code, size_t len)
+{
+    size_t depth = 0;
+    for(size_t pc = 0; pc < len; )
+    {
+        uint8_t op = code[pc++];
+        int args = op_args(op);
+        if (args < 0 || depth < (size_t)args) return false;
+        depth = depth + 1 - args;
+        if (depth > EXPR_MAX_STACK) return false;
+        size_t n = op == OP_NUM ? sizeof(float) : op == OP_INT ? 1 : 0;
+        if (pc + n > len) return false;
+        pc += n;
+    }
+    return depth == 1;
+} // end
+
+
+/*
+Run the code that was checked with expr_valid()
+var are the raw values {a0, a1, a2, temp0} and k are the values of the constants.
+*/
+float expr_eval(const uint8_t *code, size_t len, const float *var, const float *k)
+{
+    float s[EXPR_MAX_STACK];
+    size_t sp = 0;
+    for(size_t pc = 0; pc < len; )
+    {
+        uint8_t op = code[pc++];
+        switch(op & 0xF0)
+        {
+            case OP_VAR:
+                s[sp] = var[op & 0x0F];
+                if (s[sp++] == NO_SAMPLE_VALUE) return NO_SAMPLE_VALUE;
+                continue;
+            case OP_CONST:
+                s[sp++] = k[op & 0x0F];
+                continue;
+        }
+        switch(op)
+        {
+            case OP_NUM:    memcpy(&s[sp++], code + pc, sizeof(float)); pc += sizeof(float); break;
+            case OP_INT:    s[sp++] = (int8_t)code[pc++]; break;
+            case OP_ADD:    sp--; s[sp - 1] = s[sp - 1] + s[sp]; break;
+            case OP_SUB:    sp--; s[sp - 1] = s[sp - 1] - s[sp]; break;
+            case OP_MUL:    sp--; s[sp - 1] = s[sp - 1] * s[sp]; break;
+            case OP_DIV:    sp--; s[sp - 1] = s[sp - 1] / s[sp]; break;
+            case OP_LT:     sp--; s[sp - 1] = s[sp - 1] < s[sp] ? 1.0f : 0.0f; break;
+            case OP_GT:     sp--; s[sp - 1] = s[sp - 1] > s[sp] ? 1.0f : 0.0f; break;
+            case OP_LE:     sp--; s[sp - 1] = s[sp - 1] <= s[sp] ? 1.0f : 0.0f; break;
+            case OP_GE:     sp--; s[sp - 1] = s[sp - 1] >= s[sp] ? 1.0f : 0.0f; break;
+            case OP_EQ:     sp--; s[sp - 1] = s[sp - 1] == s[sp] ? 1.0f : 0.0f; break;
+            case OP_NE:     sp--; s[sp - 1] = s[sp - 1] != s[sp] ? 1.0f : 0.0f; break;
+            case OP_POW:    sp--; s[sp - 1] = powf(s[sp - 1], s[sp]); break;
+            case OP_MIN:    sp--; s[sp - 1] = fminf(s[sp - 1], s[sp]); break;
+            case OP_MAX:    sp--; s[sp - 1] = fmaxf(s[sp - 1], s[sp]); break;
+            case OP_NEG:    s[sp - 1] = -s[sp - 1]; break;
+            case OP_EXP:    s[sp - 1] = expf(s[sp - 1]); break;
+            case OP_LOG:    s[sp - 1] = logf(s[sp - 1]); break;
+            case OP_SQRT:   s[sp - 1] = sqrtf(s[sp - 1]); break;
+            case OP_ABS:    s[sp - 1] = fabsf(s[sp - 1]); break;
+            case OP_SELECT: sp -= 2; s[sp - 1] = s[sp - 1] != 0.0f ? s[sp] : s[sp + 1]; break;
+            default:        return NAN;
+        }
+    }
+    return s[0];
+} // end
+
+
+/*
+Returns true if the code uses constant k
+*/
+bool expr_uses_constant(const uint8_t *code, size_t len, size_t k)
+{
+    for(size_t pc = 0; pc < len; pc++)
+    {
+        if (code[pc] == OP_NUM) pc += sizeof(float);
+        else if (code[pc] == OP_INT) pc++;
+        else if (code[pc] == (OP_CONST | k)) return true;
+    }
+    return false;
+} // end
+
+
+// Text of the number that is read back to the same float (significant digits, see format_general())
+static String number_to_string(float v)
+{
+    char num[FIXED_FORMAT_SIZ];
+    format_general(v, num);
+    return String(num);
+} // end
+
+
+/*
+Returns the text of the code that was checked with expr_valid() (with the parentheses of each operation)
+*/
+String expr_to_string(const uint8_t *code, size_t len)
+{
+    String s[EXPR_MAX_STACK];
+    size_t sp = 0;
+    for(size_t pc = 0; pc < len; )
+    {
+        uint8_t op = code[pc++];
+        int args = op_args(op);
+        if ((op & 0xF0) == OP_VAR) s[sp++] = CAL_CHANNEL_NAMES[op & 0x0F];
+        else if ((op & 0xF0) == OP_CONST) s[sp++] = get_constant_name(op & 0x0F);
+        else if (op == OP_NUM)
+        {
+            float v;
+            memcpy(&v, code + pc, sizeof(v));
+            pc += sizeof(v);
+            s[sp++] = number_to_string(v);
+        }
+        else if (op == OP_INT) s[sp++] = String((int8_t)code[pc++]);
+        else if (op == OP_SELECT)
+        {
+            sp -= 2;
+            s[sp - 1] = "(" + s[sp - 1] + " ? " + s[sp] + " : " + s[sp + 1] + ")";
+        }
+        else if (args == 1)
+        {
+            s[sp - 1] = op == OP_NEG ? "-" + s[sp - 1] : String(UNARY_NAMES[op - OP_NEG]) + "(" + s[sp - 1] + ")";
+        }
+        else if (op >= OP_POW)
+        {
+            sp--;
+            s[sp - 1] = String(BINARY_NAMES[op - OP_ADD]) + "(" + s[sp - 1] + ", " + s[sp] + ")";
+        }
+        else
+        {
+            sp--;
+            s[sp - 1] = "(" + s[sp - 1] + " " + BINARY_NAMES[op - OP_ADD] + " " + s[sp] + ")";
+        }
+    }
+    return s[0];
+} // end
+
+
+//------------------------------------------------
+// CONSTANTS
+//------------------------------------------------
+
+/*
+Set the value of the named constant (the constant is added if it does not exist)
+CLI: set-constant [name] [value]
+*/
+bool set_transfer_constant(String name, float v)
+{
+    name.trim();
+    const char *s = name.c_str();
+    size_t n = name.length();
+    if (n == 0 || n >= MAX_CONSTANT_NAME || !is_name_start(s[0]) || is_reserved(s, n)) return false;
+    for(size_t k = 1; k < n; k++)
+    {
+        if (!is_name_char(s[k])) return false;
+    }
+    int k = find_constant(s, n);
+    for(size_t j = 0; k < 0 && j < NUM_TRANSFER_CONSTANTS; j++)
+    {
+        if (get_constant_name(j)[0] == '\0') k = j;
+    }
+    if (k < 0) return false;
+    set_constant(k, s, v);
+    return true;
+} // end
+
+
+/*
+Remove the named constant.  A constant that is used by an expression is not removed.
+CLI: del-constant [name]
+*/
+bool del_transfer_constant(String name)
+{
+    name.trim();
+    int k = find_constant(name.c_str(), name.length());
+    if (k < 0) return false;
+    for(size_t ch = 0; ch < NUM_CAL_CHANNELS; ch++)
+    {
+        const struct calibration &c = get_calibration(ch);
+        if (c.type == CAL_EXPR && expr_uses_constant(c.code, c.n, k)) return false;
+    }
+    set_constant(k, "", 0);
+    return true;
+} // end
+
+
+void print_transfer_constants()
+{
+    printSerial("CONSTANTS:");
+    const float *v = get_constant_values();
+    for(size_t k = 0; k < NUM_TRANSFER_CONSTANTS; k++)
+    {
+        const char *name = get_constant_name(k);
+        if (name[0]) printSerial(String(name) + ": " + number_to_string(v[k]));
+    }
+} // end
@@ -0,0 +1,144 @@
+#include <Arduino.h>
+#include "uplink.h"
+#include "constants.h"
+#include "cellular.h"
+#include "power_policy.h"
+#include "sd_storage.h"
+#include "main_local.h"
+#include "record.h"
+#include "safe_string.h"
+
+/*
+Uplink of the records over cellular.
+
+The records are sent in batches of get_policy_batch() records, so that the modem is woken and attached to the
+network less often when the battery is low.  The records that have not been sent are read back from the
+observation file on the SD card, so only the offset of the first record that has not been sent is kept in memory.
+Each record is streamed from the SD card to the modem, so the record is not held in RAM.
+If a record is not received by the server, the record is sent again with the next batch.
+
+The name of the observation file is kept with the offset when the batch is started, so the batch is read
+from the file that the records were written to.  If the name of the file changes while records are pending
+(such as with set-name), a new batch is started in the new file.
+
+A line at the end of the file without a line ending (such as a write that was cut off) is not sent.
+
+NOTE that the records that have not been sent before a reset or a change of the file are not sent (they remain on the SD card).
+*/
+
+static struct uplink_data
+{
+    size_t pending;                                 // number of records that have not been sent
+    uint32_t offset;                                // offset of the first record that has not been sent
+    uint32_t next;                                  // offset of the record after the record being sent
+    size_t session;                                 // records sent since the modem was woken
+    char fname[MAX_NUM_CHARS_SENSOR_NAME + sizeof(FILENAME_EXTENSION)];     // file of the pending records
+    struct main_data_storage record;                // copy of the record that could not be stored
+    bool record_sent;                               // true if the record has been received by the server
+} ud;
+
+
+// Write the next record from the observation file to out
+static bool uplink_next(RecordSink &out)
+{
+    if (ud.pending == 0 || ud.session >= MAX_UPLINK_RECORDS) return false;
+    if (!sd_stream_line(ud.fname, ud.offset, out, ud.next))
+    {
+        ud.pending = 0;     // the file has changed, so the records cannot be sent
+        return false;
+    }
+    return true;
+} // end
+
+
+// Called when the record has been received by the server
+static void uplink_sent()
+{
+    ud.offset = ud.next;
+    ud.pending--;
+    ud.session++;
+} // end
+
+
+// Format the record that could not be stored to out
+static bool uplink_record_next(RecordSink &out)
+{
+    if (ud.record_sent) return false;
+    record_write_json(ud.record, out);
+    return true;
+} // end
+
+
+static void uplink_record_sent()
+{
+    ud.record_sent = true;
+} // end
+
+
+void setup_uplink()
+{
+    ud.pending = 0;
+} // end
+
+
+/*
+Returns true if the record of the next sample will be sent.
+This is used to wake the modem at the start of the sample.
+*/
+bool uplink_due_next()
+{
+    return ud.pending + 1 >= get_policy_batch();
+} // end
+
+
+/*
+Call this function after the record d has been written to the observation file (get_name_of_file) at offset.
+stored is false if the record could not be written.
+If now is true, the records are sent without waiting for the batch to be complete.
+Returns true if the modem task has been started to send the records.
+If the record could not be stored, the record is copied, since the next sample can overwrite d while the
+modem task is sending.
+*/
+bool uplink_record(const struct main_data_storage &d, bool stored, uint32_t offset, bool now)
+{
+    if (!stored)
+    {
+        // the record cannot be read back from the SD card, so the record is formatted again as it is sent
+        ud.record = d;
+        ud.record_sent = false;
+        cell_task_send_records(uplink_record_next, uplink_record_sent);
+        return true;
+    }
+    char fname[sizeof(ud.fname)];
+    get_name_of_file(fname);
+    if (ud.pending != 0 && strcmp(fname, ud.fname) != 0)
+    {
+        char line[48];
+        snprintf(line, sizeof(line), "File changed, %u records not sent", (unsigned int)ud.pending);
+        printSerial(line);
+        ud.pending = 0;
+    }
+    if (ud.pending == 0)
+    {
+        ud.offset = offset;
+        strlcpy(ud.fname, fname, sizeof(ud.fname));
+    }
+    ud.pending++;
+    if (!now && ud.pending < get_policy_batch()) return false;
+
+    char line[32];
+    snprintf(line, sizeof(line), "Sending %u records", (unsigned int)ud.pending);
+    printSerial(line);
+    ud.session = 0;
+    cell_task_send_records(uplink_next, uplink_sent);
+    return true;
+} // end
+
+
+/*
+Returns the number of records that have not been sent
+*/
+size_t get_uplink_pending()
+{
+    return ud.pending;
+} // end
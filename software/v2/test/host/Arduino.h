@@ -0,0 +1,102 @@
+#pragma once
+/*
+Host replacement of the Arduino core for the native tests (see platformio.ini env:native).
+Only the parts of the core that are used by the modules in the native build are provided.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+
+// The Arduino core allocates the buffer of each String from the heap, so each String is counted by the
+// malloc wrap of env:native (see heap_check.cpp) even when std::string keeps short text in the object.
+class String
+{
+public:
+    String() { heap(); }
+    String(const String &o) : s(o.s) { heap(); }
+    String(const char *c) : s(c ? c : "") { heap(); }
+    String(const std::string &x) : s(x) { heap(); }
+    String(char c) : s(1, c) { heap(); }
+    String(unsigned char v, unsigned char base = 10) { format((unsigned long)v, base); }
+    String(int v, unsigned char base = 10) { format((long)v, base); }
+    String(unsigned int v, unsigned char base = 10) { format((unsigned long)v, base); }
+    String(long v, unsigned char base = 10) { format(v, base); }
+    String(unsigned long v, unsigned char base = 10) { format(v, base); }
+    String(float v, unsigned char places = 2) { format_float(v, places); }
+    String(double v, unsigned char places = 2) { format_float(v, places); }
+    String &operator=(const String &o) { s = o.s; return *this; }
+    const char *c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.size(); }
+    void trim()
+    {
+        size_t a = s.find_first_not_of(" \t\r\n");
+        size_t b = s.find_last_not_of(" \t\r\n");
+        s = a == std::string::npos ? "" : s.substr(a, b - a + 1);
+    }
+    void toCharArray(char *buf, unsigned int size) const
+    {
+        if (size == 0) return;
+        strncpy(buf, s.c_str(), size - 1);
+        buf[size - 1] = '\0';
+    }
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return atof(s.c_str()); }
+    String &operator+=(const String &o) { heap(); s += o.s; return *this; }
+    String &operator+=(const char *o) { heap(); s += o; return *this; }
+    String &operator+=(char o) { heap(); s += o; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+    friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.s); }
+    bool operator==(const String &o) const { return s == o.s; }
+    bool operator!=(const String &o) const { return s != o.s; }
+    bool operator==(const char *o) const { return s == o; }
+    bool operator!=(const char *o) const { return s != o; }
+    char operator[](unsigned int i) const { return s[i]; }
+    int indexOf(const String &o) const { size_t p = s.find(o.s); return p == std::string::npos ? -1 : (int)p; }
+    String substring(unsigned int a) const { return String(s.substr(a)); }
+    String substring(unsigned int a, unsigned int b) const { return String(s.substr(a, b - a)); }
+private:
+    static void heap()
+    {
+        void *volatile p = malloc(1);
+        free(p);
+    }
+    void format(long v, unsigned char base)
+    {
+        if (v < 0) { format((unsigned long)-v, base); s.insert(0, 1, '-'); }
+        else format((unsigned long)v, base);
+    }
+    void format(unsigned long v, unsigned char base)
+    {
+        char buf[72];
+        snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%lu", v);
+        s = buf;
+        heap();
+    }
+    void format_float(double v, int places)
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", places, v);
+        s = buf;
+        heap();
+    }
+    std::string s;
+}; // end
+
+// the serial ports are only passed to the constructors of the fakes
+class Stream {};
+extern Stream Serial1;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+#define DEC 10
+#define HEX 16
+enum { A0 = 15, A1, A2, A3, A4, A5, A6 };
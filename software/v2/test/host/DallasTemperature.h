@@ -0,0 +1,5 @@
+#pragma once
+#include <OneWire.h>
+
+// Host replacement of the DallasTemperature library with the constants used by the modules under test
+#define DEVICE_DISCONNECTED_C -127
@@ -0,0 +1,9 @@
+#pragma once
+#include <Arduino.h>
+
+// Host replacement of the OneWire library (the native tests do not use the bus)
+class OneWire
+{
+public:
+    OneWire(uint8_t pin) {}
+}; // end
@@ -0,0 +1,4 @@
+#pragma once
+
+// Host replacement of the TinyGPS++ library (the native tests do not parse NMEA)
+class TinyGPSPlus {};
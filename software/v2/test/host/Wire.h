@@ -0,0 +1,4 @@
+#pragma once
+#include <Arduino.h>
+
+// Host replacement of the Wire library (the native tests do not use the I2C bus)
@@ -0,0 +1,834 @@
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "host_fakes.h"
+#include "flash_mem.h"
+#include "main_local.h"
+#include "calibration.h"
+#include "sd_storage.h"
+#include "data_storage.h"
+#include "SimpleBBSerial.h"
+#include "SimpleTaskScheduler.h"
+#include "DS2438.h"
+#include "DS3231.h"
+#include "MaximUniqueSerial.h"
+#include "PCA9524Reader.h"
+#include "GPS.h"
+#include "gps_manager.h"
+#include "gpio.h"
+#include "time_service.h"
+#include "temperature1w.h"
+#include <DallasTemperature.h>
+#include "cellular.h"
+#include "record_sink.h"
+#include "WaterWatcher.h"
+#include "arena.h"
+
+/*
+Fakes of the modules that use the hardware, so that the modules under test
+(transfer functions, calibrations, record serializers and the sample task) are built and run on the host.
+Only the functions used by the modules in env:native (platformio.ini) are provided.
+
+The sensors return fixed values, the SD card is held in RAM (HOST_SD_FILES files), and the modem task
+sends the records to a buffer in RAM when the sample task polls the task.
+*/
+
+static const size_t HOST_SD_FILES = 4;
+static const size_t HOST_SD_FILE_SIZ = 8192;
+static const size_t HOST_UPLINK_SIZ = 8192;
+static const uint64_t HOST_EPOCH_MS = 1792368000000ULL;     // time of the RTC when the program starts
+
+// contents of the flash (see FlashData in flash_mem.cpp)
+static struct host_flash_data
+{
+    char name[MAX_NUM_CHARS_SENSOR_NAME];
+    char key[MAX_NUM_CHARS_KEY_NAME];
+    int num;
+    struct calibration cal[NUM_CAL_CHANNELS];
+    char const_name[NUM_TRANSFER_CONSTANTS][MAX_CONSTANT_NAME];
+    float const_value[NUM_TRANSFER_CONSTANTS];
+} hfd = {"host", "key", 1};
+
+struct host_settings_data host_settings = {false, true, false, false, 0.0f, false};
+
+// files of the SD card
+static struct host_sd_data
+{
+    char name[HOST_SD_FILES][MAX_NUM_CHARS_SENSOR_NAME + 8];
+    char data[HOST_SD_FILES][HOST_SD_FILE_SIZ];
+    UINT size[HOST_SD_FILES];
+} hsd;
+
+// records sent by the modem task
+static struct host_cell_data
+{
+    cell_record_next next;
+    cell_record_sent sent;
+    bool busy;
+    char text[HOST_UPLINK_SIZ];
+    size_t len;
+} hcd;
+
+SimpleTaskScheduler scheduler;
+Stream Serial1;
+
+static WaterWatcherOptions default_options;
+static WaterWatcherOptions *options = &default_options;
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+
+void host_set_options(WaterWatcherOptions *opt)
+{
+    options = opt ? opt : &default_options;
+} // end
+
+void host_set_name(const char *name)
+{
+    strncpy(hfd.name, name, sizeof(hfd.name) - 1);
+    hfd.name[sizeof(hfd.name) - 1] = '\0';
+} // end
+
+void host_clear_sd()
+{
+    memset(&hsd, 0, sizeof(hsd));
+    hcd.busy = false;
+    hcd.len = 0;
+    hcd.text[0] = '\0';
+} // end
+
+const char *host_sd_file(const char *name)
+{
+    for(size_t k = 0; k < HOST_SD_FILES; k++)
+    {
+        if (strcmp(hsd.name[k], name) == 0) return hsd.data[k];
+    }
+    return NULL;
+} // end
+
+const char *host_uplink_text()
+{
+    return hcd.text;
+} // end
+
+void host_clear_flash()
+{
+    for(size_t ch = 0; ch < NUM_CAL_CHANNELS; ch++) calibration_clear(hfd.cal[ch]);
+    memset(hfd.const_name, 0, sizeof(hfd.const_name));
+    memset(hfd.const_value, 0, sizeof(hfd.const_value));
+} // end
+
+//-------------------------------------------------------------------------------------------
+// Arduino core
+
+unsigned long millis()
+{
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+} // end
+
+unsigned long micros()
+{
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+} // end
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+} // end
+
+//-------------------------------------------------------------------------------------------
+// main_local.h
+
+void printSerial(const char *s)
+{
+    printf("%s\n", s);
+} // end
+
+void printSerial(const String &s)
+{
+    printSerial(s.c_str());
+} // end
+
+void printSerialWithoutLineEnding(const char *s)
+{
+    printf("%s", s);
+} // end
+
+void printSerialWithoutLineEnding(const String &s)
+{
+    printSerialWithoutLineEnding(s.c_str());
+} // end
+
+WaterWatcherOptions *get_options()
+{
+    return options;
+} // end
+
+//-------------------------------------------------------------------------------------------
+// flash_mem.h
+
+char *get_sensor_name_str()
+{
+    return hfd.name;
+} // end
+
+char *get_key()
+{
+    return hfd.key;
+} // end
+
+int get_num()
+{
+    return hfd.num;
+} // end
+
+void set_calibration(size_t ch, const struct calibration &c)
+{
+    if (ch < NUM_CAL_CHANNELS) hfd.cal[ch] = c;
+} // end
+
+const struct calibration &get_calibration(size_t ch)
+{
+    return hfd.cal[ch < NUM_CAL_CHANNELS ? ch : 0];
+} // end
+
+void set_constant(size_t k, const char *name, float v)
+{
+    if (k >= NUM_TRANSFER_CONSTANTS) return;
+    strncpy(hfd.const_name[k], name, MAX_CONSTANT_NAME - 1);
+    hfd.const_name[k][MAX_CONSTANT_NAME - 1] = '\0';
+    hfd.const_value[k] = v;
+} // end
+
+const char *get_constant_name(size_t k)
+{
+    return hfd.const_name[k];
+} // end
+
+const float *get_constant_values()
+{
+    return hfd.const_value;
+} // end
+
+bool get_power_profile_on()
+{
+    return false;
+} // end
+
+String get_sensor_name()
+{
+    return String(hfd.name);
+} // end
+
+bool get_send_cell()
+{
+    return host_settings.send_cell;
+} // end
+
+bool get_sd_json()
+{
+    return host_settings.sd_json;
+} // end
+
+bool get_policy_on()
+{
+    return host_settings.policy_on;
+} // end
+
+bool get_event_on()
+{
+    return host_settings.event_on;
+} // end
+
+int get_event_m()
+{
+    return 1;
+} // end
+
+int get_event_cooldown()
+{
+    return 2;
+} // end
+
+void get_event_limits(size_t ch, float &hi, float &rate, float &k, float &h)
+{
+    hi = host_settings.event_hi;
+    rate = k = h = 0;
+} // end
+
+bool get_shutdown_rails()
+{
+    return false;
+} // end
+
+int get_m()
+{
+    return 15;
+} // end
+
+bool get_alarm_on()
+{
+    return false;
+} // end
+
+void set_m_flash(int m)
+{
+} // end
+
+void set_alarm_state_flash(bool state)
+{
+} // end
+
+//-------------------------------------------------------------------------------------------
+// main_local.h and gpio.h
+
+transfer_outputs_fn get_transfer_outputs()
+{
+    return ww_transfer_outputs<WaterWatcherOptions>;
+} // end
+
+bool check_is_ext_on()
+{
+    return true;
+} // end
+
+void turn_on_5V_ext()
+{
+} // end
+
+void off_sd_card()
+{
+} // end
+
+void set_m(int m)
+{
+} // end
+
+int get_m_alarm()
+{
+    return 15;
+} // end
+
+void attach_alarm_interrupt()
+{
+} // end
+
+void detach_alarm_interrupt()
+{
+} // end
+
+//-------------------------------------------------------------------------------------------
+// Sensors
+
+void get_turbidity(float &v)
+{
+    v = 1.25f;
+} // end
+
+void get_tds(float &v)
+{
+    v = 0.75f;
+} // end
+
+Vector<String, 0> temp_sensor_names;
+Vector<float, 0> temp_sensor_values;
+Vector<float, 0> temp_sensor_tf_out;
+
+// three probes on the bus, and the vectors are sized by the search (as in temperature1w.cpp)
+void setup_temperature()
+{
+    temp_sensor_values.resize(3);
+    temp_sensor_tf_out.resize(3);
+} // end
+
+unsigned long start_temperature_conversion()
+{
+    return TASK_NOW;
+} // end
+
+bool read_temperature_conversion()
+{
+    temp_sensor_values[0] = 12.5f;
+    temp_sensor_values[1] = 8.0625f;
+    temp_sensor_values[2] = DEVICE_DISCONNECTED_C;
+    return true;
+} // end
+
+bool populate_values_temp_sensor()
+{
+    return read_temperature_conversion();
+} // end
+
+size_t get_temperature_probe_count()
+{
+    return temp_sensor_values.size();
+} // end
+
+void get_water_temperature_last(float &temperature_C, bool &temp_good)
+{
+    temperature_C = temp_sensor_values.size() ? temp_sensor_values[0] : DEVICE_DISCONNECTED_C;
+    temp_good = temperature_C != DEVICE_DISCONNECTED_C;
+} // end
+
+void invalidate_temperature_bus()
+{
+} // end
+
+MaximUniqueSerial::MaximUniqueSerial(uint8_t addr) : addr(addr)
+{
+} // end
+
+bool MaximUniqueSerial::getChars(char *s, size_t size)
+{
+    snprintf(s, size, "%s", "26 161 178 195 212 229 246 7");
+    return true;
+} // end
+
+bool MaximUniqueSerial::getString(String &s)
+{
+    s = String("26 161 178 195 212 229 246 7");
+    return true;
+} // end
+
+PCA9534Reader::PCA9534Reader(uint8_t addr) : addr(addr)
+{
+} // end
+
+uint8_t PCA9534Reader::readState()
+{
+    return host_settings.charging ? 0x01 : 0x03;     // #FAULT is high, #CHRG is low when charging
+} // end
+
+// one battery monitor on the bus
+DS2438::DS2438(uint8_t pin, float senseR, bool pp) : w(pin), cached(false), senseR(senseR), pp(pp), pin(pin)
+{
+} // end
+
+void DS2438::findAll()
+{
+    addresses.clear();
+    addresses.push_back(wAddr());
+    cached = true;
+} // end
+
+bool DS2438::findIfRequired()
+{
+    if (!cached) findAll();
+    return true;
+} // end
+
+void DS2438::invalidate()
+{
+    cached = false;
+} // end
+
+String DS2438::allAddressString()
+{
+    return String("26 0 0 0 0 0 0 0");
+} // end
+
+bool DS2438::getData(size_t k, DS2438Info &info)
+{
+    if (k >= addresses.size()) return false;
+    snprintf(info.astring, sizeof(info.astring), "%s", "26 0 0 0 0 0 0 0");
+    info.temperature = 21.5f;
+    info.voltage = 3.98f;
+    info.current = -0.012f;
+    info.uptime = 3600;
+    info.capacity = 1.75f;
+    info.vad_voltage = 2.5f;
+    return true;
+} // end
+
+void DS2438::getDataAll(Vector<DS2438Info> &output)
+{
+    output.clear();
+    DS2438Info info;
+    for(size_t k = 0; k < addresses.size(); k++)
+    {
+        if (getData(k, info)) output.push_back(info);
+    }
+} // end
+
+void DS2438::getDataVAD(Vector<DS2438VAD> &output)
+{
+    output.clear();
+    DS2438VAD v;
+    snprintf(v.astring, sizeof(v.astring), "%s", "26 0 0 0 0 0 0 0");
+    v.vad = 2.5f;
+    for(size_t k = 0; k < addresses.size(); k++) output.push_back(v);
+} // end
+
+bool DS2438::readCurrent(float &current)
+{
+    current = -0.012f;
+    return true;
+} // end
+
+//-------------------------------------------------------------------------------------------
+// RTC and time service (the time is HOST_EPOCH_MS when the program starts)
+
+DS3231::DS3231(uint8_t addr) : addr(addr)
+{
+} // end
+
+float DS3231::readTemperature()
+{
+    return 21.25f;
+} // end
+
+bool DS3231::setTime(int day, int month, int year, int hour, int minute, int second)
+{
+    return true;
+} // end
+
+bool DS3231::setAlarmNextInterval(int m, uint32_t &next)
+{
+    next = 0;
+    return true;
+} // end
+
+bool DS3231::setRTCDefaultTime()
+{
+    return true;
+} // end
+
+void DS3231::setDefaultIfOscStopped()
+{
+} // end
+
+uint8_t DS3231::readStatus()
+{
+    return 0;
+} // end
+
+void DS3231::clearAlarms()
+{
+} // end
+
+void DS3231::offAlarms()
+{
+} // end
+
+bool DS3231::isAlarmOn()
+{
+    return false;
+} // end
+
+int8_t DS3231::getAgingOffset()
+{
+    return 0;
+} // end
+
+void DS3231::setAgingOffset(int8_t offset)
+{
+} // end
+
+void setup_time_service(DS3231 *rtc)
+{
+} // end
+
+void time_service_sync()
+{
+} // end
+
+uint64_t time_service_epoch_ms()
+{
+    return HOST_EPOCH_MS + millis();
+} // end
+
+uint32_t time_service_epoch()
+{
+    return (uint32_t)(time_service_epoch_ms() / 1000);
+} // end
+
+void time_service_time(int &day, int &month, int &year, int &hour, int &minute, int &second, int &dayNum)
+{
+    uint32_t t = time_service_epoch() - (uint32_t)(HOST_EPOCH_MS / 1000);
+    day = 18;
+    month = 10;
+    year = 2026;
+    hour = t / 3600 % 24;
+    minute = t / 60 % 60;
+    second = t % 60;
+    dayNum = 1;
+} // end
+
+//-------------------------------------------------------------------------------------------
+// GPS (a good fix for every sample)
+
+GPS::GPS(Stream *serial) : serial(serial)
+{
+} // end
+
+void GPS::start_poll()
+{
+} // end
+
+void GPS::end_poll()
+{
+} // end
+
+void GPS::run_poll()
+{
+} // end
+
+void GPS::feed()
+{
+} // end
+
+bool GPS::read_data(unsigned long timeout_ms)
+{
+    return false;
+} // end
+
+void GPS::obtain_gps_data(struct last_gps_fix *d)
+{
+} // end
+
+static void host_gps_fix(struct last_gps_fix &f)
+{
+    memset(&f, 0, sizeof(f));
+    f.lat = 52.1332f;
+    f.lng = -106.67f;
+    f.alt = 482.0f;
+    f.hdop = 0.9f;
+    f.satellites = 9;
+    f.fix_quality = 1;
+    f.day = 18;
+    f.month = 10;
+    f.year = 2026;
+    f.good = true;
+    f.rx_ms = millis();
+} // end
+
+void gps_begin_sample()
+{
+} // end
+
+bool gps_poll_fix(struct last_gps_fix &f, bool &reused)
+{
+    host_gps_fix(f);
+    reused = false;
+    return true;
+} // end
+
+void gps_get_fix(struct last_gps_fix &f, bool &reused)
+{
+    gps_poll_fix(f, reused);
+} // end
+
+void gps_end_sample(bool shutdown_rails)
+{
+} // end
+
+long gps_get_ttff()
+{
+    return 31000;
+} // end
+
+uint64_t gps_fix_epoch_ms(const struct last_gps_fix &f)
+{
+    return time_service_epoch_ms() - (millis() - f.rx_ms) + 12;
+} // end
+
+unsigned long gps_take_on_time()
+{
+    return 31000;
+} // end
+
+//-------------------------------------------------------------------------------------------
+// arena.h (the arena of the firmware uses the symbols of the linker script of the SAMD21)
+
+void *arena_alloc(arena_region r, size_t size)
+{
+    static uint8_t arena[ARENA_SD_SIZ + ARENA_CLI_SIZ];
+    static size_t used = 0;
+    size = (size + 3) & ~(size_t)3;
+    if (used + size > sizeof(arena)) return NULL;
+    used += size;
+    return arena + used - size;
+} // end
+
+//-------------------------------------------------------------------------------------------
+// SD card (FatFs) in RAM.  obj.id of the file object is the index of the file + 1.
+
+static FRESULT host_find(const TCHAR *path, size_t &k)
+{
+    for(k = 0; k < HOST_SD_FILES; k++)
+    {
+        if (strcmp(hsd.name[k], path) == 0) return FR_OK;
+    }
+    return FR_NO_FILE;
+} // end
+
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt)
+{
+    return FR_OK;
+} // end
+
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode)
+{
+    size_t k;
+    if (host_find(path, k) != FR_OK)
+    {
+        if (!(mode & (FA_OPEN_ALWAYS | FA_CREATE_ALWAYS))) return FR_NO_FILE;
+        if (host_find("", k) != FR_OK || strlen(path) >= sizeof(hsd.name[k])) return FR_DENIED;
+        strcpy(hsd.name[k], path);
+        hsd.size[k] = 0;
+    }
+    if (mode & FA_CREATE_ALWAYS) hsd.size[k] = 0;
+    memset(fp, 0, sizeof(*fp));
+    fp->obj.id = k + 1;
+    fp->obj.objsize = hsd.size[k];
+    return FR_OK;
+} // end
+
+FRESULT f_close(FIL *fp)
+{
+    fp->obj.id = 0;
+    return FR_OK;
+} // end
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+    *bw = 0;
+    if (fp->obj.id == 0) return FR_INVALID_OBJECT;
+    size_t k = fp->obj.id - 1;
+    if (fp->fptr + btw >= HOST_SD_FILE_SIZ) return FR_DENIED;      // the data is always terminated
+    memcpy(hsd.data[k] + fp->fptr, buff, btw);
+    fp->fptr += btw;
+    if (fp->fptr > hsd.size[k]) hsd.size[k] = fp->fptr;
+    hsd.data[k][hsd.size[k]] = '\0';
+    fp->obj.objsize = hsd.size[k];
+    *bw = btw;
+    return FR_OK;
+} // end
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br)
+{
+    *br = 0;
+    if (fp->obj.id == 0) return FR_INVALID_OBJECT;
+    size_t k = fp->obj.id - 1;
+    if (fp->fptr >= hsd.size[k]) return FR_OK;
+    UINT n = hsd.size[k] - fp->fptr;
+    if (n > btr) n = btr;
+    memcpy(buff, hsd.data[k] + fp->fptr, n);
+    fp->fptr += n;
+    *br = n;
+    return FR_OK;
+} // end
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs)
+{
+    if (fp->obj.id == 0) return FR_INVALID_OBJECT;
+    fp->fptr = ofs;
+    return FR_OK;
+} // end
+
+FRESULT f_sync(FIL *fp)
+{
+    return fp->obj.id ? FR_OK : FR_INVALID_OBJECT;
+} // end
+
+int f_puts(const TCHAR *str, FIL *fp)
+{
+    UINT bw;
+    if (f_write(fp, str, strlen(str), &bw) != FR_OK) return -1;
+    return bw;
+} // end
+
+TCHAR *f_gets(TCHAR *buff, int len, FIL *fp)
+{
+    int n = 0;
+    UINT br;
+    while (n < len - 1 && f_read(fp, buff + n, 1, &br) == FR_OK && br == 1)
+    {
+        if (buff[n++] == '\n') break;
+    }
+    buff[n] = '\0';
+    return n ? buff : NULL;
+} // end
+
+FRESULT f_stat(const TCHAR *path, FILINFO *fno)
+{
+    size_t k;
+    if (host_find(path, k) != FR_OK) return FR_NO_FILE;
+    fno->fsize = hsd.size[k];
+    return FR_OK;
+} // end
+
+FRESULT f_unlink(const TCHAR *path)
+{
+    size_t k;
+    if (host_find(path, k) != FR_OK) return FR_NO_FILE;
+    hsd.name[k][0] = '\0';
+    return FR_OK;
+} // end
+
+FRESULT f_rename(const TCHAR *path_old, const TCHAR *path_new)
+{
+    size_t k;
+    size_t j;
+    if (host_find(path_old, k) != FR_OK) return FR_NO_FILE;
+    if (host_find(path_new, j) == FR_OK) return FR_EXIST;
+    if (strlen(path_new) >= sizeof(hsd.name[k])) return FR_INVALID_NAME;
+    strcpy(hsd.name[k], path_new);
+    return FR_OK;
+} // end
+
+FRESULT f_opendir(DIR *dp, const TCHAR *path)
+{
+    return FR_NOT_READY;
+} // end
+
+FRESULT f_closedir(DIR *dp)
+{
+    return FR_OK;
+} // end
+
+FRESULT f_readdir(DIR *dp, FILINFO *fno)
+{
+    return FR_NOT_READY;
+} // end
+
+//-------------------------------------------------------------------------------------------
+// Modem task.  The records are sent when the sample task polls cell_task_busy().
+
+void cell_task_start()
+{
+} // end
+
+void cell_task_send_records(cell_record_next next, cell_record_sent sent)
+{
+    hcd.next = next;
+    hcd.sent = sent;
+    hcd.busy = true;
+} // end
+
+void cell_task_abort()
+{
+    hcd.busy = false;
+} // end
+
+bool cell_task_busy()
+{
+    if (!hcd.busy) return false;
+    hcd.busy = false;
+    for(;;)
+    {
+        RecordBufferSink out(hcd.text + hcd.len, sizeof(hcd.text) - hcd.len);
+        if (!hcd.next(out) || !out.good()) break;
+        hcd.len += out.length();
+        if (hcd.len + 1 < sizeof(hcd.text)) hcd.text[hcd.len++] = '\n';
+        hcd.text[hcd.len] = '\0';
+        hcd.sent();
+    }
+    return false;
+} // end
+
+bool SimpleBBSerial::sendChars(const char *s, size_t n)
+{
+    return false;
+} // end
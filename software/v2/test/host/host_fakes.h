@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include "WaterWatcherOptions.h"
+
+/*
+Fakes of the hardware modules for the native tests (see host_fakes.cpp).
+The flash and the SD card are held in RAM and the serial output is printed to stdout.
+*/
+
+// settings of the flash that the tests change
+struct host_settings_data
+{
+    bool send_cell;
+    bool sd_json;
+    bool policy_on;
+    bool event_on;
+    float event_hi;         // threshold of each event channel (0 is off)
+    bool charging;          // state of the charger read from the port expander
+};
+extern struct host_settings_data host_settings;
+
+void host_set_options(WaterWatcherOptions *opt);
+void host_clear_flash();
+void host_set_name(const char *name);
+void host_clear_sd();
+const char *host_sd_file(const char *name);
+const char *host_uplink_text();
@@ -0,0 +1,10 @@
+#pragma once
+
+// Host replacement of minmea with the types used in the headers (the native tests do not parse NMEA)
+struct minmea_time
+{
+    int hours;
+    int minutes;
+    int seconds;
+    int microseconds;
+};
@@ -0,0 +1,235 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fixed_format.h"
+#include "jWrite.h"
+
+/*
+format_fixed() against printf("%.*f") on the host.
+format_fixed() rounds exact ties half up while printf() rounds them to even, so the text can only differ
+when the value scaled to the decimal places has a fraction of exactly one half.
+format_general() against printf("%.9g"), and the text of format_general() is read back to the same float.
+*/
+
+static const size_t NUM_RANDOM = 2000000;
+
+// xorshift32, so that the values are the same for each run
+static uint32_t rng = 0x2545F491;
+static uint32_t next_random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+} // end
+
+// Random float from 1e-9 to 2^64 (the range without an exponent) with a random sign
+static float random_float()
+{
+    uint32_t r = next_random();
+    uint32_t exponent = 97 + next_random() % (190 - 97 + 1);
+    uint32_t bits = (r & 0x807FFFFF) | (exponent << 23);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+} // end
+
+// true if v scaled by 10^precision is exactly halfway between two integers
+// (the float has 24 bits and 10^9 < 2^30, so the product is exact in a long double)
+static bool is_tie(float v, uint8_t precision)
+{
+    long double x = fabsl((long double)v);
+    for (uint8_t k = 0; k < precision; k++) x *= 10;
+    return x - floorl(x) == 0.5L;
+} // end
+
+// true if the text of format_fixed() is the text of printf()
+static bool same_as_printf(float v, uint8_t precision)
+{
+    char a[FIXED_FORMAT_SIZ];
+    char b[FIXED_FORMAT_SIZ];
+    snprintf(a, sizeof(a), "%.*f", precision, (double)v);
+    size_t n = format_fixed(v, precision, b);
+    return n == strlen(b) && strcmp(a, b) == 0;
+} // end
+
+// true if the text is the same as printf() or only differs by the rounding of an exact tie
+static bool matches_printf(float v, uint8_t precision)
+{
+    return same_as_printf(v, precision) || is_tie(v, precision);
+} // end
+
+
+void setUp()
+{
+} // end
+
+void tearDown()
+{
+} // end
+
+
+void test_record_values()
+{
+    static const float VALUES[] = {1.2345f, 0.0f, -999.0f, 20.5f, 52.1f, -106.634f, 3.7123f, 0.0042f, 123.45f, 1013.25f};
+    static const uint8_t PRECISION[] = {4, 4, 4, 3, 6, 6, 3, 4, 2, 1};
+    for (size_t k = 0; k < sizeof(VALUES) / sizeof(VALUES[0]); k++)
+    {
+        TEST_ASSERT_TRUE(matches_printf(VALUES[k], PRECISION[k]));
+    }
+} // end
+
+void test_special_values()
+{
+    char out[FIXED_FORMAT_SIZ];
+    format_fixed(NAN, 2, out);
+    TEST_ASSERT_EQUAL_STRING("nan", out);
+    format_fixed(INFINITY, 2, out);
+    TEST_ASSERT_EQUAL_STRING("inf", out);
+    format_fixed(-INFINITY, 2, out);
+    TEST_ASSERT_EQUAL_STRING("-inf", out);
+    format_fixed(-0.001f, 2, out);
+    TEST_ASSERT_EQUAL_STRING("-0.00", out);
+    format_fixed(0.999999f, 3, out);
+    TEST_ASSERT_EQUAL_STRING("1.000", out);
+    format_fixed(1.0e-45f, 9, out);                 // subnormal
+    TEST_ASSERT_EQUAL_STRING("0.000000000", out);
+    format_fixed(0.125f, 2, out);                   // tie rounded up (printf gives 0.12)
+    TEST_ASSERT_EQUAL_STRING("0.13", out);
+    format_fixed(1.5f, 12, out);                    // precision is limited
+    TEST_ASSERT_EQUAL_STRING("1.500000000", out);
+    format_fixed(4.0e19f, 2, out);                  // 2^64 or more (the digits are from float divisions)
+    TEST_ASSERT_EQUAL_STRING("e+12", out + 8);
+    TEST_ASSERT_FLOAT_WITHIN(1.0e-6, 1.0, strtod(out, NULL) / 4.0e19);
+} // end
+
+void test_random_floats()
+{
+    size_t ties = 0;
+    for (size_t k = 0; k < NUM_RANDOM; k++)
+    {
+        float v = random_float();
+        uint8_t precision = k % (FIXED_FORMAT_MAX_PRECISION + 1);
+        if (same_as_printf(v, precision)) continue;
+        if (!is_tie(v, precision))
+        {
+            char line[80];
+            snprintf(line, sizeof(line), "%.9g to %u places does not match printf", (double)v, precision);
+            TEST_FAIL_MESSAGE(line);
+        }
+        ties++;
+    }
+    char line[64];
+    snprintf(line, sizeof(line), "%u values, %u exact ties", (unsigned int)NUM_RANDOM, (unsigned int)ties);
+    TEST_MESSAGE(line);
+} // end
+
+// true if the float has exactly FIXED_FORMAT_DIGITS + 1 significant digits and the last digit is 5
+static bool is_general_tie(float v)
+{
+    char a[64];
+    char b[64];
+    snprintf(a, sizeof(a), "%.*e", FIXED_FORMAT_DIGITS, (double)v);
+    snprintf(b, sizeof(b), "%.*e", FIXED_FORMAT_DIGITS + 20, (double)v);
+    char *ea = strchr(a, 'e');
+    if (ea == NULL || ea[-1] != '5') return false;
+    size_t n = ea - a;
+    if (strncmp(a, b, n) != 0) return false;
+    for (const char *p = b + n; *p != 'e'; p++) if (*p != '0') return false;
+    return true;
+} // end
+
+void test_general_values()
+{
+    char out[FIXED_FORMAT_SIZ];
+    format_general(0.0f, out);
+    TEST_ASSERT_EQUAL_STRING("0", out);
+    format_general(-2.0f, out);
+    TEST_ASSERT_EQUAL_STRING("-2", out);
+    format_general(0.1f, out);
+    TEST_ASSERT_EQUAL_STRING("0.100000001", out);
+    format_general(1.0e-7f, out);
+    TEST_ASSERT_EQUAL_STRING("1.00000001e-07", out);
+    format_general(123456789.0f, out);
+    TEST_ASSERT_EQUAL_STRING("123456792", out);
+    format_general(4.0e19f, out);
+    TEST_ASSERT_EQUAL_STRING("3.99999999e+19", out);
+    format_general(1.0e-45f, out);                  // subnormal
+    TEST_ASSERT_EQUAL_STRING("1.40129846e-45", out);
+    format_general(NAN, out);
+    TEST_ASSERT_EQUAL_STRING("nan", out);
+} // end
+
+// Random bits (all exponents) against printf("%.9g") and strtof()
+void test_general_random()
+{
+    size_t ties = 0;
+    for (size_t k = 0; k < NUM_RANDOM; k++)
+    {
+        uint32_t bits = next_random();
+        if (((bits >> 23) & 0xFF) == 0xFF) continue;       // NaN and infinity
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        char a[FIXED_FORMAT_SIZ];
+        char b[FIXED_FORMAT_SIZ];
+        size_t n = format_general(v, b);
+        TEST_ASSERT_EQUAL_size_t(strlen(b), n);
+        if (strtof(b, NULL) != v)
+        {
+            char line[80];
+            snprintf(line, sizeof(line), "%s is not read back to %.9g", b, (double)v);
+            TEST_FAIL_MESSAGE(line);
+        }
+        snprintf(a, sizeof(a), "%.9g", (double)v);
+        if (strcmp(a, b) == 0) continue;
+        if (!is_general_tie(v))
+        {
+            char line[80];
+            snprintf(line, sizeof(line), "%s does not match printf %s", b, a);
+            TEST_FAIL_MESSAGE(line);
+        }
+        ties++;
+    }
+    char line[64];
+    snprintf(line, sizeof(line), "%u values, %u exact ties", (unsigned int)NUM_RANDOM, (unsigned int)ties);
+    TEST_MESSAGE(line);
+} // end
+
+// Time of format_fixed() against the JSON formatter (modp_dtoa2) and printf() on the host
+void test_time()
+{
+    static float values[NUM_RANDOM];
+    char out[FIXED_FORMAT_SIZ];
+    volatile size_t sink = 0;
+    for (size_t k = 0; k < NUM_RANDOM; k++) values[k] = random_float() * 1.0e-12f;     // below 1e8 for modp_dtoa2
+
+    unsigned long t0 = micros();
+    for (size_t k = 0; k < NUM_RANDOM; k++) { modp_dtoa2(values[k], out, k % 7); sink += out[0]; }
+    unsigned long t1 = micros();
+    for (size_t k = 0; k < NUM_RANDOM; k++) sink += snprintf(out, sizeof(out), "%.*f", (int)(k % 7), (double)values[k]);
+    unsigned long t2 = micros();
+    for (size_t k = 0; k < NUM_RANDOM; k++) sink += format_fixed(values[k], k % 7, out);
+    unsigned long t3 = micros();
+
+    char line[96];
+    snprintf(line, sizeof(line), "ns per value: modp_dtoa2 %.1f, printf %.1f, format_fixed %.1f",
+        1000.0 * (t1 - t0) / NUM_RANDOM, 1000.0 * (t2 - t1) / NUM_RANDOM, 1000.0 * (t3 - t2) / NUM_RANDOM);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(sink > 0);
+} // end
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_record_values);
+    RUN_TEST(test_special_values);
+    RUN_TEST(test_random_floats);
+    RUN_TEST(test_general_values);
+    RUN_TEST(test_general_random);
+    RUN_TEST(test_time);
+    return UNITY_END();
+} // end
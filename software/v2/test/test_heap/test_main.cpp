@@ -0,0 +1,285 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <stdlib.h>
+#include <new>
+#include "heap_check.h"
+#include "host_fakes.h"
+#include "WaterWatcher.h"
+#include "calibration.h"
+#include "transfer_expr.h"
+#include "record.h"
+#include "record_sink.h"
+#include "experiment.h"
+#include "uplink.h"
+#include "power_policy.h"
+#include "event_detect.h"
+#include "sd_storage.h"
+#include "flash_mem.h"
+#include "temperature1w.h"
+#include "SimpleTaskScheduler.h"
+
+/*
+The sample must not use the heap (see heap_check.cpp).
+1. The sample task is run by the scheduler from start_experiment() to the end of the sample, so the allocations
+   of populate -> transfer functions -> record -> SD card -> modem are counted by heap_check_begin() and
+   heap_check_end() in sample_task().  The sensors, the SD card and the modem are fakes (see host_fakes.cpp).
+2. The transfer functions and the serializers are also run with calibrations and missing values.
+
+The native environment wraps malloc(), calloc() and realloc() with the linker as the mkrzero_heap environment does.
+The operator new of the C++ library on the host calls the malloc() of the shared C library, which the linker
+does not wrap, so new and delete are replaced here with calls to the wrapped functions.
+*/
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+} // end
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+} // end
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+} // end
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+} // end
+
+void operator delete(void *p, size_t size) noexcept
+{
+    free(p);
+} // end
+
+void operator delete[](void *p, size_t size) noexcept
+{
+    free(p);
+} // end
+
+
+static const unsigned long SAMPLE_TIMEOUT = 10000;     // ms for the sample task to finish
+
+static WaterWatcherOptions opt;
+static struct main_data_storage d;
+static char record[2048];
+
+
+// Run the sample task as the main loop does, and return the allocations counted in the sample
+static size_t run_sample_task()
+{
+    start_experiment();
+    unsigned long start = millis();
+    while (is_experiment_running() && millis() - start < SAMPLE_TIMEOUT) scheduler.run();
+    TEST_ASSERT_FALSE(is_experiment_running());
+    return heap_check_end();        // the count of the sample is kept until the next heap_check_begin()
+} // end
+
+
+// Returns the lines of the file on the SD card without the line endings
+static const char *sd_file(const char *extension, char *text, size_t size)
+{
+    char fname[MAX_NUM_CHARS_SENSOR_NAME + 8];
+    snprintf(fname, sizeof(fname), "%s%s", get_sensor_name_str(), extension);
+    const char *data = host_sd_file(fname);
+    if (data == NULL) return NULL;
+    size_t n = 0;
+    for(; *data && n + 1 < size; data++)
+    {
+        if (*data != '\r') text[n++] = *data;
+    }
+    text[n] = '\0';
+    return text;
+} // end
+
+// sampled values of the simulated sensors
+static void simulate_sensors(struct main_data_storage &d)
+{
+    memset(&d, 0, sizeof(d));
+    d.a0_voltage = 1.25f;
+    d.a1_voltage = 0.75f;
+    d.a2_voltage = 2.5f;
+    d.water_temperature = 12.5f;
+    d.num_temp_sensors = 3;
+    d.temperature[0] = 12.5f;
+    d.temperature[1] = 8.0625f;
+    d.temperature[2] = NO_SAMPLE_VALUE;
+    strcpy(d.serial_number, "26 A1 B2 C3 D4 E5 F6 07");
+    d.serial_number_good = true;
+    d.rtc_temperature = 21.25f;
+    d.gdata.lat = 52.1332f;
+    d.gdata.lng = -106.67f;
+    d.gdata.good = true;
+    d.gdata.satellites = 9;
+    d.gdata.year = 2026;
+    d.gps_ttff = 31000;
+    d.pp_valid = true;
+    d.pp_mah[0] = 0.0123f;
+    d.start_time = 1792368000000ULL;
+    d.end_time = 1792368042000ULL;
+    d.rtc_gps_offset_valid = true;
+    d.rtc_gps_offset = -12;
+    d.bvoltage = 3.98f;
+} // end
+
+
+// the sample after the sensors are read (see STAGE_STORE in sample_task())
+static size_t run_sample()
+{
+    ww_transfer_outputs<WaterWatcherOptions>(&opt, d);
+    RecordBufferSink json(record, sizeof(record));
+    RecordCrcSink crc;
+    RecordTeeSink tee(json, crc);
+    size_t n = record_write_json(d, tee);
+    RecordBufferSink csv(record, sizeof(record));
+    n += record_write_csv(d, csv);
+    RecordCrcSink binary;
+    n += record_write_binary(d, binary);
+    return n;
+} // end
+
+
+void setUp()
+{
+    host_clear_flash();
+    host_clear_sd();
+    host_set_name("host");
+    host_set_options(&opt);
+    host_settings.send_cell = true;
+    host_settings.sd_json = true;
+    host_settings.policy_on = false;
+    host_settings.event_on = false;
+    host_settings.event_hi = 0.0f;
+    host_settings.charging = false;
+    set_startup_setup_sd();
+    setup_temperature();
+    setup_uplink();
+    setup_experiment();
+    setup_power_policy();
+    setup_event_detect();
+    simulate_sensors(d);
+} // end
+
+void tearDown()
+{
+} // end
+
+
+void test_counter_sees_allocations()
+{
+    // volatile so that the compiler does not remove the allocations
+    heap_check_begin();
+    void *volatile p = malloc(16);
+    free(p);
+    int *volatile q = new int(1);
+    delete q;
+    String s = String("a String that is longer than the small buffer ") + String(1);
+    TEST_ASSERT_TRUE(heap_check_end() >= 3);
+    TEST_ASSERT_TRUE(s.length() > 0);
+} // end
+
+void test_sample_task_json()
+{
+    TEST_ASSERT_EQUAL_size_t(0, run_sample_task());
+    char text[4096];
+    TEST_ASSERT_NOT_NULL(sd_file(FILENAME_EXTENSION, text, sizeof(text)));
+    TEST_ASSERT_TRUE(strstr(text, "26 161 178 195 212 229 246 7") != NULL);     // from MaximUniqueSerial
+    TEST_ASSERT_TRUE(strstr(text, "3.98") != NULL);                             // from DS2438
+    TEST_ASSERT_EQUAL_STRING(text, host_uplink_text());                         // the record is read back to be sent
+} // end
+
+void test_sample_task_csv()
+{
+    host_settings.sd_json = false;
+    TEST_ASSERT_EQUAL_size_t(0, run_sample_task());
+    TEST_ASSERT_EQUAL_size_t(0, run_sample_task());
+    char text[4096];
+    TEST_ASSERT_NOT_NULL(sd_file(CSV_FILENAME_EXTENSION, text, sizeof(text)));
+    const char *second = strchr(text, '\n');
+    TEST_ASSERT_NOT_NULL(second);
+    TEST_ASSERT_NOT_NULL(strchr(second + 1, '\n'));                             // header and two records
+    TEST_ASSERT_TRUE(strlen(host_uplink_text()) > 0);                         // the records are formatted again to be sent
+} // end
+
+void test_sample_task_csv_header_changed()
+{
+    host_settings.sd_json = false;
+    host_settings.send_cell = false;
+    host_set_name("old");       // the header of host.csv has been checked by the test above
+    TEST_ASSERT_TRUE(sd_write_text_to_file("old.csv", "columns of an older firmware"));
+    TEST_ASSERT_EQUAL_size_t(0, run_sample_task());
+    TEST_ASSERT_EQUAL_size_t(0, run_sample_task());
+    TEST_ASSERT_EQUAL_STRING("columns of an older firmware\r\n", host_sd_file("old-1.csv"));
+    char text[4096];
+    TEST_ASSERT_NOT_NULL(sd_file(CSV_FILENAME_EXTENSION, text, sizeof(text)));
+    TEST_ASSERT_NOT_NULL(strstr(text, "lat"));                                  // new header
+    TEST_ASSERT_NULL(host_sd_file("old-2.csv"));                                // the file is only rotated once
+} // end
+
+void test_sample_task_with_logs()
+{
+    host_settings.policy_on = true;
+    host_settings.charging = true;
+    host_settings.event_on = true;
+    host_settings.event_hi = 1.0f;
+    TEST_ASSERT_EQUAL_size_t(0, run_sample_task());
+    char text[1024];
+    TEST_ASSERT_NOT_NULL(sd_file(POLICY_LOG_EXTENSION, text, sizeof(text)));
+    TEST_ASSERT_TRUE(strstr(text, "policy=") != NULL);
+    TEST_ASSERT_TRUE(strstr(text, "event start") != NULL);
+} // end
+
+void test_sample_without_calibrations()
+{
+    heap_check_begin();
+    size_t n = run_sample();
+    TEST_ASSERT_EQUAL_size_t(0, heap_check_end());
+    TEST_ASSERT_TRUE(n > 0);
+} // end
+
+void test_sample_with_calibrations()
+{
+    TEST_ASSERT_TRUE(setup_calibration(CAL_A0, "poly", 3, 0));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A0, 1, 2.0f));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A0, 2, 0.5f));
+    TEST_ASSERT_TRUE(setup_calibration(CAL_A1, "pwl", 2, 0));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A1, 2, 1.0f));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A1, 3, 10.0f));
+    TEST_ASSERT_TRUE(set_transfer_constant("k1", 0.25f));
+    TEST_ASSERT_NULL(setup_calibration_expr(CAL_A2, "a2 < 2 ? k1*exp(a2) : sqrt(a2) + temp0/10"));
+    heap_check_begin();
+    size_t n = run_sample();
+    TEST_ASSERT_EQUAL_size_t(0, heap_check_end());
+    TEST_ASSERT_TRUE(n > 0);
+} // end
+
+void test_sample_with_missing_values()
+{
+    TEST_ASSERT_NULL(setup_calibration_expr(CAL_A0, "a0/(a1 - 0.75)"));
+    d.a2_voltage = NO_SAMPLE_VALUE;
+    d.water_temperature = NO_SAMPLE_VALUE;
+    heap_check_begin();
+    size_t n = run_sample();
+    TEST_ASSERT_EQUAL_size_t(0, heap_check_end());
+    TEST_ASSERT_TRUE(n > 0);
+} // end
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_counter_sees_allocations);
+    RUN_TEST(test_sample_task_json);
+    RUN_TEST(test_sample_task_csv);
+    RUN_TEST(test_sample_task_csv_header_changed);
+    RUN_TEST(test_sample_task_with_logs);
+    RUN_TEST(test_sample_without_calibrations);
+    RUN_TEST(test_sample_with_calibrations);
+    RUN_TEST(test_sample_with_missing_values);
+    return UNITY_END();
+} // end
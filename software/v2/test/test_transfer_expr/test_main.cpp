@@ -0,0 +1,278 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "host_fakes.h"
+#include "transfer_expr.h"
+#include "calibration.h"
+#include "constants.h"
+#include "flash_mem.h"
+
+/*
+Compiler and interpreter of the transfer expressions (transfer_expr.cpp), and the time of the interpreter
+against the same function compiled into the program.
+*/
+
+static uint8_t code[CAL_MAX_CODE];
+static size_t len;
+static float var[NUM_CAL_CHANNELS];
+
+// Compile the expression and check the code (the test fails if the expression is not compiled)
+static void compile(const char *src)
+{
+    const char *error = expr_compile(src, code, sizeof(code), len);
+    TEST_ASSERT_NULL(error);
+    TEST_ASSERT_TRUE(expr_valid(code, len));
+} // end
+
+static float eval(const char *src)
+{
+    compile(src);
+    return expr_eval(code, len, var, get_constant_values());
+} // end
+
+static const char *compile_error(const char *src)
+{
+    const char *error = expr_compile(src, code, sizeof(code), len);
+    return error ? error : "";
+} // end
+
+
+void setUp()
+{
+    host_clear_flash();
+    var[CAL_A0] = 1.25f;
+    var[CAL_A1] = 0.75f;
+    var[CAL_A2] = 2.5f;
+    var[CAL_TEMP0] = 12.5f;
+} // end
+
+void tearDown()
+{
+} // end
+
+
+void test_arithmetic()
+{
+    TEST_ASSERT_EQUAL_FLOAT(7.0f, eval("1 + 2*3"));
+    TEST_ASSERT_EQUAL_FLOAT(9.0f, eval("(1 + 2)*3"));
+    TEST_ASSERT_EQUAL_FLOAT(-6.0f, eval("-2*3"));
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, eval("2 - -1"));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, eval("8 - 4 - 3"));
+    TEST_ASSERT_EQUAL_FLOAT(2.5f, eval("10/4"));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, eval("8/4/2"));
+    TEST_ASSERT_EQUAL_FLOAT(150.0f, eval("1.5e2"));
+    TEST_ASSERT_EQUAL_FLOAT(0.25f, eval(".25"));
+    TEST_ASSERT_EQUAL_FLOAT(-200.0f, eval("-200"));
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, eval("+1000"));
+} // end
+
+// small integers are stored in one byte and the other numbers as a float
+void test_numbers()
+{
+    compile("127");
+    TEST_ASSERT_EQUAL_size_t(2, len);
+    compile("-128");                                // 128 and the negation
+    TEST_ASSERT_EQUAL_size_t(6, len);
+    compile("-127");
+    TEST_ASSERT_EQUAL_size_t(3, len);
+    compile("128");
+    TEST_ASSERT_EQUAL_size_t(5, len);
+    compile("0.5");
+    TEST_ASSERT_EQUAL_size_t(5, len);
+} // end
+
+void test_compare_and_select()
+{
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, eval("a0 < 2"));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, eval("a0 > 2"));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, eval("a0 <= 1.25"));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, eval("a0 >= 1.25"));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, eval("a0 == 1.25"));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, eval("a0 != 1.25"));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, eval("1 + 1 == 2"));
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, eval("a0 < 2 ? 10 : 20"));
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, eval("a0 > 2 ? 10 : 20"));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, eval("a0 > 1 ? a1 > 1 ? 3 : 2 : 1"));
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, eval("a0 > 2 ? 5 : a1 > 0.5 ? 4 : 3"));
+} // end
+
+void test_functions()
+{
+    TEST_ASSERT_EQUAL_FLOAT(expf(1.25f), eval("exp(a0)"));
+    TEST_ASSERT_EQUAL_FLOAT(logf(2.5f), eval("log(a2)"));
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, eval("sqrt(9)"));
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, eval("abs(-4)"));
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, eval("pow(2, 3)"));
+    TEST_ASSERT_EQUAL_FLOAT(0.75f, eval("min(a0, a1)"));
+    TEST_ASSERT_EQUAL_FLOAT(1.25f, eval("max(a0, a1)"));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, eval("max(min(3, 2), sqrt(abs(-1)))"));
+    TEST_ASSERT_TRUE(isnan(eval("log(-1)")));
+    TEST_ASSERT_TRUE(isinf(eval("1/0")));
+} // end
+
+void test_raw_values()
+{
+    TEST_ASSERT_EQUAL_FLOAT(1.25f + 0.75f + 2.5f + 12.5f, eval("a0 + a1 + a2 + temp0"));
+    var[CAL_A1] = NO_SAMPLE_VALUE;
+    TEST_ASSERT_EQUAL_FLOAT(NO_SAMPLE_VALUE, eval("a0 + a1"));
+    TEST_ASSERT_EQUAL_FLOAT(NO_SAMPLE_VALUE, eval("a0 > 0 ? a0 : a1"));     // both sides are computed
+    TEST_ASSERT_EQUAL_FLOAT(2.5f, eval("a0*2"));
+} // end
+
+void test_constants()
+{
+    TEST_ASSERT_TRUE(set_transfer_constant("k1", 1.5f));
+    TEST_ASSERT_TRUE(set_transfer_constant(" k_2 ", 0.2f));
+    TEST_ASSERT_EQUAL_FLOAT(1.5f * expf(0.2f * 1.25f), eval("a0 < 2.5 ? k1*exp(k_2*a0) : 3"));
+
+    // the constant is looked up when the code is run
+    TEST_ASSERT_TRUE(set_transfer_constant("k1", 3.0f));
+    TEST_ASSERT_EQUAL_FLOAT(3.0f * expf(0.2f * 1.25f), expr_eval(code, len, var, get_constant_values()));
+
+    TEST_ASSERT_FALSE(set_transfer_constant("a0", 1.0f));
+    TEST_ASSERT_FALSE(set_transfer_constant("exp", 1.0f));
+    TEST_ASSERT_FALSE(set_transfer_constant("1k", 1.0f));
+    TEST_ASSERT_FALSE(set_transfer_constant("k-1", 1.0f));
+    TEST_ASSERT_FALSE(set_transfer_constant("", 1.0f));
+    TEST_ASSERT_FALSE(set_transfer_constant("k1234567", 1.0f));       // MAX_CONSTANT_NAME includes the terminator
+    TEST_ASSERT_TRUE(set_transfer_constant("k123456", 1.0f));
+
+    // a constant that is used by a calibration is not removed
+    TEST_ASSERT_NULL(setup_calibration_expr(CAL_A0, "k1*a0"));
+    TEST_ASSERT_FALSE(del_transfer_constant("k1"));
+    TEST_ASSERT_TRUE(del_transfer_constant("k_2"));
+    TEST_ASSERT_FALSE(del_transfer_constant("k_2"));
+    TEST_ASSERT_EQUAL_STRING("unknown name (set-constant)", compile_error("k_2*a0"));
+} // end
+
+void test_all_constants_used()
+{
+    char name[MAX_CONSTANT_NAME];
+    for (size_t k = 0; k < NUM_TRANSFER_CONSTANTS; k++)
+    {
+        snprintf(name, sizeof(name), "c%u", (unsigned int)k);
+        TEST_ASSERT_TRUE(set_transfer_constant(name, (float)k));
+    }
+    TEST_ASSERT_FALSE(set_transfer_constant("full", 1.0f));
+    TEST_ASSERT_TRUE(set_transfer_constant("c0", 10.0f));              // an existing constant can be changed
+} // end
+
+void test_errors()
+{
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error(""));
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error("1 +"));
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error("(1 + 2"));
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error("1 2"));
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error("a0 ? 1"));
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error("pow(2)"));
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error("exp 2"));
+    TEST_ASSERT_EQUAL_STRING("syntax error", compile_error("a0 # 2"));
+    TEST_ASSERT_EQUAL_STRING("unknown name (set-constant)", compile_error("a3"));
+    TEST_ASSERT_EQUAL_STRING("expression is too deep", compile_error("((((((((((1))))))))))"));
+    TEST_ASSERT_EQUAL_STRING("expression is too deep", compile_error("1+(1+(1+(1+(1+(1+(1+(1+(1+1))))))))"));
+
+    // the code of each number is 5 bytes, so 13 numbers do not fit into CAL_MAX_CODE
+    TEST_ASSERT_EQUAL_STRING("expression is too long",
+        compile_error("0.5+0.5+0.5+0.5+0.5+0.5+0.5+0.5+0.5+0.5+0.5+0.5+0.5"));
+    char src[MAX_STRING_SIZE_TRANSFER_FUNC + 1];
+    memset(src, ' ', MAX_STRING_SIZE_TRANSFER_FUNC);
+    src[0] = '1';
+    src[MAX_STRING_SIZE_TRANSFER_FUNC] = '\0';
+    TEST_ASSERT_EQUAL_STRING("expression is too long", compile_error(src));
+} // end
+
+// The code read from flash is checked before it is run
+void test_valid()
+{
+    compile("a0 < 2.5 ? 1.5*exp(0.2*a0) : 3");
+    TEST_ASSERT_TRUE(expr_valid(code, len));
+    TEST_ASSERT_FALSE(expr_valid(code, 0));
+    TEST_ASSERT_FALSE(expr_valid(code, len - 1));                   // without the select
+    TEST_ASSERT_FALSE(expr_valid(code, 3));                         // part of the float 2.5
+    const uint8_t bad_op[] = {0x02, 1, 0xFF};
+    TEST_ASSERT_FALSE(expr_valid(bad_op, sizeof(bad_op)));
+    const uint8_t underflow[] = {0x02, 1, 0x30};
+    TEST_ASSERT_FALSE(expr_valid(underflow, sizeof(underflow)));
+    const uint8_t two_results[] = {0x02, 1, 0x02, 2};
+    TEST_ASSERT_FALSE(expr_valid(two_results, sizeof(two_results)));
+    const uint8_t partial_float[] = {0x01, 0, 0};
+    TEST_ASSERT_FALSE(expr_valid(partial_float, sizeof(partial_float)));
+} // end
+
+// The text of the code compiles to the same code
+void test_to_string()
+{
+    TEST_ASSERT_TRUE(set_transfer_constant("k1", 1.5f));
+    static const char *const EXPRESSIONS[] =
+    {
+        "a0 < 2.5 ? k1*exp(0.2*a0) : 3",
+        "-a0 + -(a1 - 2)*0.125",
+        "pow(a2, 2)/max(temp0, 1) != min(a1, -3)",
+        "sqrt(abs(a0)) >= log(10) == (a1 <= 300.75)",
+        "a0 > 1 ? a1 > 1 ? 3 : 2 : temp0",
+        "a0*1.5e-7 + 123456.789*a1 - 0.1"         // the numbers need the significant digits to be read back
+    };
+    uint8_t again[CAL_MAX_CODE];
+    size_t again_len;
+    for (size_t k = 0; k < sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]); k++)
+    {
+        compile(EXPRESSIONS[k]);
+        String text = expr_to_string(code, len);
+        TEST_ASSERT_NULL(expr_compile(text.c_str(), again, sizeof(again), again_len));
+        TEST_ASSERT_EQUAL_size_t(len, again_len);
+        TEST_ASSERT_TRUE(memcmp(code, again, len) == 0);
+    }
+    compile("a0*2 + 1");
+    TEST_ASSERT_EQUAL_STRING("((a0 * 2) + 1)", expr_to_string(code, len).c_str());
+} // end
+
+// The example transfer function against the same function compiled into the program
+void test_time_against_native()
+{
+    static const int NUM = 1000000;
+    auto native = [](float a0) { return a0 < 2.5f ? 1.5f * expf(0.2f * a0) : 3.0f; };
+    compile("a0 < 2.5 ? 1.5*exp(0.2*a0) : 3");
+    volatile float sink = 0.0f;
+
+    unsigned long t0 = micros();
+    for (int r = 0; r < NUM; r++)
+    {
+        var[CAL_A0] = r * (5.0f / NUM);
+        sink = sink + expr_eval(code, len, var, get_constant_values());
+    }
+    unsigned long t1 = micros();
+    for (int r = 0; r < NUM; r++) sink = sink + native(r * (5.0f / NUM));
+    unsigned long t2 = micros();
+
+    int mismatch = 0;
+    for (int r = 0; r < NUM; r++)
+    {
+        var[CAL_A0] = r * (5.0f / NUM);
+        if (expr_eval(code, len, var, get_constant_values()) != native(var[CAL_A0])) mismatch++;
+    }
+    TEST_ASSERT_EQUAL_INT(0, mismatch);
+
+    char line[96];
+    snprintf(line, sizeof(line), "%u bytes, ns per value: expression %.1f, native %.1f",
+        (unsigned int)len, 1000.0 * (t1 - t0) / NUM, 1000.0 * (t2 - t1) / NUM);
+    TEST_MESSAGE(line);
+} // end
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_arithmetic);
+    RUN_TEST(test_numbers);
+    RUN_TEST(test_compare_and_select);
+    RUN_TEST(test_functions);
+    RUN_TEST(test_raw_values);
+    RUN_TEST(test_constants);
+    RUN_TEST(test_all_constants_used);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_valid);
+    RUN_TEST(test_to_string);
+    RUN_TEST(test_time_against_native);
+    return UNITY_END();
+} // end
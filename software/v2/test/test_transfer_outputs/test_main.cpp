@@ -0,0 +1,178 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_fakes.h"
+#include "WaterWatcher.h"
+#include "calibration.h"
+#include "record.h"
+#include "record_sink.h"
+
+/*
+The outputs of the transfer functions reach the record (see ww_transfer_outputs() in WaterWatcher.h):
+the overrides of an options class with both dispatches, the calibrations stored in flash and the probes {t1, t2,...}.
+*/
+
+// Transfer functions of the sketch (see MyWaterWatcherOptions in main.cpp)
+class TestOptions : public WaterWatcherOptions
+{
+public:
+    float get_a0_out() { return 2.0f * get_a0_raw() + 1.0f; }
+    float get_temp0_out() { return get_temp0_raw() - 0.5f; }
+    float get_temp_out(size_t k) { return k == 0 ? get_temp0_out() : get_temp_raw(k) + 100.0f; }
+}; // end
+
+static struct main_data_storage d;
+static char json[2048];
+static char csv[2048];
+
+static void simulate_sensors(struct main_data_storage &d)
+{
+    memset(&d, 0, sizeof(d));
+    d.a0_voltage = 1.25f;
+    d.a1_voltage = 0.75f;
+    d.a2_voltage = 2.5f;
+    d.water_temperature = 12.5f;
+    d.num_temp_sensors = 2;
+    d.temperature[0] = 12.5f;
+    d.temperature[1] = 8.0f;
+    d.a0_out = d.a1_out = d.a2_out = d.water_temperature_out = NO_SAMPLE_VALUE;
+} // end
+
+// Run the transfer functions and write the record
+template <class Options>
+static void run_sample(Options &opt)
+{
+    host_set_options(&opt);
+    simulate_sensors(d);
+    ww_transfer_outputs<Options>(&opt, d);
+    RecordBufferSink j(json, sizeof(json));
+    TEST_ASSERT_TRUE(record_write_json(d, j) > 0);
+    RecordBufferSink c(csv, sizeof(csv));
+    TEST_ASSERT_TRUE(record_write_csv(d, c) > 0);
+} // end
+
+// Text of the value of the key in the JSON record, or "" if the key is not in the record
+static const char *json_value(const char *key)
+{
+    static char value[32];
+    char pattern[40];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(json, pattern);
+    value[0] = '\0';
+    if (p == NULL) return value;
+    p += strlen(pattern);
+    size_t n = strcspn(p, ",}");
+    if (n >= sizeof(value)) n = sizeof(value) - 1;
+    memcpy(value, p, n);
+    value[n] = '\0';
+    return value;
+} // end
+
+// Text of the column of the key in the CSV record
+static const char *csv_value(const char *key)
+{
+    static char header[2048];
+    static char value[32];
+    RecordBufferSink h(header, sizeof(header));
+    record_write_csv_header(h);
+    size_t column = 0;
+    for (const char *p = header; ; p++)
+    {
+        size_t n = strcspn(p, ",");
+        if (n == strlen(key) && strncmp(p, key, n) == 0) break;
+        p += n;
+        column++;
+        if (*p == '\0') return "";
+    }
+    const char *p = csv;
+    for (size_t k = 0; k < column; k++) p = strchr(p, ',') + 1;
+    size_t n = strcspn(p, ",");
+    if (n >= sizeof(value)) n = sizeof(value) - 1;
+    memcpy(value, p, n);
+    value[n] = '\0';
+    return value;
+} // end
+
+
+void setUp()
+{
+    host_clear_flash();
+} // end
+
+void tearDown()
+{
+    host_set_options(NULL);
+} // end
+
+
+// WaterWatcher<TestOptions>: the overrides are called directly
+void test_overrides_inlined()
+{
+    TestOptions opt;
+    run_sample(opt);
+    TEST_ASSERT_EQUAL_STRING("3.5000", json_value("a0_out"));
+    TEST_ASSERT_EQUAL_STRING("0.7500", json_value("a1_out"));
+    TEST_ASSERT_EQUAL_STRING("2.5000", json_value("a2_voltage"));
+    TEST_ASSERT_EQUAL_STRING("2.5000", json_value("a2_out"));
+    TEST_ASSERT_EQUAL_STRING("12.000", json_value("temp0_out"));
+    TEST_ASSERT_EQUAL_STRING("108.000", json_value("temp1_out"));
+    TEST_ASSERT_EQUAL_STRING("3.5000", csv_value("a0_out"));
+    TEST_ASSERT_EQUAL_STRING("108.000", csv_value("temp1_out"));
+} // end
+
+// WaterWatcher<>: the overrides are called through the virtual table
+void test_overrides_virtual()
+{
+    TestOptions derived;
+    WaterWatcherOptions &opt = derived;
+    run_sample(opt);
+    TEST_ASSERT_EQUAL_STRING("3.5000", json_value("a0_out"));
+    TEST_ASSERT_EQUAL_STRING("12.000", json_value("temp0_out"));
+    TEST_ASSERT_EQUAL_STRING("108.000", json_value("temp1_out"));
+} // end
+
+// The default transfer functions apply the calibrations stored in flash
+void test_calibrations()
+{
+    TEST_ASSERT_TRUE(setup_calibration(CAL_A0, "poly", 2, 0));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A0, 0, -1.0f));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A0, 1, 4.0f));
+    TEST_ASSERT_TRUE(setup_calibration(CAL_A1, "pwl", 2, 0));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A1, 2, 1.0f));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_A1, 3, 10.0f));
+    TEST_ASSERT_NULL(setup_calibration_expr(CAL_A2, "a2*10 + temp0"));
+    TEST_ASSERT_TRUE(setup_calibration(CAL_TEMP0, "poly", 2, 0));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_TEMP0, 0, 0.25f));
+    TEST_ASSERT_TRUE(set_calibration_coeff(CAL_TEMP0, 1, 1.0f));
+    WaterWatcherOptions opt;
+    run_sample(opt);
+    TEST_ASSERT_EQUAL_STRING("1.2500", json_value("a0_voltage"));
+    TEST_ASSERT_EQUAL_STRING("4.0000", json_value("a0_out"));
+    TEST_ASSERT_EQUAL_STRING("7.5000", json_value("a1_out"));
+    TEST_ASSERT_EQUAL_STRING("37.5000", json_value("a2_out"));
+    TEST_ASSERT_EQUAL_STRING("12.750", json_value("temp0_out"));
+    TEST_ASSERT_EQUAL_STRING("37.5000", csv_value("a2_out"));
+} // end
+
+// A channel that is not sampled is not in the JSON record and is empty in the CSV record
+void test_channel_not_sampled()
+{
+    WaterWatcherOptions opt;
+    opt.sample_a1(false);
+    run_sample(opt);
+    TEST_ASSERT_EQUAL_STRING("", json_value("a1_out"));
+    TEST_ASSERT_EQUAL_STRING("", csv_value("a1_out"));
+    TEST_ASSERT_EQUAL_STRING("1.2500", json_value("a0_out"));
+} // end
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_overrides_inlined);
+    RUN_TEST(test_overrides_virtual);
+    RUN_TEST(test_calibrations);
+    RUN_TEST(test_channel_not_sampled);
+    return UNITY_END();
+} // end
@@ -0,0 +1,271 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <utility>
+#include "Vector.h"
+#include "heap_check.h"
+
+/*
+Vector and StaticVector (Vector.h): the inline storage, the growth into the heap, copy and move,
+remove() and swap_remove(), and the time of the operations.
+*/
+
+const unsigned int BENCH_VECTOR_ELEMENTS = 16;
+const unsigned int BENCH_VECTOR_STRINGS = 8;
+const int BENCH_REPEAT = 200000;
+
+// Element that counts the live objects, so that each element that is constructed is also destroyed
+static int live = 0;
+struct Counted
+{
+    int v;
+    Counted() : v(0) { live++; }
+    Counted(int v) : v(v) { live++; }
+    Counted(const Counted &o) : v(o.v) { live++; }
+    Counted(Counted &&o) : v(o.v) { o.v = -1; live++; }
+    ~Counted() { live--; }
+    Counted &operator=(const Counted &o) { v = o.v; return *this; }
+    Counted &operator=(Counted &&o) { v = o.v; o.v = -1; return *this; }
+}; // end
+
+
+void setUp()
+{
+    live = 0;
+} // end
+
+void tearDown()
+{
+    TEST_ASSERT_EQUAL_INT(0, live);
+} // end
+
+
+// The first VECTOR_INLINE_SIZ elements are inside of the vector and then the capacity doubles in the heap
+void test_inline_then_heap()
+{
+    Vector<float> v;
+    TEST_ASSERT_EQUAL_UINT(VECTOR_INLINE_SIZ, v.capacity());
+    heap_check_begin();
+    for (unsigned int k = 0; k < VECTOR_INLINE_SIZ; k++) TEST_ASSERT_TRUE(v.push_back(k));
+    TEST_ASSERT_EQUAL_size_t(0, heap_check_end());
+    heap_check_begin();
+    TEST_ASSERT_TRUE(v.push_back(VECTOR_INLINE_SIZ));
+    TEST_ASSERT_EQUAL_size_t(1, heap_check_end());
+    TEST_ASSERT_EQUAL_UINT(2 * VECTOR_INLINE_SIZ, v.capacity());
+    for (unsigned int k = VECTOR_INLINE_SIZ + 1; k < BENCH_VECTOR_ELEMENTS; k++) v.push_back(k);
+    TEST_ASSERT_EQUAL_UINT(BENCH_VECTOR_ELEMENTS, v.size());
+    for (unsigned int k = 0; k < BENCH_VECTOR_ELEMENTS; k++) TEST_ASSERT_EQUAL_FLOAT((float)k, v[k]);
+    v.clear();
+    TEST_ASSERT_TRUE(v.empty());
+    TEST_ASSERT_EQUAL_UINT(BENCH_VECTOR_ELEMENTS, v.capacity());       // the storage is kept
+} // end
+
+// A vector without inline storage uses the heap for the first element and then keeps the storage
+void test_no_inline()
+{
+    Vector<float, 0> v;
+    TEST_ASSERT_EQUAL_UINT(0, v.capacity());
+    heap_check_begin();
+    TEST_ASSERT_TRUE(v.resize(3));
+    TEST_ASSERT_EQUAL_size_t(1, heap_check_end());
+    TEST_ASSERT_EQUAL_UINT(3, v.capacity());
+    v.clear();
+    heap_check_begin();
+    TEST_ASSERT_TRUE(v.resize(3));
+    v[2] = 1.5f;
+    TEST_ASSERT_EQUAL_size_t(0, heap_check_end());
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, v.back());
+} // end
+
+void test_static_full()
+{
+    StaticVector<Counted, 3> v;
+    heap_check_begin();
+    TEST_ASSERT_TRUE(v.push_back(Counted(1)));
+    TEST_ASSERT_TRUE(v.push_back(Counted(2)));
+    TEST_ASSERT_TRUE(v.push_back(Counted(3)));
+    TEST_ASSERT_TRUE(v.full());
+    TEST_ASSERT_FALSE(v.push_back(Counted(4)));
+    TEST_ASSERT_FALSE(v.resize(4));
+    TEST_ASSERT_FALSE(v.reserve(4));
+    TEST_ASSERT_EQUAL_size_t(0, heap_check_end());
+    TEST_ASSERT_EQUAL_UINT(3, v.size());
+    TEST_ASSERT_EQUAL_INT(3, v.back().v);
+    TEST_ASSERT_EQUAL_INT(3, live);
+} // end
+
+// push_back() of an element of the same vector when the vector grows
+void test_push_back_own_element()
+{
+    Vector<Counted, 2> v;
+    v.push_back(Counted(7));
+    v.push_back(Counted(8));
+    v.push_back(v[0]);
+    v.push_back(std::move(v[1]));
+    TEST_ASSERT_EQUAL_UINT(4, v.size());
+    TEST_ASSERT_EQUAL_INT(7, v[2].v);
+    TEST_ASSERT_EQUAL_INT(8, v[3].v);
+} // end
+
+void test_remove()
+{
+    Vector<Counted> v;
+    for (int k = 0; k < 6; k++) v.push_back(Counted(k));
+    v.remove(1);
+    TEST_ASSERT_EQUAL_UINT(5, v.size());
+    int order[] = {0, 2, 3, 4, 5};
+    for (unsigned int k = 0; k < v.size(); k++) TEST_ASSERT_EQUAL_INT(order[k], v[k].v);
+    v.swap_remove(0);
+    int swapped[] = {5, 2, 3, 4};
+    TEST_ASSERT_EQUAL_UINT(4, v.size());
+    for (unsigned int k = 0; k < v.size(); k++) TEST_ASSERT_EQUAL_INT(swapped[k], v[k].v);
+    v.swap_remove(3);                               // the last element
+    v.remove(10);                                   // no element
+    v.swap_remove(10);
+    TEST_ASSERT_EQUAL_UINT(3, v.size());
+    TEST_ASSERT_EQUAL_INT(3, live);                 // the removed elements are destroyed
+} // end
+
+void test_resize()
+{
+    Vector<Counted> v(3, Counted(5));
+    TEST_ASSERT_EQUAL_UINT(3, v.size());
+    TEST_ASSERT_TRUE(v.resize(10));
+    TEST_ASSERT_EQUAL_UINT(10, v.size());
+    TEST_ASSERT_EQUAL_INT(5, v[2].v);
+    TEST_ASSERT_EQUAL_INT(0, v[9].v);
+    TEST_ASSERT_TRUE(v.resize(1));
+    TEST_ASSERT_EQUAL_UINT(1, v.size());
+    TEST_ASSERT_EQUAL_INT(1, live);
+} // end
+
+// The move takes the heap buffer, and a vector with the elements inside is moved element by element
+void test_copy_and_move()
+{
+    Vector<String> s;
+    for (unsigned int k = 0; k < BENCH_VECTOR_STRINGS; k++) s.push_back(String("sensor") + String(k));
+    Vector<String> c(s);
+    TEST_ASSERT_EQUAL_UINT(BENCH_VECTOR_STRINGS, c.size());
+    TEST_ASSERT_TRUE(c[7] == "sensor7");
+    TEST_ASSERT_TRUE(s[7] == "sensor7");
+
+    const String *buffer = s.begin();
+    heap_check_begin();
+    Vector<String> m(std::move(s));
+    TEST_ASSERT_EQUAL_size_t(0, heap_check_end());
+    TEST_ASSERT_TRUE(m.begin() == buffer);
+    TEST_ASSERT_EQUAL_UINT(0, s.size());
+    TEST_ASSERT_TRUE(m[0] == "sensor0");
+
+    Vector<Counted> a;
+    a.push_back(Counted(1));
+    a.push_back(Counted(2));
+    Vector<Counted> b;
+    b = std::move(a);
+    TEST_ASSERT_EQUAL_UINT(2, b.size());
+    TEST_ASSERT_EQUAL_INT(2, b[1].v);
+    a = b;
+    TEST_ASSERT_EQUAL_UINT(2, a.size());
+    b = std::move(b);
+    TEST_ASSERT_EQUAL_UINT(2, b.size());
+    TEST_ASSERT_EQUAL_INT(1, b[0].v);
+} // end
+
+
+//-------------------------------------------------------------------------------------------
+// Time of the operations on the host (see Vector.h)
+
+static void print_ns(const char *name, unsigned long us, double count)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "%s ns: %.2f", name, 1000.0 * us / count);
+    TEST_MESSAGE(line);
+} // end
+
+// push_back() of 16 floats into a Vector (4 inline and then the heap) and into a StaticVector (no heap)
+void test_time_push_back()
+{
+    volatile float sink = 0.0f;
+    double count = (double)BENCH_REPEAT * BENCH_VECTOR_ELEMENTS;
+    unsigned long t0 = micros();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        Vector<float> v;
+        for (unsigned int k = 0; k < BENCH_VECTOR_ELEMENTS; k++) v.push_back(k);
+        sink = sink + v[r % BENCH_VECTOR_ELEMENTS];
+    }
+    unsigned long t1 = micros();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        StaticVector<float, BENCH_VECTOR_ELEMENTS> v;
+        for (unsigned int k = 0; k < BENCH_VECTOR_ELEMENTS; k++) v.push_back(k);
+        sink = sink + v[r % BENCH_VECTOR_ELEMENTS];
+    }
+    unsigned long t2 = micros();
+    print_ns("push_back heap", t1 - t0, count);
+    print_ns("push_back static", t2 - t1, count);
+} // end
+
+// remove() and swap_remove() of the first element of 16 floats (the element is put back after each removal)
+void test_time_remove()
+{
+    StaticVector<float, BENCH_VECTOR_ELEMENTS> v;
+    v.resize(BENCH_VECTOR_ELEMENTS);
+    unsigned long t0 = micros();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        v.remove(0);
+        v.push_back(r);
+    }
+    unsigned long t1 = micros();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        v.swap_remove(0);
+        v.push_back(r);
+    }
+    unsigned long t2 = micros();
+    TEST_ASSERT_EQUAL_UINT(BENCH_VECTOR_ELEMENTS, v.size());
+    print_ns("remove", t1 - t0, BENCH_REPEAT);
+    print_ns("swap_remove", t2 - t1, BENCH_REPEAT);
+} // end
+
+// Copy and move of a Vector of 8 Strings
+void test_time_copy_and_move()
+{
+    volatile size_t sink = 0;
+    Vector<String> s;
+    for (unsigned int k = 0; k < BENCH_VECTOR_STRINGS; k++) s.push_back(String("sensor") + String(k));
+    unsigned long t0 = micros();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        Vector<String> c(s);
+        sink = sink + c.size();
+    }
+    unsigned long t1 = micros();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        Vector<String> m(std::move(s));
+        sink = sink + m.size();
+        s = std::move(m);
+    }
+    unsigned long t2 = micros();
+    TEST_ASSERT_EQUAL_UINT(BENCH_VECTOR_STRINGS, s.size());
+    print_ns("copy strings", t1 - t0, BENCH_REPEAT);
+    print_ns("move strings", t2 - t1, BENCH_REPEAT);
+} // end
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_inline_then_heap);
+    RUN_TEST(test_no_inline);
+    RUN_TEST(test_static_full);
+    RUN_TEST(test_push_back_own_element);
+    RUN_TEST(test_remove);
+    RUN_TEST(test_resize);
+    RUN_TEST(test_copy_and_move);
+    RUN_TEST(test_time_push_back);
+    RUN_TEST(test_time_remove);
+    RUN_TEST(test_time_copy_and_move);
+    return UNITY_END();
+} // end
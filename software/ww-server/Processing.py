@@ -69,7 +69,11 @@ class DoAllProcessing:
         :return:
         """
         # take the starting time as the time of measurement
-        start_time = datetime.strptime(d[start_time_str_STR], TIME_STR_FMT)
+        # (the firmware before the epoch timestamps only sends the time strings)
+        if start_time_STR in d:
+            start_time = datetime.utcfromtimestamp(d[start_time_STR] / 1000.0)
+        else:
+            start_time = datetime.strptime(d[start_time_str_STR], TIME_STR_FMT)
         logger.debug('Start time:' + str(start_time))
         dt = timedelta(days=TIME_DAY)
         if not self.isNowInTimePeriod(start_time - dt, start_time + dt, start_time):
@@ -19,6 +19,13 @@ def obtain_current_time(add_sec=None):
     return obj.strftime(TIME_STR_FMT)
 
 
+def obtain_current_epoch_ms(add_sec=None):
+    obj = datetime.utcnow()
+    if add_sec:
+        obj += timedelta(0, add_sec)
+    return int((obj - datetime(1970, 1, 1)).total_seconds() * 1000)
+
+
 def gen_json(num, token):
     dt = datetime.today()
     d = {
@@ -41,8 +48,8 @@ def gen_json(num, token):
         battery_fault_STR: False,
         battery_charging_STR: False,
         rtc_temperature_STR: random.uniform(2, 23),
-        start_time_str_STR: obtain_current_time(),
-        end_time_str_STR: obtain_current_time(3),
+        start_time_STR: obtain_current_epoch_ms(),
+        end_time_STR: obtain_current_epoch_ms(3),
         btemperature_STR: 25.2,
         bvoltage_STR: 8.5,
         bcurrent_STR: 0.040,
@@ -54,6 +54,7 @@ a2_out_STR = 'a2_out'
 temp_STR = 'temp'
 temp0_STR = 'temp0'
 temp0_out_STR = 'temp0_out'
+MAX_TEMP_SENSORS = 8    # same as MAX_TEMP_SENSORS in the firmware
 
 serial_number_STR = 'serial_number'
 serial_number_good_STR = 'serial_number_good'
@@ -62,6 +63,9 @@ battery_charging_STR = 'battery_charging'
 rtc_temperature_STR = 'rtc_temperature'
 start_time_str_STR = 'start_time_str'
 end_time_str_STR = 'end_time_str'
+start_time_STR = 'start_time'          # ms since 1970-01-01 00:00:00 UTC
+end_time_STR = 'end_time'
+rtc_gps_offset_STR = 'rtc_gps_offset'  # ms that the RTC is ahead of the GPS time
 btemperature_STR = 'btemperature'
 bvoltage_STR = 'bvoltage'
 bcurrent_STR = 'bcurrent'
@@ -87,6 +91,19 @@ gps_fix_quality_STR = 'gps_fix_quality'
 gps_satellites_STR = 'gps_satellites'
 gps_total_sats_STR = 'gps_total_sats'
 gps_gdata_good_STR = 'gps_gdata_good'
+gps_hdop_STR = 'gps_hdop'
+gps_pdop_STR = 'gps_pdop'
+gps_vdop_STR = 'gps_vdop'
+gps_reused_STR = 'gps_reused'
+gps_ttff_STR = 'gps_ttff'
+gps_on_time_STR = 'gps_on_time'
+policy_tier_STR = 'policy_tier'
+policy_m_STR = 'policy_m'
+uplink_pending_STR = 'uplink_pending'
+event_STR = 'event'
+event_flags_STR = 'event_flags'
+# phases of the power profile (power-profile-on) in the same order as the firmware
+PP_PHASES = ['rail', 'sensors', 'gps', 'sd', 'modem', 'send', 'sleep']
 
 
 # Schema for main data transport JSON
@@ -150,8 +167,7 @@ DATA_SCHEMA = {
         'required': False
     },
 
-    # TODO: add in the other temperature strings here if required
-    # temp0, temp1, temp2,... as the water temperatures or 1-wire temperature sensors
+    # temp1, temp2,... are added below for the additional 1-wire temperature sensors
 
     # system health strings
     serial_number_STR: {
@@ -182,6 +198,21 @@ DATA_SCHEMA = {
         'type': 'string',
         'maxlength': TIME_STR_MAX_CHARS,
     },
+    start_time_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    end_time_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    rtc_gps_offset_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
     btemperature_STR: {
         'type': 'float',
         'coerce': float
@@ -282,9 +313,86 @@ DATA_SCHEMA = {
     gps_gdata_good_STR: {
         'type': 'integer',
         'coerce': int
+    },
+    gps_hdop_STR: {
+        'type': 'float',
+        'coerce': float,
+        'required': False
+    },
+    gps_pdop_STR: {
+        'type': 'float',
+        'coerce': float,
+        'required': False
+    },
+    gps_vdop_STR: {
+        'type': 'float',
+        'coerce': float,
+        'required': False
+    },
+    gps_reused_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    gps_ttff_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    gps_on_time_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    policy_tier_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    policy_m_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    uplink_pending_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    event_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    },
+    event_flags_STR: {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
     }
 }  # DONE
 
+# additional 1-wire temperature sensors
+for _k in range(1, MAX_TEMP_SENSORS):
+    for _name in [temp_STR + str(_k), temp_STR + str(_k) + '_out']:
+        DATA_SCHEMA[_name] = {
+            'type': 'float',
+            'coerce': float,
+            'required': False
+        }
+
+# charge (mAh) and time (ms) of each phase of the last sample cycle
+for _phase in PP_PHASES:
+    DATA_SCHEMA['pp_' + _phase + '_mah'] = {
+        'type': 'float',
+        'coerce': float,
+        'required': False
+    }
+    DATA_SCHEMA['pp_' + _phase + '_ms'] = {
+        'type': 'integer',
+        'coerce': int,
+        'required': False
+    }
+
 
 # numbers that indicate true or false
 GOOD_NUM_TRUE = 1